@@ -0,0 +1,50 @@
+/* ---------------------------------------------------------------------------
+** This software is in the public domain, furnished "as is", without technical
+** support, and with no warranty, express or implied, as to its usefulness for
+** any purpose.
+**
+** AccessUnitFramer.h
+**
+** H264/H265 discrete framer setting the RTP marker on the last NAL of an
+** access unit only, the stock framer sets it on every slice
+**
+** -------------------------------------------------------------------------*/
+
+#pragma once
+
+#include <liveMedia.hh>
+
+// ---------------------------------
+// Source knowing if the NAL it delivered last ends an access unit
+// ---------------------------------
+class AccessUnitSource
+{
+	public:
+		virtual bool isAccessUnitEnd() const = 0;
+		virtual ~AccessUnitSource() {}
+};
+
+#if LIVEMEDIA_LIBRARY_VERSION_INT >= 1596931200
+template <class DiscreteFramer>
+class AccessUnitFramer : public DiscreteFramer
+{
+	public:
+		static AccessUnitFramer* createNew(UsageEnvironment& env, FramedSource* inputSource, const AccessUnitSource* accessUnitSource)
+		{
+			return new AccessUnitFramer(env, inputSource, accessUnitSource);
+		}
+
+	protected:
+		AccessUnitFramer(UsageEnvironment& env, FramedSource* inputSource, const AccessUnitSource* accessUnitSource)
+			: DiscreteFramer(env, inputSource, False, False), m_accessUnitSource(accessUnitSource) {}
+
+		// called when the NAL is delivered, the source has not moved to the next one yet
+		virtual Boolean nalUnitEndsAccessUnit(u_int8_t nal_unit_type)
+		{
+			return m_accessUnitSource->isAccessUnitEnd();
+		}
+
+	private:
+		const AccessUnitSource* m_accessUnitSource;
+};
+#endif
@@ -0,0 +1,88 @@
+/* ---------------------------------------------------------------------------
+** This software is in the public domain, furnished "as is", without technical
+** support, and with no warranty, express or implied, as to its usefulness for
+** any purpose.
+**
+** AddADTSHeaderFilter.h
+** 
+** -------------------------------------------------------------------------*/
+
+#pragma once
+
+// prefix raw AAC LC frames with an ADTS header, as expected in MPEG-TS
+class AddADTSHeaderFilter : public FramedFilter {
+	public:
+		AddADTSHeaderFilter (UsageEnvironment& env, FramedSource* inputSource, u_int8_t samplingFrequencyIndex, u_int8_t channels): FramedFilter(env, inputSource), m_samplingFrequencyIndex(samplingFrequencyIndex), m_channels(channels) {
+			m_bufferSize = OutPacketBuffer::maxSize;
+			m_buffer = new unsigned char[m_bufferSize];
+		}
+		virtual ~AddADTSHeaderFilter () {
+			delete [] m_buffer;
+		}
+		
+	private:
+
+		static void afterGettingFrame(void* clientData, unsigned frameSize,
+						 unsigned numTruncatedBytes,
+						 struct timeval presentationTime,
+						 unsigned durationInMicroseconds) {
+			AddADTSHeaderFilter* sink = (AddADTSHeaderFilter*)clientData;
+			sink->afterGettingFrame(frameSize, numTruncatedBytes, presentationTime, durationInMicroseconds);
+		}
+				
+		void afterGettingFrame(unsigned frameSize, unsigned numTruncatedBytes, struct timeval presentationTime, unsigned durationInMicroseconds) 
+		{
+			fPresentationTime = presentationTime;
+			fDurationInMicroseconds = durationInMicroseconds;
+			if (numTruncatedBytes > 0) 
+			{
+				envir() << "AddADTSHeaderFilter::afterGettingFrame(): The input frame data was too large for our buffer size truncated:" << numTruncatedBytes << " bufferSize:" << m_bufferSize << "\n";
+				m_bufferSize += numTruncatedBytes;
+				delete[] m_buffer;
+				m_buffer = new unsigned char[m_bufferSize];
+				fFrameSize = 0;
+			} else {
+				// the encoder could already keep the ADTS header
+				const bool hasHeader = (frameSize >= 2) && (m_buffer[0] == 0xFF) && ((m_buffer[1] & 0xF0) == 0xF0);
+				unsigned char header[7];
+				unsigned int headerSize = 0;
+				if (!hasHeader) {
+					const unsigned int length = frameSize + sizeof(header);
+					header[0] = 0xFF;
+					header[1] = 0xF1; // MPEG-4, no CRC
+					header[2] = (1 << 6) | ((m_samplingFrequencyIndex & 0xF) << 2) | ((m_channels >> 2) & 0x1); // AAC LC
+					header[3] = ((m_channels & 0x3) << 6) | ((length >> 11) & 0x3);
+					header[4] = (length >> 3) & 0xFF;
+					header[5] = ((length & 0x7) << 5) | 0x1F; // buffer fullness 0x7FF
+					header[6] = 0xFC;
+					headerSize = sizeof(header);
+				}
+				fFrameSize = frameSize + headerSize;
+				fNumTruncatedBytes = 0;
+				if (fFrameSize > fMaxSize) {
+					// deliver what fits, the sink is told how much was dropped
+					fNumTruncatedBytes = fFrameSize - fMaxSize; 
+					envir() << "AddADTSHeaderFilter::afterGettingFrame(): buffer too small truncated:" << fNumTruncatedBytes << " bufferSize:" << fFrameSize << "\n";
+					fFrameSize = fMaxSize;
+				}
+				const unsigned int copiedHeaderSize = (headerSize < fFrameSize) ? headerSize : fFrameSize;
+				memcpy(fTo, header, copiedHeaderSize);
+				memcpy(fTo+copiedHeaderSize, m_buffer, fFrameSize - copiedHeaderSize); 
+			}
+			afterGetting(this);
+		}
+		
+		virtual void doGetNextFrame() {
+			if (fInputSource != NULL) 
+			{
+				fInputSource->getNextFrame(m_buffer, m_bufferSize,
+						afterGettingFrame, this,
+						handleClosure, this);
+			}			
+		}
+		
+		unsigned char* m_buffer;
+		unsigned int m_bufferSize;
+		u_int8_t m_samplingFrequencyIndex;
+		u_int8_t m_channels;
+};
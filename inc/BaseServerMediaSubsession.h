@@ -37,7 +37,7 @@
 class BaseServerMediaSubsession
 {
 	public:
-		BaseServerMediaSubsession(StreamReplicator* replicator): m_replicator(replicator) {
+		BaseServerMediaSubsession(StreamReplicator* replicator): m_replicator(replicator), m_auxLineVersion(0) {
 			V4L2DeviceSource* deviceSource = dynamic_cast<V4L2DeviceSource*>(replicator->inputSource());
 			if (deviceSource) {
                 DeviceInterface* device = deviceSource->getDevice();
@@ -115,12 +115,19 @@ class BaseServerMediaSubsession
         }        
 	
 	public:
-		static FramedSource* createSource(UsageEnvironment& env, FramedSource * videoES, const std::string& format);
+		// accessUnitSource tells the H264/H265 framer which NAL ends an access unit
+		static FramedSource* createSource(UsageEnvironment& env, FramedSource * videoES, const std::string& format, const AccessUnitSource* accessUnitSource = NULL);
+		static u_int8_t getAacSamplingIndex(int sampleRate);
 		static RTPSink* createSink(UsageEnvironment& env, Groupsock * rtpGroupsock, unsigned char rtpPayloadTypeIfDynamic, const std::string& format, V4L2DeviceSource* source);
 		char const* getAuxLine(V4L2DeviceSource* source, RTPSink* rtpSink);
+		void requestKeyFrame();
+		GopCache* getGopCache();
+		ReceiverReportMonitor* getReceiverReportMonitor();
+		bool isAuxLineChanged();
 		
 	protected:
 		StreamReplicator* m_replicator;
 		std::string m_format;        
+		unsigned int m_auxLineVersion;
 };
 
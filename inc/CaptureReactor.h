@@ -0,0 +1,59 @@
+/* ---------------------------------------------------------------------------
+** This software is in the public domain, furnished "as is", without technical
+** support, and with no warranty, express or implied, as to its usefulness for
+** any purpose.
+**
+** CaptureReactor.h
+**
+** One epoll thread reading frames of all device sources, instead of a reader
+** thread per source
+**
+** -------------------------------------------------------------------------*/
+
+#pragma once
+
+#include <list>
+#include <atomic>
+#include <pthread.h>
+
+#include "V4l2DummyFd.h"
+
+class V4L2DeviceSource;
+
+class CaptureReactor
+{
+	public:
+		static CaptureReactor& instance();
+
+		// thread is started with the first source and stopped after the last one
+		bool addSource(V4L2DeviceSource* source, int fd);
+		void removeSource(V4L2DeviceSource* source);
+
+	private:
+		CaptureReactor();
+		~CaptureReactor();
+		CaptureReactor(const CaptureReactor&) = delete;
+		CaptureReactor& operator=(const CaptureReactor&) = delete;
+
+		static void* threadStub(void* clientData) { return ((CaptureReactor*) clientData)->thread(); }
+		void* thread();
+		void stopThread();
+		bool isRegistered(V4L2DeviceSource* source) const;
+		void eraseSource(V4L2DeviceSource* source);
+
+	private:
+		struct Entry
+		{
+			V4L2DeviceSource* m_source;
+			int               m_fd;
+		};
+
+		int               m_epollFd;
+		V4l2DummyFd       m_wakeFd;
+		pthread_t         m_thid;
+		bool              m_isThreadStarted;
+		std::atomic_bool  m_stop;
+		// sources are read with this mutex locked, so a removed source is never read again
+		pthread_mutex_t   m_mutex;
+		std::list<Entry>  m_entries;
+};
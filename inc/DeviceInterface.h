@@ -29,6 +29,9 @@ class DeviceInterface
 		virtual int            getChannels()                 { return -1; }
 		virtual int            getAudioFormat()              { return -1; }				
 		virtual std::list<int> getAudioFormatList()          { return std::list<int>(); }
+		virtual void           requestKeyFrame()             {}
+		virtual void           setActive(bool isActive)      {}
+		virtual void           setReceiverStats(int lossPercent, int jitterMs) {}
 		virtual ~DeviceInterface()                           {};
 };
 
@@ -16,6 +16,7 @@
 #include "V4L2DeviceSource.h"
 #include "H264_V4l2DeviceSource.h"
 #include "H265_V4l2DeviceSource.h"
+#include "GopCache.h"
 
 class DeviceSourceFactory {
     public:
@@ -36,7 +37,7 @@ class DeviceSourceFactory {
             return source;
         }
 
-        static StreamReplicator* createStreamReplicator(UsageEnvironment* env, int format, DeviceInterface* devCapture, int queueSize = 5, V4L2DeviceSource::CaptureMode captureMode = V4L2DeviceSource::CAPTURE_INTERNAL_THREAD, int outfd = -1, bool repeatConfig = true) {
+        static StreamReplicator* createStreamReplicator(UsageEnvironment* env, int format, DeviceInterface* devCapture, int queueSize = 5, V4L2DeviceSource::CaptureMode captureMode = V4L2DeviceSource::CAPTURE_INTERNAL_THREAD, int outfd = -1, bool repeatConfig = true, size_t gopCacheSize = 0) {
             StreamReplicator* replicator = NULL;
             FramedSource* framedSource = DeviceSourceFactory::createFramedSource(env, format, devCapture, queueSize, captureMode, outfd, repeatConfig);
             if (framedSource != NULL) 
@@ -46,6 +47,11 @@ class DeviceSourceFactory {
                 {
                     OutPacketBuffer::maxSize = devCapture->getBufferSize();
                 }						
+                // keep last GOP for late joiners, only H26x have frames that can't be decoded alone
+                if ( (gopCacheSize > 0) && ((format == V4L2_PIX_FMT_H264) || (format == V4L2_PIX_FMT_HEVC)) )
+                {
+                    ((V4L2DeviceSource*)framedSource)->setGopCache(new GopCache(V4l2Device::fourcc(format), gopCacheSize));
+                }
                 replicator = StreamReplicator::createNew(*env, framedSource, false);
             }
             return replicator;
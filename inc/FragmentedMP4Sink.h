@@ -0,0 +1,144 @@
+/* ---------------------------------------------------------------------------
+** This software is in the public domain, furnished "as is", without technical
+** support, and with no warranty, express or implied, as to its usefulness for
+** any purpose.
+**
+** FragmentedMP4Sink.h
+**
+** Implement a live555 Sink that store CMAF fragments (moof/mdat) in memory
+** from H264/H265 NALs, each fragment starts at a key frame
+**
+** -------------------------------------------------------------------------*/
+
+#pragma once
+
+#include <string>
+#include <map>
+#include <vector>
+
+#include "MediaSink.hh"
+
+#include "SharedBuffer.h"
+
+class FragmentedMP4Sink : public MediaSink
+{
+	public:
+		static FragmentedMP4Sink* createNew(UsageEnvironment& env, const std::string & format, unsigned int width, unsigned int height, unsigned int bufferSize, unsigned int fragmentDuration, unsigned int nbFragments = 5)
+		{
+			return new FragmentedMP4Sink(env, format, width, height, bufferSize, fragmentDuration, nbFragments);
+		}
+
+		static const unsigned int kTimescale = 90000;
+
+	protected:
+		FragmentedMP4Sink(UsageEnvironment& env, const std::string & format, unsigned int width, unsigned int height, unsigned int bufferSize, unsigned int fragmentDuration, unsigned int nbFragments);
+		virtual ~FragmentedMP4Sink();
+
+		virtual Boolean continuePlaying();
+
+		static void afterGettingFrame(void* clientData, unsigned frameSize,
+						 unsigned numTruncatedBytes,
+						 struct timeval presentationTime,
+						 unsigned durationInMicroseconds) {
+			FragmentedMP4Sink* sink = (FragmentedMP4Sink*)clientData;
+			sink->afterGettingFrame(frameSize, numTruncatedBytes, presentationTime);
+		}
+
+		void afterGettingFrame(unsigned frameSize, unsigned numTruncatedBytes, struct timeval presentationTime);
+		void processNal(const unsigned char* nal, unsigned int size, u_int64_t time);
+		void endSample(u_int64_t nextTime);
+		void endFragment();
+		void writeMoof(std::string & out, unsigned int dataOffset);
+		void updateInitSegment();
+
+	public:
+		// empty until the parameter sets are received
+		SharedBuffer getInitSegment()   { return SharedBuffer(m_initSegment, 0, m_initSegment->size()); }
+		// init segment of a version still used by a stored fragment, empty otherwise
+		SharedBuffer getInitSegment(unsigned int version);
+		// incremented each time the parameter sets change
+		unsigned int getInitVersion()   { return m_initVersion; }
+		// RFC 6381 codecs parameter
+		std::string  getCodec()         { return m_codec; }
+		std::string  getCodec(unsigned int version);
+		unsigned int getWidth()         { return m_width; }
+		unsigned int getHeight()        { return m_height; }
+		// presentation time in seconds of decode time 0
+		time_t       getStartTime()     { return m_startTime; }
+		unsigned int getBufferSize(unsigned int fragment);
+		SharedBuffer getBuffer(unsigned int fragment);
+		// id of the oldest fragment, ids are increasing
+		unsigned int firstFragment();
+		// duration in seconds of fragments by id
+		std::map<unsigned int,double> getFragmentDurations();
+		// decode time of the fragment in kTimescale units
+		u_int64_t    getDecodeTime(unsigned int fragment);
+		// version of the init segment decoding the fragment
+		unsigned int getFragmentInitVersion(unsigned int fragment);
+		// number of init segment changes before the oldest fragment
+		unsigned int getDiscontinuitySequence() { return m_discontinuitySequence; }
+
+	private:
+		struct Sample
+		{
+			unsigned int m_size;
+			unsigned int m_duration;
+			bool         m_isKey;
+		};
+
+		struct Fragment
+		{
+			Fragment() : m_duration(0), m_decodeTime(0), m_initVersion(0), m_isDiscontinuity(false) {}
+
+			std::shared_ptr<const std::string> m_buffer;
+			double                             m_duration;
+			u_int64_t                          m_decodeTime;
+			unsigned int                       m_initVersion;
+			// init segment differs from the previous fragment one
+			bool                               m_isDiscontinuity;
+		};
+
+		struct InitSegment
+		{
+			std::shared_ptr<const std::string> m_buffer;
+			std::string                        m_codec;
+		};
+
+		unsigned char *                    m_buffer;
+		unsigned int                       m_bufferSize;
+		bool                               m_isH265;
+		unsigned int                       m_width;
+		unsigned int                       m_height;
+		unsigned int                       m_fragmentDuration;
+		unsigned int                       m_nbFragments;
+		std::map<unsigned int,Fragment>    m_fragments;
+		unsigned int                       m_nextFragmentId;
+
+		// parameter sets of the init segment
+		std::string                        m_vps;
+		std::string                        m_sps;
+		std::string                        m_pps;
+		std::shared_ptr<const std::string> m_initSegment;
+		unsigned int                       m_initVersion;
+		bool                               m_isInitChanged;
+		std::string                        m_codec;
+		// init segments by version, kept while a stored fragment needs them
+		std::map<unsigned int,InitSegment> m_initSegments;
+		unsigned int                       m_discontinuitySequence;
+
+		// access unit being received, NALs are prefixed with their size
+		std::string                        m_sampleData;
+		u_int64_t                          m_sampleTime;
+		bool                               m_isSampleKey;
+		bool                               m_hasSample;
+		unsigned int                       m_lastDuration;
+		u_int64_t                          m_decodeTime;
+		time_t                             m_startTime;
+
+		// fragment being built, starts with a key frame
+		std::vector<Sample>                m_samples;
+		std::string                        m_mdat;
+		u_int64_t                          m_fragmentTime;
+		unsigned int                       m_fragmentInitVersion;
+};
+
@@ -0,0 +1,60 @@
+/* ---------------------------------------------------------------------------
+** This software is in the public domain, furnished "as is", without technical
+** support, and with no warranty, express or implied, as to its usefulness for
+** any purpose.
+**
+** GopCache.h
+**
+** Keep frames delivered since the last key frame, so late joiners can start
+** decoding without waiting for the next one. Frames are copied into pool
+** buffers, so the cache never holds encoder buffers.
+**
+** -------------------------------------------------------------------------*/
+
+#pragma once
+
+#include <deque>
+
+#include "V4L2DeviceSource.h"
+
+class GopCache
+{
+	public:
+		GopCache(const std::string & name, size_t maxSize);
+
+		// called from live555 thread for each frame delivered by the device source
+		void addFrame(const V4L2DeviceSource::Frame & frame);
+
+		// get first cached frame with sequence number not lower than seqNo
+		bool getFrame(unsigned long seqNo, V4L2DeviceSource::Frame* outFrame, unsigned long* outSeqNo) const;
+
+		size_t getFrameCount() const { return m_frames.size(); }
+		size_t getSize() const       { return m_size;          }
+		size_t getMaxSize() const    { return m_maxSize;       }
+
+		void clear();
+
+	private:
+		bool copyFrame(const V4L2DeviceSource::Frame & frame, V4L2DeviceSource::Frame* outFrame);
+
+	private:
+		struct CachedFrame
+		{
+			CachedFrame(unsigned long seqNo, const V4L2DeviceSource::Frame & frame) : m_seqNo(seqNo), m_frame(frame) {}
+
+			unsigned long m_seqNo;
+			V4L2DeviceSource::Frame m_frame;
+		};
+
+	private:
+		const std::string       m_name;
+		const size_t            m_maxSize;
+		std::deque<CachedFrame> m_frames;
+		size_t                  m_size;
+		unsigned long           m_nextSeqNo;
+		const char*             m_lastBuffer;
+		// copy of the captured buffer the last NALs were split from
+		FrameRef                m_lastCopy;
+		bool                    m_isLastCopied;
+		bool                    m_isOverflow;
+};
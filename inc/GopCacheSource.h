@@ -0,0 +1,53 @@
+/* ---------------------------------------------------------------------------
+** This software is in the public domain, furnished "as is", without technical
+** support, and with no warranty, express or implied, as to its usefulness for
+** any purpose.
+**
+** GopCacheSource.h
+**
+** Deliver the GOP cache in a burst, then switch to the live replica
+**
+** -------------------------------------------------------------------------*/
+
+#pragma once
+
+#include "GopCache.h"
+
+class GopCacheSource : public FramedFilter, public AccessUnitSource
+{
+	public:
+		static GopCacheSource* createNew(UsageEnvironment& env, FramedSource* replica, const GopCache* gopCache, const AccessUnitSource* liveSource)
+		{
+			return new GopCacheSource(env, replica, gopCache, liveSource);
+		}
+
+		// cached frame while bursting, then the live source
+		virtual bool isAccessUnitEnd() const;
+
+	protected:
+		GopCacheSource(UsageEnvironment& env, FramedSource* replica, const GopCache* gopCache, const AccessUnitSource* liveSource);
+		virtual ~GopCacheSource();
+
+		virtual void doGetNextFrame();
+
+	private:
+		static void afterGettingFrame(void* clientData, unsigned frameSize,
+						 unsigned numTruncatedBytes,
+						 struct timeval presentationTime,
+						 unsigned durationInMicroseconds) {
+			GopCacheSource* source = (GopCacheSource*)clientData;
+			source->afterGettingFrame(frameSize, numTruncatedBytes, presentationTime, durationInMicroseconds);
+		}
+
+		void afterGettingFrame(unsigned frameSize, unsigned numTruncatedBytes, struct timeval presentationTime, unsigned durationInMicroseconds);
+		bool deliverCachedFrame();
+
+	private:
+		const GopCache*         m_gopCache;
+		const AccessUnitSource* m_liveSource;
+		bool                    m_isBursting;
+		bool                    m_isFirstLiveFrame;
+		unsigned long           m_nextSeqNo;
+		unsigned int            m_burstFrames;
+		V4L2DeviceSource::Frame m_lastCachedFrame;
+};
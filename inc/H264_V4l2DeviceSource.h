@@ -27,6 +27,6 @@ class H264_V4L2DeviceSource : public H26X_V4L2DeviceSource
 			: H26X_V4L2DeviceSource(env, device, outputFd, queueSize, captureMode, repeatConfig, keepMarker) {} 
 	
 		// overide V4L2DeviceSource
-		virtual std::list< std::pair<unsigned char*,size_t> > splitFrames(unsigned char* frame, unsigned frameSize);
+		virtual void splitFrames(unsigned char* frame, unsigned frameSize, FrameList & frameList);
 		virtual std::list< std::string > getInitFrames();
 };
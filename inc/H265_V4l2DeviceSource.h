@@ -27,10 +27,11 @@ class H265_V4L2DeviceSource : public H26X_V4L2DeviceSource
 			: H26X_V4L2DeviceSource(env, device, outputFd, queueSize, captureMode, repeatConfig, keepMarker) {} 
 	
 		// overide V4L2DeviceSource
-		virtual std::list< std::pair<unsigned char*,size_t> > splitFrames(unsigned char* frame, unsigned frameSize);			
+		virtual void splitFrames(unsigned char* frame, unsigned frameSize, FrameList & frameList);			
 		virtual std::list< std::string > getInitFrames();
 				
 	protected:
 		std::string m_vps;
+		std::shared_ptr<const std::string> m_repeatedVps;
 };
 
@@ -12,6 +12,8 @@
 
 #pragma once
 
+#include <memory>
+
 // project
 #include "V4L2DeviceSource.h"
 
@@ -31,10 +33,14 @@ class H26X_V4L2DeviceSource : public V4L2DeviceSource
 
 		unsigned char* extractFrame(unsigned char* frame, size_t& size, size_t& outsize, int& frameType);
 		std::string getFrameWithMarker(const std::string & frame);
+		bool updateParameterSet(std::string & parameterSet, std::shared_ptr<const std::string> & repeated, unsigned char* buffer, size_t size, const char* name);
 				
 	protected:
 		std::string m_sps;
 		std::string m_pps;
+		// copies queued as repeated config, queued frames hold the ones they point to
+		std::shared_ptr<const std::string> m_repeatedSps;
+		std::shared_ptr<const std::string> m_repeatedPps;
 		bool        m_repeatConfig;
 		bool        m_keepMarker;
 };
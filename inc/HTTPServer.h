@@ -7,7 +7,7 @@
 ** 
 ** V4L2 RTSP streamer                                                                 
 **        
-** HTTP server that serves HLS & MPEG-DASH playlist and segments
+** HTTP server that serves HLS & MPEG-DASH playlist and segments, JPEG snapshots and MJPEG
 **                                                                                    
 ** -------------------------------------------------------------------------*/
 
@@ -17,6 +17,14 @@
 #include "RTSPCommon.hh"
 #include <GroupsockHelper.hh> // for "ignoreSigPipeOnSocket()"
 
+#include <sstream>
+#include <vector>
+#include <list>
+#include <memory>
+
+#include "MemoryBufferSink.h"
+#include "FragmentedMP4Sink.h"
+
 
 #define TCP_STREAM_SINK_MIN_READ_SIZE 1000
 #define TCP_STREAM_SINK_BUFFER_SIZE 10000
@@ -127,32 +135,85 @@ class HTTPServer : public RTSPServer
 		public:
 			HTTPClientConnection(RTSPServer& ourServer, int clientSocket, struct SOCKETCLIENT clientAddr, Boolean useTLS)
 #if LIVEMEDIA_LIBRARY_VERSION_INT >= 1642723200      
-		       : RTSPServer::RTSPClientConnection(ourServer, clientSocket, clientAddr, useTLS), m_TCPSink(NULL), m_StreamToken(NULL), m_Subsession(NULL), m_Source(NULL) {
+		       : RTSPServer::RTSPClientConnection(ourServer, clientSocket, clientAddr, useTLS), m_TCPSink(NULL), m_Source(NULL), m_sentBytes(0),
+				 m_hlsSink(NULL), m_hlsSlice(0), m_hlsPart(-1), m_isHlsPartRequest(false), m_hlsTimeoutTask(NULL),
+				 m_isWaitingSnapshot(false), m_snapshotSequence(0), m_snapshotTimeoutTask(NULL), m_isMjpegClient(false), m_mjpegSequence(0) {
 #else
-		       : RTSPServer::RTSPClientConnection(ourServer, clientSocket, clientAddr), m_TCPSink(NULL), m_StreamToken(NULL), m_Subsession(NULL), m_Source(NULL) {
+		       : RTSPServer::RTSPClientConnection(ourServer, clientSocket, clientAddr), m_TCPSink(NULL), m_Source(NULL), m_sentBytes(0),
+				 m_hlsSink(NULL), m_hlsSlice(0), m_hlsPart(-1), m_isHlsPartRequest(false), m_hlsTimeoutTask(NULL),
+				 m_isWaitingSnapshot(false), m_snapshotSequence(0), m_snapshotTimeoutTask(NULL), m_isMjpegClient(false), m_mjpegSequence(0) {
 #endif				   
 			}
 			virtual ~HTTPClientConnection();
 
+			// snapshot long-poll, answered when a new JPEG is available
+			void onSnapshot(bool isTimeout);
+			void stopWaitingSnapshot();
+			// MJPEG stream, a new JPEG is skipped while the previous one is being sent
+			void onMjpegFrame();
+			void stopMjpeg();
+
 		private:
 
+			void formatHeader(const char* contentType, unsigned int contentLength, const char* extraHeaders = "");
 			void sendHeader(const char* contentType, unsigned int contentLength);		
+			void streamBuffer(const char* contentType, const SharedBuffer & body, const char* extraHeaders = "");
+			static void socketWritableHandler(void* clientData, int mask) { ((HTTPClientConnection*)clientData)->socketWritableHandler(); }
+			void socketWritableHandler() {
+				envir().taskScheduler().disableBackgroundHandling(fClientOutputSocket); // disable this handler until the next time it's needed
+				this->sendBufferedData();
+			}
+			void sendBufferedData();
+			bool isSending() { return m_sentBytes < m_sendHeader.size() + m_sendBody.size(); }
 			void streamSource(FramedSource* source);	
 			void streamSource(const std::string & content);
 			ServerMediaSubsession* getSubsesion(const char* urlSuffix);
 			bool sendFile(char const* urlSuffix);
 			bool sendM3u8PlayList(char const* urlSuffix);
 			bool sendMpdPlayList(char const* urlSuffix);
+			bool sendFmp4M3u8PlayList(char const* urlSuffix);
+			bool sendFmp4MpdPlayList(char const* urlSuffix, FragmentedMP4Sink* fmp4Sink);
+			bool sendFmp4Segment(char const* urlSuffix, bool isInit, unsigned int index);
+			void writeParts(std::ostringstream & os, char const* urlSuffix, unsigned int slice, const std::vector<MemoryBufferSink::Part> & parts);
+			bool sendSlice(char const* urlSuffix, unsigned int slice);
+			bool sendPart(char const* urlSuffix, unsigned int slice, unsigned int part);
+			// LL-HLS blocking requests, answered when the slice or the part is available
+			bool waitHlsRequest(char const* urlSuffix, unsigned int slice, int part, bool isPartRequest);
+			bool isHlsRequestReady();
+			bool sendHlsRequest();
+			void sendHlsError(const char* status);
+			void stopWaitingHlsRequest();
+			static void onHlsPartStub(void* clientData) { ((HTTPClientConnection*)clientData)->onHlsPart(false); }
+			static void onHlsTimeoutStub(void* clientData) { ((HTTPClientConnection*)clientData)->onHlsPart(true); }
+			void onHlsPart(bool isTimeout);
+			void handleSnapshot(char const* questionMarkPos, char const* fullRequestStr);
+			bool sendSnapshot();
+			static void onSnapshotTimeoutStub(void* clientData) { ((HTTPClientConnection*)clientData)->onSnapshot(true); }
+			void startMjpeg();
+			void sendMjpegFrame();
 			virtual void handleHTTPCmd_StreamingGET(char const* urlSuffix, char const* fullRequestStr);
 			virtual void handleCmd_notFound();
 			static void afterStreaming(void* clientData);
 		
 		private:
-			static u_int32_t       m_ClientSessionId;
 			TCPSink*               m_TCPSink;
-			void*                  m_StreamToken;
-			ServerMediaSubsession* m_Subsession;
 			FramedSource*          m_Source;
+			std::string            m_sendHeader;
+			SharedBuffer           m_sendBody;
+			size_t                 m_sentBytes;
+			MemoryBufferSink*      m_hlsSink;
+			std::string            m_hlsUrl;
+			unsigned int           m_hlsSlice;
+			int                    m_hlsPart;
+			bool                   m_isHlsPartRequest;
+			TaskToken              m_hlsTimeoutTask;
+			bool                   m_isWaitingSnapshot;
+			unsigned int           m_snapshotSequence;
+			std::string            m_snapshotEtag;
+			TaskToken              m_snapshotTimeoutTask;
+			bool                   m_isMjpegClient;
+			std::string            m_mjpegHeader;
+			unsigned int           m_mjpegSequence;
 	};
 	
 	class HTTPClientSession : public RTSPServer::RTSPClientSession {
@@ -185,10 +246,10 @@ class HTTPServer : public RTSPServer
 
 #if LIVEMEDIA_LIBRARY_VERSION_INT	<	1611187200
 		HTTPServer(UsageEnvironment& env, int ourSocketIPv4, int ourSocketIPv6, Port rtspPort, UserAuthenticationDatabase* authDatabase, unsigned reclamationTestSeconds, unsigned int hlsSegment, const std::string & webroot, const char* sslCert)
-		  : RTSPServer(env, ourSocketIPv4, rtspPort, authDatabase, reclamationTestSeconds), m_hlsSegment(hlsSegment), m_webroot(webroot), m_sslCert(sslCert)
+		  : RTSPServer(env, ourSocketIPv4, rtspPort, authDatabase, reclamationTestSeconds), m_hlsSegment(hlsSegment), m_webroot(webroot), m_sslCert(sslCert), m_snapshotSequence(0), m_snapshotEpoch(0), m_jpegTrigger(0)
 #else
 		HTTPServer(UsageEnvironment& env, int ourSocketIPv4, int ourSocketIPv6, Port rtspPort, UserAuthenticationDatabase* authDatabase, unsigned reclamationTestSeconds, unsigned int hlsSegment, const std::string & webroot, const char* sslCert)
-		  : RTSPServer(env, ourSocketIPv4, ourSocketIPv6, rtspPort, authDatabase, reclamationTestSeconds), m_hlsSegment(hlsSegment), m_webroot(webroot), m_sslCert(sslCert)
+		  : RTSPServer(env, ourSocketIPv4, ourSocketIPv6, rtspPort, authDatabase, reclamationTestSeconds), m_hlsSegment(hlsSegment), m_webroot(webroot), m_sslCert(sslCert), m_snapshotSequence(0), m_snapshotEpoch(0), m_jpegTrigger(0)
 #endif			
 		{
                        if ( (!m_webroot.empty()) && (*m_webroot.rend() != '/') ) {
@@ -199,7 +260,9 @@ class HTTPServer : public RTSPServer
                     this->setTLSState(m_sslCert, m_sslCert, true, true);
                 }
 #endif   			
+			this->initSnapshot();
 		}
+		virtual ~HTTPServer();
 
 		virtual RTSPServer::ClientConnection* createNewClientConnection(int clientSocket, struct SOCKETCLIENT clientAddr) 
 		{
@@ -213,8 +276,21 @@ class HTTPServer : public RTSPServer
 		bool isSSL() { return (m_sslCert != NULL); }
 
         private:
+			void initSnapshot();
+			// latest JPEG of the camera, shared by all the connections sending it
+			SharedBuffer getSnapshot(unsigned int & sequence);
+			std::string  getSnapshotEtag(unsigned int sequence);
+			static void onJpegStub(void* clientData) { ((HTTPServer*)clientData)->onJpeg(); }
+			void onJpeg();
+
 			const unsigned int m_hlsSegment;
 			std::string  m_webroot;
 			const char*  m_sslCert;
+			std::shared_ptr<const std::string> m_snapshot;
+			unsigned int m_snapshotSequence;
+			time_t       m_snapshotEpoch;
+			std::list<HTTPClientConnection*> m_snapshotWaiters;
+			std::list<HTTPClientConnection*> m_mjpegClients;
+			EventTriggerId m_jpegTrigger;
 };
 
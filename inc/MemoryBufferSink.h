@@ -4,8 +4,9 @@
 ** any purpose.
 **
 ** MemoryBufferSink.h
-** 
-** Implement a live555 Sink that store time slices in memory
+**
+** Implement a live555 Sink that store MPEG-TS slices in memory, each slice
+** starts at a key frame and is split in parts for low latency HLS
 **
 ** -------------------------------------------------------------------------*/
 
@@ -13,23 +14,34 @@
 
 #include <string>
 #include <map>
+#include <list>
+#include <vector>
 
 #include "MediaSink.hh"
 
+#include "SharedBuffer.h"
+
 class MemoryBufferSink : public MediaSink
 {
 	public:
-		static MemoryBufferSink* createNew(UsageEnvironment& env, unsigned int bufferSize, unsigned int sliceDuration, unsigned int nbSlices = 5) 
+		static MemoryBufferSink* createNew(UsageEnvironment& env, unsigned int bufferSize, unsigned int sliceDuration, double partDuration = 0, unsigned int nbSlices = 5)
 		{
-			return new MemoryBufferSink(env, bufferSize, sliceDuration, nbSlices);
+			return new MemoryBufferSink(env, bufferSize, sliceDuration, partDuration, nbSlices);
 		}
-		
+
+		struct Part
+		{
+			unsigned int m_offset;
+			double       m_duration;
+			bool         m_isIndependent;
+		};
+
 	protected:
-		MemoryBufferSink(UsageEnvironment& env, unsigned bufferSize, unsigned int sliceDuration, unsigned int nbSlices);
-		virtual ~MemoryBufferSink(); 
-		
+		MemoryBufferSink(UsageEnvironment& env, unsigned bufferSize, unsigned int sliceDuration, double partDuration, unsigned int nbSlices);
+		virtual ~MemoryBufferSink();
+
 		virtual Boolean continuePlaying();
-	
+
 		static void afterGettingFrame(void* clientData, unsigned frameSize,
 						 unsigned numTruncatedBytes,
 						 struct timeval presentationTime,
@@ -39,20 +51,75 @@ class MemoryBufferSink : public MediaSink
 		}
 
 		void afterGettingFrame(unsigned frameSize, unsigned numTruncatedBytes, struct timeval presentationTime);
-		
+		void processPacket(const unsigned char* packet);
+		void parsePat(const unsigned char* payload, unsigned int size);
+		void parsePmt(const unsigned char* payload, unsigned int size);
+		bool isRandomAccess(const unsigned char* payload, unsigned int size);
+		void startSlice(u_int64_t pts);
+		void startPart(u_int64_t pts, bool isIndependent);
+		void endPart(u_int64_t pts);
+
 	public:
+		// only complete slices are available, the last one is still being filled
 		unsigned int getBufferSize(unsigned int slice);
-		std::string  getBuffer(unsigned int slice);			
-		unsigned int firstTime();
-		unsigned int duration();
+		SharedBuffer getBuffer(unsigned int slice);
+		// id of the oldest slice, ids are increasing
+		unsigned int firstSlice();
+		// duration in seconds of complete slices by id
+		std::map<unsigned int,double> getSliceDurations();
+		double       firstTime();
+		double       duration();
 		unsigned int getSliceDuration() 	{ return m_sliceDuration; }
-		
+		// called once per slice when it reached its duration without a key frame
+		void         setKeyFrameRequestHandler(TaskFunc* handler, void* clientData) { m_keyFrameRequestHandler = handler; m_keyFrameRequestClientData = clientData; }
+
+		// parts, 0 part duration disables them
+		double       getPartDuration()  { return m_partDuration; }
+		// id of the slice being filled
+		unsigned int lastSlice();
+		// complete parts of a slice
+		std::vector<Part> getParts(unsigned int slice);
+		SharedBuffer getPart(unsigned int slice, unsigned int part);
+		bool         isSliceAvailable(unsigned int slice);
+		bool         isPartAvailable(unsigned int slice, unsigned int part);
+		// listeners are called each time a part is complete
+		void         addPartListener(TaskFunc* handler, void* clientData);
+		void         removePartListener(TaskFunc* handler, void* clientData);
+
 	private:
+		struct Slice
+		{
+			Slice() : m_buffer(std::make_shared<std::string>()), m_duration(0) {}
+
+			// shared with the HTTP connections sending it, only appended to
+			std::shared_ptr<std::string> m_buffer;
+			double            m_duration;
+			std::vector<Part> m_parts;
+		};
+
 		unsigned char *                    m_buffer;
 		unsigned int                       m_bufferSize;
-		std::map<unsigned int,std::string> m_outputBuffers;
-		unsigned int                       m_refTime;
+		std::map<unsigned int,Slice>       m_outputBuffers;
+		unsigned int                       m_nextSliceId;
+		double                             m_removedDuration;
 		unsigned int                       m_sliceDuration;
+		double                             m_partDuration;
 		unsigned int                       m_nbSlices;
+		TaskFunc*                          m_keyFrameRequestHandler;
+		void*                              m_keyFrameRequestClientData;
+
+		// last PAT and PMT, repeated at the beginning of each slice
+		std::string                        m_pat;
+		std::string                        m_pmt;
+		unsigned int                       m_pmtPid;
+		unsigned int                       m_videoPid;
+		unsigned int                       m_videoStreamType;
+		u_int64_t                          m_sliceStartPts;
+		bool                               m_isKeyFrameRequested;
+		u_int64_t                          m_partStartPts;
+		u_int64_t                          m_lastPts;
+		u_int64_t                          m_frameDelta;
+		bool                               m_isPartCompleted;
+		std::list< std::pair<TaskFunc*,void*> > m_partListeners;
 };
-	
+
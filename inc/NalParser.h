@@ -0,0 +1,27 @@
+/* ---------------------------------------------------------------------------
+** This software is in the public domain, furnished "as is", without technical
+** support, and with no warranty, express or implied, as to its usefulness for
+** any purpose.
+**
+** NalParser.h
+** 
+** Split H264/H265 Annex-B byte stream in NAL units
+**
+** -------------------------------------------------------------------------*/
+
+
+#pragma once
+
+#include <stddef.h>
+
+class NalParser
+{
+	public:
+		// next 00 00 01 in [p, end), end when not found
+		static const unsigned char* findStartCode(const unsigned char* p, const unsigned char* end);
+
+		// first NAL of frame, NULL when there is no start code
+		// size is updated to the bytes left after the NAL, outsize is the NAL size
+		// with its start code when keepMarker is set, frameType its first byte
+		static unsigned char* extractNal(unsigned char* frame, size_t& size, size_t& outsize, int& frameType, bool keepMarker);
+};
@@ -0,0 +1,40 @@
+/* ---------------------------------------------------------------------------
+** This software is in the public domain, furnished "as is", without technical
+** support, and with no warranty, express or implied, as to its usefulness for
+** any purpose.
+**
+** ReceiverReportMonitor.h
+**
+** Aggregate RTCP receiver reports of all RTP sinks fed by a device and pass
+** the worst packet loss and jitter to it, so it can adapt its bitrate
+**
+** -------------------------------------------------------------------------*/
+
+#pragma once
+
+#include <list>
+
+#include <liveMedia.hh>
+
+#include "DeviceInterface.h"
+
+class ReceiverReportMonitor
+{
+	public:
+		ReceiverReportMonitor(UsageEnvironment& env, DeviceInterface* device);
+		~ReceiverReportMonitor();
+
+		void addSink(RTPSink* sink);
+		void removeSink(RTPSink* sink);
+
+	private:
+		static void checkReportsStub(void* clientData) { ((ReceiverReportMonitor*)clientData)->checkReports(); }
+		void checkReports();
+
+	private:
+		UsageEnvironment&  m_env;
+		DeviceInterface*   m_device;
+		std::list<RTPSink*> m_sinks;
+		TaskToken          m_checkTask;
+		struct timeval     m_lastCheckTime;
+};
@@ -0,0 +1,33 @@
+/* ---------------------------------------------------------------------------
+** This software is in the public domain, furnished "as is", without technical
+** support, and with no warranty, express or implied, as to its usefulness for
+** any purpose.
+**
+** SharedBuffer.h
+**
+** Range of a refcounted segment buffer, served without copy. The bytes of
+** the range never change, the owner only appends after them.
+**
+** -------------------------------------------------------------------------*/
+
+#pragma once
+
+#include <string>
+#include <memory>
+
+class SharedBuffer
+{
+	public:
+		SharedBuffer() : m_offset(0), m_size(0) {}
+		SharedBuffer(const std::shared_ptr<const std::string> & data, size_t offset, size_t size) : m_data(data), m_offset(offset), m_size(size) {}
+
+		// the owner could reallocate when appending, do not keep the pointer
+		const char* data() const   { return m_data->data() + m_offset; }
+		size_t size() const        { return m_size;      }
+		bool empty() const         { return m_size == 0; }
+
+	private:
+		std::shared_ptr<const std::string> m_data;
+		size_t m_offset;
+		size_t m_size;
+};
@@ -0,0 +1,51 @@
+/* ---------------------------------------------------------------------------
+** This software is in the public domain, furnished "as is", without technical
+** support, and with no warranty, express or implied, as to its usefulness for
+** any purpose.
+**
+** SharedBufferSource.h
+**
+** Byte stream source reading a SharedBuffer, the segment is referenced
+** instead of copied for each stream
+**
+** -------------------------------------------------------------------------*/
+
+#pragma once
+
+#include <string.h>
+#include <sys/time.h>
+
+#include <liveMedia.hh>
+
+#include "SharedBuffer.h"
+
+class SharedBufferSource : public FramedSource {
+	public:
+		static SharedBufferSource* createNew(UsageEnvironment& env, const SharedBuffer & buffer) {
+			return new SharedBufferSource(env, buffer);
+		}
+
+	protected:
+		SharedBufferSource(UsageEnvironment& env, const SharedBuffer & buffer): FramedSource(env), m_buffer(buffer), m_offset(0) {}
+
+		virtual void doGetNextFrame() {
+			if (m_offset >= m_buffer.size()) {
+				handleClosure();
+				return;
+			}
+			fFrameSize = m_buffer.size() - m_offset;
+			if (fFrameSize > fMaxSize) {
+				fFrameSize = fMaxSize;
+			}
+			fNumTruncatedBytes = 0;
+			memcpy(fTo, m_buffer.data() + m_offset, fFrameSize);
+			m_offset += fFrameSize;
+			gettimeofday(&fPresentationTime, NULL);
+			fDurationInMicroseconds = 0;
+			FramedSource::afterGetting(this);
+		}
+
+	private:
+		SharedBuffer m_buffer;
+		size_t       m_offset;
+};
@@ -12,6 +12,7 @@
 #include <map>
 #include "UnicastServerMediaSubsession.h"
 #include "MemoryBufferSink.h"
+#include "FragmentedMP4Sink.h"
 
 // -----------------------------------------
 //    ServerMediaSubsession for HLS
@@ -23,6 +24,9 @@ class TSServerMediaSubsession : public UnicastServerMediaSubsession
 		{
 			return new TSServerMediaSubsession(env, videoreplicator, audioreplicator, sliceDuration);
 		}
+		MemoryBufferSink* getHlsSink() { return m_hlsSink; }
+		// NULL when the format cannot be stored in fMP4
+		FragmentedMP4Sink* getFmp4Sink() { return m_fmp4Sink; }
 		
 	protected:
 		TSServerMediaSubsession(UsageEnvironment& env, StreamReplicator* videoreplicator, StreamReplicator* audioreplicator, unsigned int sliceDuration); 
@@ -32,10 +36,15 @@ class TSServerMediaSubsession : public UnicastServerMediaSubsession
 		virtual float         duration() const ;
 		virtual void          seekStream(unsigned clientSessionId, void* streamToken, double& seekNPT, double streamDuration, u_int64_t& numBytes);
 		virtual FramedSource* getStreamSource(void* streamToken);
+		virtual void          deleteStream(unsigned clientSessionId, void*& streamToken);
+
+		static void           onKeyFrameRequest(void* clientData);
 					
 	protected:
-		unsigned int      m_slice;
+		// slice sought by each stream
+		std::map<void*,unsigned int> m_slices;
 		MemoryBufferSink* m_hlsSink;
+		FragmentedMP4Sink* m_fmp4Sink;
 };
 
 
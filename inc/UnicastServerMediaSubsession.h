@@ -26,6 +26,13 @@ class UnicastServerMediaSubsession : public BaseServerMediaSubsession, public On
 		virtual FramedSource* createNewStreamSource(unsigned clientSessionId, unsigned& estBitrate);
 		virtual RTPSink* createNewRTPSink(Groupsock* rtpGroupsock,  unsigned char rtpPayloadTypeIfDynamic, FramedSource* inputSource);		
 		virtual char const* getAuxSDPLine(RTPSink* rtpSink,FramedSource* inputSource);	
+#if LIVEMEDIA_LIBRARY_VERSION_INT < 1610928000
+		virtual char const* sdpLines();
+#else
+		virtual char const* sdpLines(int addressFamily);
+#endif
+		virtual void startStream(unsigned clientSessionId, void* streamToken, TaskFunc* rtcpRRHandler, void* rtcpRRHandlerClientData, unsigned short& rtpSeqNum, unsigned& rtpTimestamp, ServerRequestAlternativeByteHandler* serverRequestAlternativeByteHandler, void* serverRequestAlternativeByteHandlerClientData);
+		virtual void deleteStream(unsigned clientSessionId, void*& streamToken);
 					
 };
 
@@ -14,20 +14,26 @@
 
 #include <string>
 #include <list> 
+#include <vector>
 #include <iostream>
 #include <iomanip>
 #include <atomic>
+#include <memory>
 #include <pthread.h>
 
 // live555
 #include <liveMedia.hh>
 
 #include "DeviceInterface.h"
+#include "AccessUnitFramer.h"
+
+class GopCache;
+class ReceiverReportMonitor;
 
 // -----------------------------------------
 //    Video Device Source 
 // -----------------------------------------
-class V4L2DeviceSource: public FramedSource
+class V4L2DeviceSource: public FramedSource, public AccessUnitSource
 {
 	public:
 		// ---------------------------------
@@ -35,14 +41,82 @@ class V4L2DeviceSource: public FramedSource
 		// ---------------------------------
 		struct Frame
 		{
-			Frame(char* buffer, int size, timeval timestamp, const FrameRef &allocatedBuffer) : m_buffer(buffer), m_size(size), m_timestamp(timestamp), m_allocatedBuffer(allocatedBuffer) {};
+			Frame() : m_buffer(NULL), m_size(0), m_timestamp(), m_duration(0), m_isAccessUnitEnd(false) {};
+			Frame(char* buffer, int size, timeval timestamp, const FrameRef &allocatedBuffer) : m_buffer(buffer), m_size(size), m_timestamp(timestamp), m_duration(0), m_isAccessUnitEnd(false), m_allocatedBuffer(allocatedBuffer) {};
 			
 			char* m_buffer;
 			unsigned int m_size;
 			timeval m_timestamp;
+			// set on the last NAL of an access unit only, so its NALs are sent back to back
+			unsigned int m_duration;
+			// last NAL of an access unit, it gets the RTP marker
+			bool m_isAccessUnitEnd;
 			FrameRef m_allocatedBuffer;
+			// holds m_buffer when it is not in the captured frame, like repeated parameter sets
+			std::shared_ptr<const std::string> m_bufferOwner;
 		};
 		
+		// ---------------------------------
+		// NALs split from a captured frame, reused for each frame so splitting does not allocate
+		// once it has grown to the largest access unit
+		// ---------------------------------
+		class FrameList
+		{
+			public:
+				struct Nal
+				{
+					Nal(unsigned char* buffer, size_t size, const std::shared_ptr<const std::string> & owner) : m_buffer(buffer), m_size(size), m_owner(owner) {};
+
+					unsigned char* m_buffer;
+					size_t m_size;
+					// set when the NAL is not in the captured frame
+					std::shared_ptr<const std::string> m_owner;
+				};
+
+				static const size_t kInitialCapacity = 16;
+
+				FrameList()                                                          { m_items.reserve(kInitialCapacity); }
+
+				void push_back(const std::pair<unsigned char*,size_t> & item)        { m_items.push_back(Nal(item.first, item.second, m_noOwner)); }
+				// NAL kept alive by owner while it is queued
+				void push_back(const std::shared_ptr<const std::string> & owner)     { m_items.push_back(Nal((unsigned char*)owner->data(), owner->size(), owner)); }
+				void clear()                                                         { m_items.clear();         }
+				bool empty() const                                                   { return m_items.empty();  }
+				size_t size() const                                                  { return m_items.size();   }
+				const Nal & operator[](size_t i) const                               { return m_items[i];       }
+
+			private:
+				const std::shared_ptr<const std::string> m_noOwner;
+				std::vector<Nal> m_items;
+		};
+
+		// ---------------------------------
+		// Capture queue, ring allocated once, the oldest frame is dropped when full
+		// ---------------------------------
+		class FrameQueue
+		{
+			public:
+				FrameQueue(size_t capacity) : m_frames(capacity > 0 ? capacity : 1, m_emptyFrame), m_head(0), m_size(0) {};
+
+				// false when the oldest frame was dropped to make room
+				bool push(const Frame & frame);
+				void pop_front();
+				void clear();
+				// grow the ring keeping queued frames, it never shrinks
+				void reserve(size_t capacity);
+				bool empty() const    { return m_size == 0; }
+				size_t size() const   { return m_size;      }
+				Frame & front()       { return m_frames[m_head]; }
+				Frame & back()        { return m_frames[(m_head + m_size - 1) % m_frames.size()]; }
+
+			private:
+				// copied into released slots, a default FrameRef allocates
+				const Frame m_emptyFrame;
+				std::vector<Frame> m_frames;
+				size_t m_head;
+				size_t m_size;
+		};
+
 		// ---------------------------------
 		// Compute simple stats
 		// ---------------------------------
@@ -68,15 +142,23 @@ class V4L2DeviceSource: public FramedSource
 		{
 			CAPTURE_LIVE555_THREAD = 0,
 			CAPTURE_INTERNAL_THREAD,
+			CAPTURE_REACTOR_THREAD,
 			NOCAPTURE
 		};
 
 	public:
 		static V4L2DeviceSource* createNew(UsageEnvironment& env, DeviceInterface * device, int outputFd, unsigned int queueSize, CaptureMode captureMode) ;
-		std::string getAuxLine()                   { return m_auxLine;    }
+		std::string getAuxLine();
+		// incremented when the aux line changes, SDP built with an older one is stale
+		unsigned int getAuxLineVersion()           { return m_auxLineVersion; }
 		DeviceInterface* getDevice()               { return m_device;     }	
+		GopCache* getGopCache()                    { return m_gopCache;   }
+		void setGopCache(GopCache* gopCache);
+		ReceiverReportMonitor* getReceiverReportMonitor() { return m_receiverReportMonitor; }
 		void postFrame(const FrameRef &frame, const timeval &ref);
 		virtual std::list< std::string > getInitFrames() { return std::list< std::string >(); }
+		// the frame delivered last ends an access unit
+		virtual bool isAccessUnitEnd() const       { return m_isAccessUnitEnd; }
 	
 
 	protected:
@@ -84,24 +166,31 @@ class V4L2DeviceSource: public FramedSource
 		virtual ~V4L2DeviceSource();
 
 	protected:	
+		friend class CaptureReactor;
 		static void* threadStub(void* clientData) { return ((V4L2DeviceSource*) clientData)->thread();};
 		virtual void* thread();
 		static void deliverFrameStub(void* clientData) {((V4L2DeviceSource*) clientData)->deliverFrame();};
 		void deliverFrame();
 		static void incomingPacketHandlerStub(void* clientData, int mask) { ((V4L2DeviceSource*) clientData)->incomingPacketHandler(); };
 		void incomingPacketHandler();
+		static void checkActivityStub(void* clientData) {((V4L2DeviceSource*) clientData)->checkActivity();};
+		void checkActivity();
+		void setInactive();
+		void setAuxLine(const std::string & auxLine);
 		int getNextFrame();
 		void processFrame(const FrameRef &frame, const timeval &ref);
-		void queueFrame(char * frame, int frameSize, const timeval &tv, const FrameRef &allocatedBuffer);
+		void queueFrames(const FrameList & frameList, const timeval &tv, unsigned int duration, const FrameRef &allocatedBuffer);
+		unsigned int getAccessUnitDuration(const timeval &tv);
 
 		// split packet in frames
-		virtual std::list< std::pair<unsigned char*,size_t> > splitFrames(unsigned char* frame, unsigned frameSize);
+		virtual void splitFrames(unsigned char* frame, unsigned frameSize, FrameList & frameList);
 		
 		// overide FramedSource
 		virtual void doGetNextFrame();	
 					
 	protected:
-		std::list<Frame> m_captureQueue;
+		FrameQueue m_captureQueue;
+		FrameList m_frameList; // capture thread only
 		Stats m_in;
 		Stats m_out;
 		EventTriggerId m_eventTriggerId;
@@ -111,6 +200,15 @@ class V4L2DeviceSource: public FramedSource
 		pthread_t m_thid;
 		pthread_mutex_t m_mutex;
 		std::string m_auxLine;
+		std::atomic<unsigned int> m_auxLineVersion;
 		std::atomic<int> m_queuedFramesCount;
+		GopCache* m_gopCache;
+		ReceiverReportMonitor* m_receiverReportMonitor;
+		bool m_isActive;
+		bool m_isRequested;
+		TaskToken m_activityCheckTask;
+		CaptureMode m_captureMode;
+		timeval m_lastAccessUnitTime;
+		bool m_isAccessUnitEnd;
 };
 
@@ -80,7 +80,7 @@ class V4l2RTSPServer {
         // -----------------------------------------
         StreamReplicator* CreateVideoReplicator( 
 					const V4L2DeviceParameters& inParam,
-					int queueSize, V4L2DeviceSource::CaptureMode captureMode, int repeatConfig,
+					int queueSize, V4L2DeviceSource::CaptureMode captureMode, int repeatConfig, size_t gopCacheSize,
 					const std::string& outputFile, V4l2IoType ioTypeOut, V4l2Output*& out);
 
 #ifdef HAVE_ALSA
@@ -130,6 +130,7 @@ class V4l2RTSPServer {
             ip.s_addr = ourIPv4Address(*this->env());
 #endif
             LOG(NOTICE) << "HLS       http://" << inet_ntoa(ip) << ":" << m_rtspPort << "/" << url << ".m3u8";
+            LOG(NOTICE) << "HLS fMP4  http://" << inet_ntoa(ip) << ":" << m_rtspPort << "/" << url << ".fmp4.m3u8";
             LOG(NOTICE) << "MPEG-DASH http://" << inet_ntoa(ip) << ":" << m_rtspPort << "/" << url << ".mpd";	
 			
 			return sms;	    
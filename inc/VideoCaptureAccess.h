@@ -30,6 +30,9 @@ class VideoCaptureAccess : public DeviceInterface
 		virtual int getWidth()                                     { return m_device->getWidth(); }
 		virtual int getHeight()                                    { return m_device->getHeight(); }
 		virtual int getVideoFormat()                               { return m_device->getFormat(); }
+		virtual void requestKeyFrame()                             { m_device->requestKeyFrame(); }
+		virtual void setActive(bool isActive)                      { m_device->setActive(isActive); }
+		virtual void setReceiverStats(int lossPercent, int jitterMs) { m_device->setReceiverStats(lossPercent, jitterMs); }
 			
 	protected:
 		V4l2Capture* m_device;
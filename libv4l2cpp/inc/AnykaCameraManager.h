@@ -13,10 +13,13 @@
 #include <unistd.h>
 #include <errno.h>
 #include <string.h>
+#include <functional>
+#include <mutex>
 #include "AnykaOsd.h"
 #include "AnykaVideoEncoder.h"
 #include "AnykaMotionDetector.h"
 #include "AnykaDayNight.h"
+#include "AnykaRateController.h"
 #include "ConfigFile.h"
 #include "FrameBuffer.h"
 #include "SharedMemory.h"
@@ -60,6 +63,8 @@ public:
 
 	size_t startStream(const std::string &name);
 	void stopStream(size_t streamId);
+	// Stream encoder is stopped after idle timeout when stream has no consumers.
+	void setStreamActive(size_t streamId, bool isActive);
 
 	unsigned int getFormat(size_t streamId);
 	unsigned int getWidth(size_t streamId);      
@@ -69,6 +74,14 @@ public:
 	int getFd(size_t streamId) const;
     size_t getBufferSize(size_t streamId) const;
 	FrameRef getEncodedFrame(size_t streamId);
+	void requestKeyFrame(size_t streamId);
+	// Worst packet loss and jitter among stream clients, limits video bitrate.
+	void reportReceiverStats(size_t streamId, int lossPercent, int jitterMs);
+	// Latest JPEG and its sequence number, not set when capture is stopped.
+	FrameRef getLastJpeg(unsigned int *outSequence);
+	// Called from camera thread on each new JPEG. Returns once a call in progress is done,
+	// so the previous listener is not called after a reset.
+	void setJpegListener(const std::function<void()> &listener);
 
 private:
 	AnykaCameraManager();
@@ -80,7 +93,16 @@ private:
 	{
 		AnykaStream();
 		AnykaEncoderBase *encoder;
-		std::atomic_bool isActivated;
+		std::atomic_bool isActivated; // Requested by client, applied by processStreams().
+		std::atomic_bool hasConsumers;
+		std::atomic<long long> idleSinceMs;
+		bool isStarted;
+	};
+
+	struct AdaptiveBitrateLimits
+	{
+		int minKbps; // 0 - adaptive bitrate disabled.
+		int maxKbps;
 	};
 
 	bool initVideoDevice();
@@ -95,18 +117,24 @@ private:
 
 	bool start();
 	void stop();
+	bool startEncoder(size_t streamId);
+	void stopEncoder(size_t streamId);
 
+	bool startThread();
 	void stopThread();
-	bool restartThread();
 	
 	VideoEncodeParam getVideoEncodeParams(size_t streamId);
+	VideoRateControl getVideoRateControl(size_t streamId, const SharedConfig *sharedConf);
+	void limitVideoRateControl(size_t streamId, VideoRateControl *rateControl);
 	audio_param getAudioEncodeParams(size_t streamId);
 	VideoEncodeParam getJpegEncodeParams();
 
 	void processThread();
-	bool processEncoding();
+	void processStreams();
 	bool processJpeg();
 	void processSharedConfig();
+	void processFramePool();
+	void processAdaptiveBitrate();
 	void processMotionDetection();
 	void writeMotionDetectionFlag(bool isMotionDetected);
 	static void* thread(void *arg);
@@ -116,6 +144,8 @@ private:
 	void startMotionDetection(const SharedConfig *sharedConf);
 	bool startDayNight(const SharedConfig *sharedConf);
 	void flipImage(const SharedConfig *sharedConf);
+	void updateVideoRateControl(const SharedConfig *sharedConf);
+	void updateAdaptiveBitrateLimits();
 	void updateCurrentSharedConfig(const SharedConfig *sharedConf);
 	void abortIfNeed();
 
@@ -125,9 +155,16 @@ private:
 	ak_pthread_t m_threadId;
 	std::atomic_bool m_threadStopFlag;
 	AnykaStream m_streams[STREAMS_COUNT];
+	AnykaRateController m_rateControllers[AudioHigh]; // Video streams only.
+	AdaptiveBitrateLimits m_abrLimits[AudioHigh];     // From config, updated with shared config.
 	ReadOnlyConfigSection m_config[STREAMS_COUNT];
 	ReadOnlyConfigSection m_mainConfig;
 	AnykaVideoEncoder m_jpegEncoder;
+	std::mutex m_lastJpegLock;
+	FrameRef m_lastJpeg;
+	unsigned int m_lastJpegSequence;
+	std::mutex m_jpegListenerLock; // Held during the listener call.
+	std::function<void()> m_jpegListener;
 	AnykaOsd m_osd;
 	AnykaMotionDetector m_motionDetect;
 	AnykaDayNight m_dayNight;
@@ -141,6 +178,9 @@ private:
 	flock m_motionDetectionLock;
 	bool m_abortOnError;
 	bool m_preferSharedConfig;
+	int m_framePoolTrimCounter;
+	bool m_isCaptureStarted;
+	long long m_idleTimeoutMs;
 
 };
 
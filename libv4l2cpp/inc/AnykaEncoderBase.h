@@ -17,13 +17,13 @@ extern "C"
 {
 	#include "ak_global.h"
     #include "ak_venc.h"
+    #include "ak_thread.h"
 }
 
 #include "FrameBuffer.h"
+#include "FrameRing.h"
 #include "V4l2DummyFd.h"
 #include <atomic>
-#include <list>
-#include <mutex>
 
 struct VideoEncodeParam
 {
@@ -36,12 +36,33 @@ struct VideoEncodeParam
 
 class AnykaEncoderBase
 {
+public:
+    // What to do when consumer does not take encoded frames fast enough.
+    enum OverflowPolicy
+    {
+        DropOldest = 0,
+        DropNonKeyFirst, // Drop new non key frames until next key frame, key frame drops oldest ones.
+        Block            // Wait for consumer, encoder is not read meanwhile.
+    };
+
+    struct QueueStats
+    {
+        unsigned long pushed;
+        unsigned long droppedOldest;
+        unsigned long droppedNonKey;
+        unsigned long blocked;
+    };
+
 public:
     AnykaEncoderBase();
     virtual ~AnykaEncoderBase() = default;
 
     bool isSet() const;
 
+    // Should be called before start().
+    void setQueueParams(size_t depth, OverflowPolicy policy);
+    QueueStats getQueueStats() const;
+
     bool start(void *videoDevice, void *audioDevice, const VideoEncodeParam &videoParams, const audio_param &audioParams);
     void stop();
     bool encode();
@@ -49,23 +70,58 @@ public:
     int getEncodedFrameReadyFd() const;
     FrameRef getEncodedFrame();
 
+    // Ask encoder for key frame as soon as possible, can be called from any thread.
+    // Requests are coalesced and rate limited, next natural key frame satisfies them too.
+    void requestKeyFrame();
+
 protected:
     virtual bool isAudioEncoder() const = 0;
     virtual void onStart(void *device, const VideoEncodeParam &videoParams);
     virtual void onStart(void *device, const audio_param &audioParams);
     virtual void onStop() = 0;
     virtual bool readNewFrameData(FrameRef *outFrame) = 0;
+    // Called from encoder thread, returns false if encoder can't force key frame.
+    virtual bool onKeyFrameRequest();
+
+    // Convert SDK stream timestamp to CLOCK_MONOTONIC microseconds, same base for all encoders.
+    static long long sdkTimestampToMonotonicUs(unsigned long long timestampMs);
 
 protected:
     void *m_encoder;
     void *m_encoderStream;
+    int m_frameIntervalMs; // Expected interval between encoded frames, set by onStart().
+
+private:
+    void startThread();
+    void stopThread();
+    void processThread();
+    int getPollDelayMs() const;
+    void processKeyFrameRequest();
+    static void* thread(void *arg);
+
+    void pushEncodedFrame(const FrameRef &frame);
+    bool dropOldestFrame();
+    void logQueueStats(bool isOverflow);
 
 private:
+    ak_pthread_t m_threadId;
+    std::atomic_bool m_threadStopFlag;
+    long long m_lastFrameTimeMs;
     V4l2DummyFd m_signalFd;
     FrameBuffer m_frameBuffer;
     FrameRef m_freeFrame;
-    mutable std::mutex m_encodedFramesLock;
-    std::list<FrameRef> m_encodedFrames;
+    // Signal fd holds one token per queued frame, frame is popped only after its token is taken.
+    FrameRing m_encodedFrames;
+    size_t m_queueDepth;
+    OverflowPolicy m_queuePolicy;
+    bool m_waitKeyFrame;
+    long long m_lastStatsLogTimeMs;
+    std::atomic<unsigned long> m_pushedFrames;
+    std::atomic<unsigned long> m_droppedOldestFrames;
+    std::atomic<unsigned long> m_droppedNonKeyFrames;
+    std::atomic<unsigned long> m_blockedFrames;
+    std::atomic_bool m_keyFrameRequested;
+    long long m_lastKeyFrameRequestMs;
 };
 
 
@@ -0,0 +1,46 @@
+/* ---------------------------------------------------------------------------
+** This software is in the public domain, furnished "as is", without technical
+** support, and with no warranty, express or implied, as to its usefulness for
+** any purpose.
+**
+** AnykaRateController.h
+**
+** Adaptive bitrate limit driven by receiver reports of stream clients.
+**
+** -------------------------------------------------------------------------*/
+
+
+#ifndef ANYKA_RATE_CONTROLLER
+#define ANYKA_RATE_CONTROLLER
+
+
+#include <atomic>
+
+
+class AnykaRateController
+{
+public:
+    AnykaRateController();
+
+    // Can be called from any thread, worst values among all clients of the stream.
+    void reportReceiverStats(int lossPercent, int jitterMs);
+    // Cheap check before process(), stats are reported every few seconds.
+    bool hasNewStats() const;
+
+    // Called periodically from camera manager thread, returns true if bitrate limit is changed.
+    bool process(int minKbps, int maxKbps);
+    // Current bitrate limit, 0 if there were no reports yet.
+    int getKbps() const;
+    void reset();
+
+private:
+    std::atomic_bool m_hasNewStats;
+    std::atomic<int> m_lossPercent;
+    std::atomic<int> m_jitterMs;
+    int m_kbps;
+    long long m_lastDecreaseTimeMs;
+    long long m_lastIncreaseTimeMs;
+};
+
+
+#endif
@@ -20,6 +20,19 @@ extern "C"
 }
 
 #include "AnykaEncoderBase.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+
+// Encoder parameters which can be changed without encoder restart, 0 keeps current value.
+struct VideoRateControl
+{
+    int kbps;    // CBR bitrate or VBR target bitrate
+    int maxKbps; // VBR max bitrate
+    int fps;
+    int gopLen;
+};
 
 
 class AnykaVideoEncoder: public AnykaEncoderBase
@@ -28,14 +41,39 @@ public:
     AnykaVideoEncoder();
     ~AnykaVideoEncoder();
 
+    // Can be called from any thread, applied by encoder thread before next frame is read.
+    void setRateControl(const VideoRateControl &rateControl);
+
 protected:
     bool isAudioEncoder() const override;
     void onStart(void *device, const VideoEncodeParam &videoParams) override;
     void onStop() override;
     bool readNewFrameData(FrameRef *outFrame) override;
+    bool onKeyFrameRequest() override;
+
+private:
+    // Keeps SDK stream opened while encoded frames still reference its buffers.
+    class StreamHolder
+    {
+    public:
+        StreamHolder(void *encoder, void *stream);
+        ~StreamHolder();
+
+        void *m_encoder;
+        void *m_stream;
+        std::atomic<int> m_heldFrames;
+    };
+
+    void applyRateControl();
 
 private:
-    video_stream m_streamData;
+    std::shared_ptr<StreamHolder> m_streamHolder;
+    bool m_isJpegEncoder;
+    int m_brMode;
+    VideoRateControl m_rateControl;
+    VideoRateControl m_newRateControl;
+    std::atomic_bool m_isRateControlChanged;
+    std::mutex m_rateControlLock;
 };
 
 
@@ -12,6 +12,7 @@
 
 #include <vector>
 #include <memory>
+#include <functional>
 
 
 class FrameRef
@@ -19,12 +20,20 @@ class FrameRef
 public:
 	FrameRef();
 
+	// Wrap buffer owned by someone else, releaseCallback is called when last reference is gone.
+	static FrameRef createExternal(char *buffer, size_t dataSize, const std::function<void()> &releaseCallback);
+
 	char* getData() const;
 	size_t getDataSize() const;
 	size_t getFullSize() const;
 	void setDataSize(size_t size);
 	bool reallocIfNeed(size_t size);
 	bool isSet() const;
+	void setKeyFrame(bool isKeyFrame);
+	bool isKeyFrame() const;
+	// Capture time by CLOCK_MONOTONIC in microseconds, 0 - unknown.
+	void setTimestamp(long long timestampUs);
+	long long getTimestamp() const;
 
 private:
 	class FrameData
@@ -36,6 +45,9 @@ private:
 		char *m_buffer;
 		size_t m_fullSize;
 		size_t m_dataSize;
+		bool m_isKeyFrame;
+		long long m_timestampUs;
+		std::function<void()> m_releaseCallback;
 	};
 
 private:
@@ -0,0 +1,74 @@
+/* ---------------------------------------------------------------------------
+** This software is in the public domain, furnished "as is", without technical
+** support, and with no warranty, express or implied, as to its usefulness for
+** any purpose.
+**
+** FramePool.h
+** 
+** Frame buffers allocator with power of two size classes. Released buffers are
+** kept for reuse, trim() frees ones not needed since previous trim.
+**
+** -------------------------------------------------------------------------*/
+
+#pragma once
+
+#include <vector>
+#include <mutex>
+
+
+class FramePool
+{
+public:
+	struct Stats
+	{
+		size_t liveBuffers;
+		size_t freeBuffers;
+		size_t liveBytes;
+		size_t freeBytes;
+		size_t peakBytes;
+		unsigned long allocations;
+		unsigned long reuses;
+		unsigned long reallocations;
+		unsigned long failures;
+	};
+
+public:
+	static FramePool& instance();
+
+	// 0 - unlimited.
+	void setMaxBytes(size_t maxBytes);
+
+	char* allocate(size_t size, size_t *outCapacity);
+	char* reallocate(char *buffer, size_t capacity, size_t dataSize, size_t newSize, size_t *outCapacity);
+	void release(char *buffer, size_t capacity);
+
+	void trim();
+	Stats getStats() const;
+
+private:
+	FramePool();
+	FramePool(const FramePool&) = delete;
+	FramePool& operator=(const FramePool&) = delete;
+
+	struct SizeClass
+	{
+		SizeClass();
+
+		std::vector<char*> freeBuffers;
+		size_t liveCount;
+		size_t peakLiveCount; // Since last trim.
+	};
+
+	static int getClassIndex(size_t size);
+	static size_t getClassSize(int index);
+	size_t getHeldBytes() const;
+	void freeBuffers(SizeClass *sizeClass, size_t keepCount, size_t classSize);
+
+private:
+	static const int kClassesCount = 11;
+
+	mutable std::mutex m_lock;
+	SizeClass m_classes[kClassesCount];
+	size_t m_maxBytes;
+	Stats m_stats;
+};
@@ -0,0 +1,44 @@
+/* ---------------------------------------------------------------------------
+** This software is in the public domain, furnished "as is", without technical
+** support, and with no warranty, express or implied, as to its usefulness for
+** any purpose.
+**
+** FrameRing.h
+** 
+** Fixed capacity lock-free frames queue. Push is allowed from one thread only,
+** pop may be called from consumer and from producer (to drop oldest frame).
+**
+** -------------------------------------------------------------------------*/
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include "FrameBuffer.h"
+
+
+class FrameRing
+{
+public:
+	FrameRing();
+
+	// Not thread safe, ring must not be used by other threads during init.
+	void init(size_t capacity);
+	size_t getCapacity() const;
+
+	bool tryPush(const FrameRef &frame);
+	bool tryPop(FrameRef *outFrame);
+
+private:
+	struct Cell
+	{
+		std::atomic<size_t> m_sequence;
+		FrameRef m_frame;
+	};
+
+private:
+	std::unique_ptr<Cell[]> m_cells;
+	size_t m_capacity;
+	std::atomic<size_t> m_pushPos;
+	std::atomic<size_t> m_popPos;
+};
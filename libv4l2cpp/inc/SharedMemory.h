@@ -48,6 +48,16 @@ struct SharedConfig
     bool videoDay;
     char osdText[MAX_STR_SIZE];
     char configFilePath[MAX_STR_SIZE];
+    // Fields above are shared with older tools, new ones are added below only.
+    // Video rate control applied to running encoders, 0 keeps value from config file.
+    int videoKbpsHigh;    // CBR bitrate or VBR target bitrate
+    int videoMaxKbpsHigh; // VBR max bitrate
+    int videoFpsHigh;
+    int videoGopLenHigh;
+    int videoKbpsLow;
+    int videoMaxKbpsLow;
+    int videoFpsLow;
+    int videoGopLenLow;
 };
 
 
@@ -34,6 +34,9 @@ class V4l2Access
 		int setFps(int fps) {
 			return m_device->setFps(fps);
 		}
+		void requestKeyFrame() { m_device->requestKeyFrame(); }
+		void setActive(bool isActive) { m_device->setActive(isActive); }
+		void setReceiverStats(int lossPercent, int jitterMs) { m_device->setReceiverStats(lossPercent, jitterMs); }
 
 		int isReady()       { return m_device->isReady();       }
 		int start()         { return m_device->start();         }
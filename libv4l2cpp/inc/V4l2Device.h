@@ -81,6 +81,9 @@ class V4l2Device
 		static unsigned int fourcc(const char* format);
 
 		FrameRef readInternal();
+		void requestKeyFrame();
+		void setActive(bool isActive);
+		void setReceiverStats(int lossPercent, int jitterMs);
 	
 	private:
 		V4L2DeviceParameters m_params;
@@ -12,22 +12,25 @@
 #define V4L2_DUMMY_FD
 
 
+// Readable fd holding a counter of signals, each reset() takes one of them.
+// Uses eventfd in semaphore mode, pipe if eventfd is not available or not allowed.
 class V4l2DummyFd
 {
 
 public:
-    V4l2DummyFd();
+    explicit V4l2DummyFd(bool isEventFdAllowed = true);
     virtual ~V4l2DummyFd();
 
     bool signal();
-    void reset() const;
+    bool reset() const;
 
     bool isSet() const;
     int getFd() const;
 
 
 private:
-    int m_fd[2];
+    int m_fd[2]; // Read and write ends, the same fd for eventfd.
+    bool m_isEventFd;
 
 };
 
@@ -21,6 +21,9 @@ extern "C"
 }
 
 
+const int kAudioFrameIntervalMs = 40;
+
+
 static void* memcpySwap16(void *dest, const void *src, size_t n)
 {
     uint16_t *dest16 = (uint16_t*)dest;
@@ -66,7 +69,8 @@ void AnykaAudioEncoder::onStart(void *device, const audio_param &audioParams)
                 ? &memcpySwap16
                 : &memcpy;
 
-            ak_aenc_set_frame_default_interval(m_encoder, 40);
+            ak_aenc_set_frame_default_interval(m_encoder, kAudioFrameIntervalMs);
+            m_frameIntervalMs = kAudioFrameIntervalMs;
 
             m_encoderStream =  ak_aenc_request_stream(device, m_encoder);
             if (m_encoderStream != NULL)
@@ -126,10 +130,17 @@ bool AnykaAudioEncoder::readNewFrameData(FrameRef *outFrame)
                     dataLen += entry->stream.len;
                     if (outFrame->reallocIfNeed(dataLen))
                     {
+                        if (!retVal)
+                        {
+                            // Frame starts with first entry.
+                            outFrame->setTimestamp(sdkTimestampToMonotonicUs(entry->stream.ts));
+                        }
+
                         retVal = true;
                         
                         m_memcpy(outFrame->getData() + outFrame->getDataSize(), entry->stream.data, entry->stream.len);
                         outFrame->setDataSize(dataLen);
+                        outFrame->setKeyFrame(true);
                     }
                 }
 
@@ -14,8 +14,10 @@
 #include <linux/videodev2.h>
 #include "AnykaAudioEncoder.h"
 #include "FileFinder.h"
+#include "FramePool.h"
 #include <algorithm>
 #include <map>
+#include <time.h>
 
 extern "C"
 {
@@ -81,6 +83,11 @@ const std::string kConfigMotionUpdateCnt = "mdupdatecounter";
 const std::string kConfigUpdateCnt  	 = "configupdatecounter";
 const std::string kConfigPreferShared    = "prefersharedconfig";
 const std::string kConfigImageFlip       = "imageflip";
+const std::string kConfigQueueDepth      = "queuedepth";
+const std::string kConfigQueuePolicy     = "queuepolicy";
+const std::string kConfigFramePoolSize   = "framepoolsize";
+const std::string kConfigIdleTimeout     = "idletimeout";
+const std::string kConfigAbrMinKbps      = "abrminkbps";
 
 const std::map<int, int> kAkCodecToFormatMap
 {
@@ -132,6 +139,8 @@ const std::map<std::string, std::string> kDefaultMainConfig
 	{kConfigUpdateCnt       , "250"},
 	{kConfigPreferShared    , "0"},
 	{kConfigImageFlip       , "0"},
+	{kConfigFramePoolSize   , "8192"}, // KB, 0 - unlimited
+	{kConfigIdleTimeout     , "10"},   // Seconds to keep encoding without consumers, 0 - never stop
 };
 
 
@@ -155,9 +164,12 @@ const std::map<std::string, std::string> kDefaultConfig[STREAMS_COUNT]
 		{kConfigSmartStatic , "550"},
 		{kConfigMaxKbps     , "1000"},
 		{kConfigTargetKbps	, "600"},
+		{kConfigAbrMinKbps  , "500"}, // 0 - disable adaptive bitrate
 		{kConfigOsdFontSize , "32"},
 		{kConfigOsdX   	    , "20"},
 		{kConfigOsdY   	    , "24"},
+		{kConfigQueueDepth  , "10"},
+		{kConfigQueuePolicy , std::to_string(AnykaEncoderBase::DropNonKeyFirst)}, // 1
 	},
 
 	// VideoLow
@@ -178,9 +190,12 @@ const std::map<std::string, std::string> kDefaultConfig[STREAMS_COUNT]
 		{kConfigSmartStatic , "550"},
 		{kConfigMaxKbps     , "500"},
 		{kConfigTargetKbps	, "300"},
+		{kConfigAbrMinKbps  , "150"}, // 0 - disable adaptive bitrate
 		{kConfigOsdFontSize , "16"},
 		{kConfigOsdX   	    , "10"},
 		{kConfigOsdY   	    , "12"},
+		{kConfigQueueDepth  , "10"},
+		{kConfigQueuePolicy , std::to_string(AnykaEncoderBase::DropNonKeyFirst)}, // 1
 	},
 
 	// AudioHigh
@@ -188,6 +203,8 @@ const std::map<std::string, std::string> kDefaultConfig[STREAMS_COUNT]
 		{kConfigSampleRate, "8000"},
 		{kConfigChannels  , "1"},
 		{kConfigCodec	  , std::to_string(AK_AUDIO_TYPE_AAC)}, // 4
+		{kConfigQueueDepth , "10"},
+		{kConfigQueuePolicy, std::to_string(AnykaEncoderBase::DropOldest)}, // 0
 	},
 
 	// AudioLow
@@ -195,6 +212,8 @@ const std::map<std::string, std::string> kDefaultConfig[STREAMS_COUNT]
 		{kConfigSampleRate, "8000"},
 		{kConfigChannels  , "1"},
 		{kConfigCodec	  , std::to_string(AK_AUDIO_TYPE_PCM_ALAW)}, // 17
+		{kConfigQueueDepth , "10"},
+		{kConfigQueuePolicy, std::to_string(AnykaEncoderBase::DropOldest)}, // 0
 	},
 };
 
@@ -214,6 +233,19 @@ const size_t kMaxVideoBufferSize = 512 * 1024;
 const size_t kMaxAudioBufferSize = 8 * 1024;
 const int kFlipImageFlag   = 1;
 const int kMirrorImageFlag = 2;
+const int kHousekeepingIntervalMs = 10;
+const size_t kJpegQueueDepth = 2;
+const int kFramePoolTrimCounter = 1000; // Housekeeping intervals between frame pool trims.
+
+static long long getMonotonicMs()
+{
+	struct timespec curTime = {0};
+
+	return clock_gettime(CLOCK_MONOTONIC, &curTime) == 0
+		? (long long)curTime.tv_sec * 1000 + curTime.tv_nsec / 1000000
+		: 0;
+}
+
 
 static void updateDefaultConfigSection(const std::shared_ptr<ConfigFile> &config, 
 	const std::map<std::string, std::string> &defConfig, const std::string &section)
@@ -262,6 +294,9 @@ static void clearAudioOutput()
 AnykaCameraManager::AnykaStream::AnykaStream()
 	: encoder(NULL)
 	, isActivated(false)
+	, hasConsumers(false)
+	, idleSinceMs(0)
+	, isStarted(false)
 {
 }
 
@@ -270,6 +305,7 @@ AnykaCameraManager::AnykaCameraManager()
 	: m_videoDevice(NULL)
 	, m_threadId(0)
 	, m_threadStopFlag(false)
+	, m_lastJpegSequence(0)
 	, m_currentSharedConfig({0})
 	, m_sharedConfUpdateCounter(-1)
 	, m_maxSharedConfUpdateCounter(250)
@@ -279,6 +315,9 @@ AnykaCameraManager::AnykaCameraManager()
 	, m_motionDetectionFd(-1)
 	, m_abortOnError(false)
 	, m_preferSharedConfig(false)
+	, m_framePoolTrimCounter(0)
+	, m_isCaptureStarted(false)
+	, m_idleTimeoutMs(0)
 {
 	LOG(DEBUG)<<"AnykaCameraManager construct";
 
@@ -314,6 +353,11 @@ AnykaCameraManager::AnykaCameraManager()
 	m_maxSharedConfUpdateCounter = m_mainConfig.getValue(kConfigUpdateCnt, m_maxSharedConfUpdateCounter);
 	m_maxMotionCounter           = m_mainConfig.getValue(kConfigMotionUpdateCnt, m_maxMotionCounter);
 	m_preferSharedConfig         = m_mainConfig.getValue(kConfigPreferShared, 0) != 0;
+	m_idleTimeoutMs              = (long long)m_mainConfig.getValue(kConfigIdleTimeout, 0) * 1000;
+
+	FramePool::instance().setMaxBytes((size_t)m_mainConfig.getValue(kConfigFramePoolSize, 0) * 1024);
+
+	updateAdaptiveBitrateLimits();
 
 	clearAudioOutput();
 	initVideoDevice();
@@ -357,14 +401,22 @@ size_t AnykaCameraManager::startStream(const std::string &name)
 			const auto id = it->second;
 			if (!m_streams[id].isActivated)
 			{
-				m_streams[id].isActivated = true;
+				// Encoder is started by processing thread, other streams are not interrupted.
+				// Until first consumer it runs for idle timeout only, enough to get stream parameters.
+				m_streams[id].hasConsumers = false;
+				m_streams[id].idleSinceMs  = getMonotonicMs();
+				m_streams[id].isActivated  = true;
 
-				if (restartThread())
+				if (startThread())
 				{
 					streamId = id;
 
 					LOG(NOTICE)<<"success start stream with id: "<<streamId<<" for device: "<<name;
-				}	
+				}
+				else
+				{
+					m_streams[id].isActivated = false;
+				}
 			}
 			else
 			{
@@ -387,17 +439,32 @@ size_t AnykaCameraManager::startStream(const std::string &name)
 
 void AnykaCameraManager::stopStream(size_t streamId)
 {
-	if (m_streams[streamId].isActivated)
+	if (streamId < STREAMS_COUNT && m_streams[streamId].isActivated)
 	{
+		// Encoder is stopped by processing thread.
 		m_streams[streamId].isActivated = false;
 
-		restartThread();
-
 		LOG(DEBUG)<<"success stop stream with id: "<<streamId;
 	}
 }
 
 
+void AnykaCameraManager::setStreamActive(size_t streamId, bool isActive)
+{
+	if (streamId < STREAMS_COUNT && m_streams[streamId].hasConsumers != isActive)
+	{
+		if (!isActive)
+		{
+			m_streams[streamId].idleSinceMs = getMonotonicMs();
+		}
+
+		m_streams[streamId].hasConsumers = isActive;
+
+		LOG(NOTICE)<<"stream with id: "<<streamId<<(isActive ? " has consumers" : " has no consumers");
+	}
+}
+
+
 int AnykaCameraManager::getFd(size_t streamId) const
 {
 	return streamId < STREAMS_COUNT
@@ -473,6 +540,44 @@ FrameRef AnykaCameraManager::getEncodedFrame(size_t streamId)
 }
 
 
+void AnykaCameraManager::requestKeyFrame(size_t streamId)
+{
+	if (streamId < AudioHigh)
+	{
+		m_streams[streamId].encoder->requestKeyFrame();
+	}
+}
+
+
+void AnykaCameraManager::reportReceiverStats(size_t streamId, int lossPercent, int jitterMs)
+{
+	if (streamId < AudioHigh)
+	{
+		m_rateControllers[streamId].reportReceiverStats(lossPercent, jitterMs);
+	}
+}
+
+
+FrameRef AnykaCameraManager::getLastJpeg(unsigned int *outSequence)
+{
+	std::lock_guard<std::mutex> lock(m_lastJpegLock);
+
+	if (outSequence != NULL)
+	{
+		*outSequence = m_lastJpegSequence;
+	}
+
+	return m_lastJpeg;
+}
+
+
+void AnykaCameraManager::setJpegListener(const std::function<void()> &listener)
+{
+	std::lock_guard<std::mutex> lock(m_jpegListenerLock);
+	m_jpegListener = listener;
+}
+
+
 bool AnykaCameraManager::initVideoDevice()
 {
 	FileFinder configFinder;
@@ -636,44 +741,74 @@ bool AnykaCameraManager::stopAudioCapture()
 
 bool AnykaCameraManager::start()
 {
-	bool retVal = true;
+	// Start capture only, stream encoders are started by processStreams().
+	const bool retVal = setVideoParams() && startVideoCapture() && setAudioParams() && startAudioCapture();
 
-	if (std::any_of(std::begin(m_streams), std::end(m_streams), 
-			[](const AnykaStream &strm) { return strm.isActivated.load(); }))
+	if (retVal)
 	{
-		if (setVideoParams() && startVideoCapture() && setAudioParams() && startAudioCapture())
-		{
-			for (size_t i = 0; i < STREAMS_COUNT; ++i)
-			{
-				if (m_streams[i].isActivated)
-				{
-					retVal = m_streams[i].encoder->start(m_videoDevice, m_audioDevice, getVideoEncodeParams(i), getAudioEncodeParams(i)) || retVal;
-				}
-			}
-		}
+		m_jpegEncoder.setQueueParams(kJpegQueueDepth, AnykaEncoderBase::DropOldest);
 
-		if (retVal)
-		{
-			if (!m_jpegEncoder.start(m_videoDevice, NULL, getJpegEncodeParams(), getAudioEncodeParams(0)))
-			{
-				LOG(ERROR)<<"can't init jpeg stream";
-			}
-			
-			initFromConfig(m_preferSharedConfig 
-				? SharedMemory::instance().readConfig()
-				: NULL);
-		}
-		else
+		if (!m_jpegEncoder.start(m_videoDevice, NULL, getJpegEncodeParams(), getAudioEncodeParams(0)))
 		{
-			LOG(ERROR)<<"can't start streams";
-			stop();
+			LOG(ERROR)<<"can't init jpeg stream";
 		}
+		
+		initFromConfig(m_preferSharedConfig 
+			? SharedMemory::instance().readConfig()
+			: NULL);
+	}
+	else
+	{
+		LOG(ERROR)<<"can't start capture";
+		stop();
 	}
 
 	return retVal;
 }
 
 
+bool AnykaCameraManager::startEncoder(size_t streamId)
+{
+	AnykaStream &stream = m_streams[streamId];
+
+	stream.encoder->setQueueParams(m_config[streamId].getValue(kConfigQueueDepth, 0), 
+		(AnykaEncoderBase::OverflowPolicy) m_config[streamId].getValue(kConfigQueuePolicy, 0));
+
+	stream.isStarted = stream.encoder->start(m_videoDevice, m_audioDevice, getVideoEncodeParams(streamId), getAudioEncodeParams(streamId));
+
+	if (stream.isStarted)
+	{
+		LOG(NOTICE)<<"encoder started for stream with id: "<<streamId;
+	}
+	else
+	{
+		LOG(ERROR)<<"can't start encoder for stream with id: "<<streamId;
+	}
+
+	return stream.isStarted;
+}
+
+
+void AnykaCameraManager::stopEncoder(size_t streamId)
+{
+	AnykaStream &stream = m_streams[streamId];
+
+	if (stream.isStarted)
+	{
+		stream.encoder->stop();
+		stream.isStarted = false;
+
+		// Next clients start with configured bitrate.
+		if (streamId < AudioHigh)
+		{
+			m_rateControllers[streamId].reset();
+		}
+
+		LOG(NOTICE)<<"encoder stopped for stream with id: "<<streamId;
+	}
+}
+
+
 void AnykaCameraManager::initFromConfig(const SharedConfig *sharedConf)
 {
 	flipImage(sharedConf);
@@ -793,10 +928,13 @@ void AnykaCameraManager::stop()
 {
 	for (size_t i = 0; i < STREAMS_COUNT; ++i)
 	{
-		if (m_streams[i].isActivated)
-		{
-			m_streams[i].encoder->stop();
-		}
+		stopEncoder(i);
+	}
+
+	{
+		// Do not keep encoder buffer after encoder is stopped.
+		std::lock_guard<std::mutex> lock(m_lastJpegLock);
+		m_lastJpeg = FrameRef();
 	}
 
 	m_jpegEncoder.stop();
@@ -830,11 +968,16 @@ void AnykaCameraManager::stopThread()
 }
 
 
-bool AnykaCameraManager::restartThread()
+bool AnykaCameraManager::startThread()
 {
-	stopThread();
+	if (m_threadId == 0 && m_videoDevice != NULL &&
+		ak_thread_create(&m_threadId, AnykaCameraManager::thread, NULL, ANYKA_THREAD_MIN_STACK_SIZE, 90) != AK_SUCCESS)
+	{
+		LOG(ERROR)<<"can't create camera thread";
+		m_threadId = 0;
+	}
 
-	return m_videoDevice != NULL && ak_thread_create(&m_threadId, AnykaCameraManager::thread, NULL, ANYKA_THREAD_MIN_STACK_SIZE, 90) == AK_SUCCESS;
+	return m_threadId != 0;
 }
 
 
@@ -863,10 +1006,60 @@ VideoEncodeParam AnykaCameraManager::getVideoEncodeParams(size_t streamId)
 	param.maxKbps    = m_config[streamId].getValue(kConfigMaxKbps, 0);
 	param.targetKbps = m_config[streamId].getValue(kConfigTargetKbps, 0);
 
+	// Restarted encoder keeps rate control changed at runtime.
+	VideoRateControl rateControl = getVideoRateControl(streamId, &m_currentSharedConfig);
+	limitVideoRateControl(streamId, &rateControl);
+
+	param.videoParams.fps    = rateControl.fps;
+	param.videoParams.goplen = rateControl.gopLen;
+	param.maxKbps            = rateControl.maxKbps;
+
+	if (param.videoParams.br_mode == BR_MODE_VBR)
+	{
+		param.targetKbps = rateControl.kbps;
+	}
+	else
+	{
+		param.videoParams.bps = rateControl.kbps;
+	}
+
 	return param;
 }
 
 
+VideoRateControl AnykaCameraManager::getVideoRateControl(size_t streamId, const SharedConfig *sharedConf)
+{
+	const bool isVbr  = m_config[streamId].getValue(kConfigBrMode, 0) == BR_MODE_VBR;
+	const bool isHigh = streamId == VideoHigh;
+
+	const int kbps    = isHigh ? sharedConf->videoKbpsHigh    : sharedConf->videoKbpsLow;
+	const int maxKbps = isHigh ? sharedConf->videoMaxKbpsHigh : sharedConf->videoMaxKbpsLow;
+	const int fps     = isHigh ? sharedConf->videoFpsHigh     : sharedConf->videoFpsLow;
+	const int gopLen  = isHigh ? sharedConf->videoGopLenHigh  : sharedConf->videoGopLenLow;
+
+	VideoRateControl retVal = {0};
+
+	retVal.kbps    = kbps    > 0 ? kbps    : m_config[streamId].getValue(isVbr ? kConfigTargetKbps : kConfigBps, 0);
+	retVal.maxKbps = maxKbps > 0 ? maxKbps : m_config[streamId].getValue(kConfigMaxKbps, 0);
+	retVal.fps     = fps     > 0 ? fps     : m_config[streamId].getValue(kConfigFps, 0);
+	retVal.gopLen  = gopLen  > 0 ? gopLen  : m_config[streamId].getValue(kConfigGopLen, 0);
+
+	return retVal;
+}
+
+
+void AnykaCameraManager::limitVideoRateControl(size_t streamId, VideoRateControl *rateControl)
+{
+	const int limitKbps = streamId < AudioHigh ? m_rateControllers[streamId].getKbps() : 0;
+
+	if (limitKbps > 0)
+	{
+		rateControl->kbps    = std::min(rateControl->kbps, limitKbps);
+		rateControl->maxKbps = std::min(rateControl->maxKbps, limitKbps);
+	}
+}
+
+
 audio_param AnykaCameraManager::getAudioEncodeParams(size_t streamId)
 {
 	audio_param retVal = {AK_AUDIO_TYPE_UNKNOWN, 0};
@@ -897,80 +1090,121 @@ VideoEncodeParam AnykaCameraManager::getJpegEncodeParams()
 
 void AnykaCameraManager::processThread()
 {
-	// Wait to prevent frequent reinit when adding new streams and restarting thread at program start.
-	for (size_t i = 0; i < 50; ++i)
+	while (!m_threadStopFlag)
 	{
-		if (m_threadStopFlag)
+		processStreams();
+
+		// Streams are encoded by own encoder threads, here only periodic tasks.
+		if (m_isCaptureStarted)
 		{
-			break;
+			processJpeg();
 		}
 
-		ak_sleep_ms(20);
+		ak_sleep_ms(kHousekeepingIntervalMs);
+
+		if (m_isCaptureStarted)
+		{
+			m_osd.update();
+			processMotionDetection();
+			processSharedConfig();
+			processAdaptiveBitrate();
+			processFramePool();
+		}
 	}
 
-	if (!m_threadStopFlag)
+	if (m_isCaptureStarted)
 	{
-		if (start())
-		{
-			while (!m_threadStopFlag)
-			{
-				const bool isStreamsEncoded = processEncoding();
-				const bool isJpegEncoded    = processJpeg();
+		stop();
+		m_isCaptureStarted = false;
+	}
+}
 
-				if (isStreamsEncoded || isJpegEncoded)
-				{
-					ak_sleep_ms(1);
-				}
-				else
-				{
-					ak_sleep_ms(10);
-				}
 
-				m_osd.update();
-				processMotionDetection();
-				processSharedConfig();
-			}
+void AnykaCameraManager::processStreams()
+{
+	// Apply stream activation changes one by one, so other streams keep running.
+	const bool isCaptureNeeded = std::any_of(std::begin(m_streams), std::end(m_streams), 
+		[](const AnykaStream &strm) { return strm.isActivated.load(); });
 
-			stop();
-		}
-		else
+	if (isCaptureNeeded && !m_isCaptureStarted)
+	{
+		m_isCaptureStarted = start();
+
+		if (!m_isCaptureStarted)
 		{
+			// Do not retry every housekeeping interval, clients have to reopen streams.
+			for (size_t i = 0; i < STREAMS_COUNT; ++i)
+			{
+				m_streams[i].isActivated = false;
+			}
+
 			abortIfNeed();
 		}
 	}
-}
 
+	if (m_isCaptureStarted)
+	{
+		const long long curTimeMs = getMonotonicMs();
 
-bool AnykaCameraManager::processEncoding()
-{
-	bool retVal = false;
+		for (size_t i = 0; i < STREAMS_COUNT; ++i)
+		{
+			AnykaStream &stream = m_streams[i];
 
-	for (size_t i = 0; i < STREAMS_COUNT; ++i)
-	{
-		retVal = m_streams[i].encoder->encode() || retVal;
-	}
+			// Capture is kept for JPEG and motion detection, only idle encoders are stopped.
+			const bool isEncoderNeeded = stream.isActivated && 
+				(stream.hasConsumers || m_idleTimeoutMs <= 0 || curTimeMs - stream.idleSinceMs < m_idleTimeoutMs);
 
-	return retVal;
+			if (isEncoderNeeded && !stream.isStarted)
+			{
+				if (!startEncoder(i))
+				{
+					// Do not retry every housekeeping interval, client has to reopen stream.
+					stream.isActivated = false;
+					abortIfNeed();
+				}
+			}
+			else if (!isEncoderNeeded && stream.isStarted)
+			{
+				stopEncoder(i);
+			}
+		}
+
+		if (!isCaptureNeeded)
+		{
+			stop();
+			m_isCaptureStarted = false;
+		}
+	}
 }
 
 
 bool AnykaCameraManager::processJpeg()
 {
-	bool retVal = m_jpegEncoder.encode();
+	const FrameRef frame = m_jpegEncoder.getEncodedFrame();
+	const bool retVal = frame.isSet();
 
 	if (retVal)
 	{
-		const FrameRef frame = m_jpegEncoder.getEncodedFrame();
-		if (frame.isSet())
+		void *outPtr = SharedMemory::instance().lockImage(frame.getDataSize());
+
+		if (outPtr != NULL)
 		{
-			void *outPtr = SharedMemory::instance().lockImage(frame.getDataSize());
+			memcpy(outPtr, frame.getData(), frame.getDataSize());
 
-			if (outPtr != NULL)
-			{
-				memcpy(outPtr, frame.getData(), frame.getDataSize());
+			SharedMemory::instance().unlockImage(outPtr);
+		}
 
-				SharedMemory::instance().unlockImage(outPtr);
-			}
+		{
+			std::lock_guard<std::mutex> lock(m_lastJpegLock);
+			m_lastJpeg = frame;
+			++m_lastJpegSequence;
+		}
+
+		// The listener could trigger a deleted event once reset, it is called with its lock held.
+		std::lock_guard<std::mutex> lock(m_jpegListenerLock);
+		if (m_jpegListener)
+		{
+			m_jpegListener();
 		}
 	}
 
@@ -978,6 +1212,17 @@ bool AnykaCameraManager::processJpeg()
 }
 
 
+void AnykaCameraManager::processFramePool()
+{
+	if (++m_framePoolTrimCounter >= kFramePoolTrimCounter)
+	{
+		m_framePoolTrimCounter = 0;
+
+		FramePool::instance().trim();
+	}
+}
+
+
 void AnykaCameraManager::processSharedConfig()
 {
 	if (m_sharedConfUpdateCounter++ > m_maxSharedConfUpdateCounter)
@@ -1027,6 +1272,18 @@ void AnykaCameraManager::processSharedConfig()
 			flipImage(newSharedConfig);
 		}
 
+		if (newSharedConfig->videoKbpsHigh    != m_currentSharedConfig.videoKbpsHigh    ||
+			newSharedConfig->videoMaxKbpsHigh != m_currentSharedConfig.videoMaxKbpsHigh ||
+			newSharedConfig->videoFpsHigh     != m_currentSharedConfig.videoFpsHigh     ||
+			newSharedConfig->videoGopLenHigh  != m_currentSharedConfig.videoGopLenHigh  ||
+			newSharedConfig->videoKbpsLow     != m_currentSharedConfig.videoKbpsLow     ||
+			newSharedConfig->videoMaxKbpsLow  != m_currentSharedConfig.videoMaxKbpsLow  ||
+			newSharedConfig->videoFpsLow      != m_currentSharedConfig.videoFpsLow      ||
+			newSharedConfig->videoGopLenLow   != m_currentSharedConfig.videoGopLenLow)
+		{
+			updateVideoRateControl(newSharedConfig);
+		}
+
 		if (canUpdateCurrentConfig)
 		{
 			updateCurrentSharedConfig(newSharedConfig);
@@ -1035,11 +1292,62 @@ void AnykaCameraManager::processSharedConfig()
 }
 
 
+void AnykaCameraManager::updateVideoRateControl(const SharedConfig *sharedConf)
+{
+	// Stopped encoders get new values from getVideoEncodeParams() on start.
+	for (size_t i = VideoHigh; i <= VideoLow; ++i)
+	{
+		if (m_streams[i].isStarted)
+		{
+			VideoRateControl rateControl = getVideoRateControl(i, sharedConf);
+			limitVideoRateControl(i, &rateControl);
+
+			static_cast<AnykaVideoEncoder*>(m_streams[i].encoder)->setRateControl(rateControl);
+		}
+	}
+}
+
+
+void AnykaCameraManager::processAdaptiveBitrate()
+{
+	for (size_t i = VideoHigh; i <= VideoLow; ++i)
+	{
+		const AdaptiveBitrateLimits &limits = m_abrLimits[i];
+
+		// Called every housekeeping interval, receiver reports come every few seconds.
+		if (m_streams[i].isStarted && limits.minKbps > 0 && m_rateControllers[i].hasNewStats() &&
+			m_rateControllers[i].process(limits.minKbps, limits.maxKbps))
+		{
+			VideoRateControl rateControl = getVideoRateControl(i, &m_currentSharedConfig);
+			limitVideoRateControl(i, &rateControl);
+
+			static_cast<AnykaVideoEncoder*>(m_streams[i].encoder)->setRateControl(rateControl);
+		}
+	}
+}
+
+
+void AnykaCameraManager::updateAdaptiveBitrateLimits()
+{
+	for (size_t i = VideoHigh; i <= VideoLow; ++i)
+	{
+		// VBR max bitrate is limited too, so limit starts from it.
+		const VideoRateControl rateControl = getVideoRateControl(i, &m_currentSharedConfig);
+		const bool isVbr = m_config[i].getValue(kConfigBrMode, 0) == BR_MODE_VBR;
+
+		m_abrLimits[i].minKbps = m_config[i].getValue(kConfigAbrMinKbps, 0);
+		m_abrLimits[i].maxKbps = isVbr ? std::max(rateControl.kbps, rateControl.maxKbps) : rateControl.kbps;
+	}
+}
+
+
 void AnykaCameraManager::updateCurrentSharedConfig(const SharedConfig *sharedConf)
 {
 	if (sharedConf != NULL)
 	{
 		memcpy(&m_currentSharedConfig, sharedConf, sizeof(m_currentSharedConfig));
+
+		updateAdaptiveBitrateLimits();
 	}
 }
 
@@ -11,23 +11,101 @@
 
 #include "AnykaEncoderBase.h"
 #include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <sstream>
+#include <climits>
 #include "logger.h"
 
+extern "C"
+{
+    #include "ak_common.h"
+}
+
 
 const size_t kDefaultMaxBufferSize = 384 * 1024;
 const FrameRef kEmptyFrameRef;
+const int kDefaultFrameIntervalMs = 40;
+const int kPollAdvanceMs          = 2;  // Start polling encoder a bit before next frame is expected.
+const int kMinPollDelayMs         = 1;
+const int kIdlePollDelayMs        = 10; // Used when encoder is late for more than two frame intervals.
+const size_t kDefaultQueueDepth   = 10;
+const int kQueueStatsLogIntervalMs = 5000;
+const int kMinKeyFrameRequestIntervalMs = 1000; // Burst of new clients causes single key frame.
+
+
+// Minimal difference between CLOCK_MONOTONIC and SDK timestamps seen by any encoder,
+// SDK clock base is not documented so it is learned from frames pickup time.
+static std::atomic<long long> sdkClockOffsetUs(LLONG_MAX);
+
+
+static long long getMonotonicUs()
+{
+    struct timespec curTime = {0};
+
+    return clock_gettime(CLOCK_MONOTONIC, &curTime) == 0
+        ? (long long)curTime.tv_sec * 1000000 + curTime.tv_nsec / 1000
+        : 0;
+}
+
+
+static long long getMonotonicMs()
+{
+    struct timespec curTime = {0};
+
+    return clock_gettime(CLOCK_MONOTONIC, &curTime) == 0
+        ? (long long)curTime.tv_sec * 1000 + curTime.tv_nsec / 1000000
+        : 0;
+}
 
 
 AnykaEncoderBase::AnykaEncoderBase()
     : m_encoder(NULL)
 	, m_encoderStream(NULL)
+    , m_frameIntervalMs(kDefaultFrameIntervalMs)
+    , m_threadId(0)
+    , m_threadStopFlag(false)
+    , m_lastFrameTimeMs(0)
 	, m_freeFrame(m_frameBuffer.getFreeFrame())
+    , m_queueDepth(kDefaultQueueDepth)
+    , m_queuePolicy(DropOldest)
+    , m_waitKeyFrame(false)
+    , m_lastStatsLogTimeMs(0)
+    , m_pushedFrames(0)
+    , m_droppedOldestFrames(0)
+    , m_droppedNonKeyFrames(0)
+    , m_blockedFrames(0)
+    , m_keyFrameRequested(false)
+    , m_lastKeyFrameRequestMs(0)
 {
 }
 
 
+void AnykaEncoderBase::setQueueParams(size_t depth, OverflowPolicy policy)
+{
+    m_queueDepth  = depth > 0 ? depth : kDefaultQueueDepth;
+    m_queuePolicy = policy;
+}
+
+
+AnykaEncoderBase::QueueStats AnykaEncoderBase::getQueueStats() const
+{
+    QueueStats retVal;
+    retVal.pushed        = m_pushedFrames;
+    retVal.droppedOldest = m_droppedOldestFrames;
+    retVal.droppedNonKey = m_droppedNonKeyFrames;
+    retVal.blocked       = m_blockedFrames;
+
+    return retVal;
+}
+
+
 bool AnykaEncoderBase::start(void *videoDevice, void *audioDevice, const VideoEncodeParam &videoParams, const audio_param &audioParams)
 {
+    m_encodedFrames.init(m_queueDepth);
+    m_waitKeyFrame = false;
+    m_keyFrameRequested = false;
+
     if (isAudioEncoder())
     {
         onStart(audioDevice, audioParams);
@@ -37,6 +115,11 @@ bool AnykaEncoderBase::start(void *videoDevice, void *audioDevice, const VideoEn
         onStart(videoDevice, videoParams); 
     }
 
+    if (isSet())
+    {
+        startThread();
+    }
+
     return isSet();
 }
 
@@ -51,13 +134,27 @@ void AnykaEncoderBase::onStart(void *device, const audio_param &audioParams)
 }
 
 
+bool AnykaEncoderBase::onKeyFrameRequest()
+{
+    return false;
+}
+
+
 void AnykaEncoderBase::stop()
 {
-    m_signalFd.reset();
+    const bool wasStarted = m_threadId != 0;
 
-    m_encodedFramesLock.lock();
-    m_encodedFrames.clear();
-    m_encodedFramesLock.unlock();
+    stopThread();
+
+    FrameRef frame;
+    while (m_signalFd.reset() && m_encodedFrames.tryPop(&frame))
+    {
+    }
+
+    if (wasStarted)
+    {
+        logQueueStats(false);
+    }
 
     m_frameBuffer.clear();
     m_freeFrame = m_frameBuffer.getFreeFrame();
@@ -81,23 +178,12 @@ bool AnykaEncoderBase::encode()
         // Try encode new frame.
         if (readNewFrameData(&m_freeFrame))
         {
-            m_encodedFramesLock.lock();
-
-            const bool needSignal = m_encodedFrames.size() == 0;
-
-            m_encodedFrames.push_back(m_freeFrame);
-
-            if (m_encodedFrames.size() > 10)
+            if (m_freeFrame.isKeyFrame())
             {
-                LOG(WARN)<<"Encoded buffer overflow: "<<m_encodedFrames.size()<<"\n";
+                m_keyFrameRequested = false;
             }
 
-            m_encodedFramesLock.unlock();
-
-            if (needSignal)
-            {
-                m_signalFd.signal();
-            }
+            pushEncodedFrame(m_freeFrame);
 
             m_freeFrame = m_frameBuffer.getFreeFrame();
             retVal = true;
@@ -116,26 +202,233 @@ int AnykaEncoderBase::getEncodedFrameReadyFd() const
 
 FrameRef AnykaEncoderBase::getEncodedFrame()
 {
-    m_encodedFramesLock.lock();
+    FrameRef retVal = kEmptyFrameRef;
+
+    if (m_signalFd.reset() && !m_encodedFrames.tryPop(&retVal))
+    {
+        LOG(ERROR)<<"Encoded frames queue is out of sync with signal fd";
+    }
+
+    return retVal;
+}
+
+
+void AnykaEncoderBase::requestKeyFrame()
+{
+    m_keyFrameRequested = true;
+}
+
+
+void AnykaEncoderBase::processKeyFrameRequest()
+{
+    if (m_keyFrameRequested)
+    {
+        const long long curTimeMs = getMonotonicMs();
+
+        if (curTimeMs - m_lastKeyFrameRequestMs >= kMinKeyFrameRequestIntervalMs)
+        {
+            m_keyFrameRequested     = false;
+            m_lastKeyFrameRequestMs = curTimeMs;
+
+            if (onKeyFrameRequest())
+            {
+                LOG(DEBUG)<<"Key frame requested";
+            }
+        }
+    }
+}
+
+
+void AnykaEncoderBase::pushEncodedFrame(const FrameRef &frame)
+{
+    bool isPushed   = false;
+    bool isOverflow = false;
+
+    if (m_queuePolicy == DropNonKeyFirst && m_waitKeyFrame && !frame.isKeyFrame())
+    {
+        // Frames after dropped one can't be decoded anyway.
+        ++m_droppedNonKeyFrames;
+    }
+    else
+    {
+        m_waitKeyFrame = false;
+
+        while (!(isPushed = m_encodedFrames.tryPush(frame)))
+        {
+            isOverflow = true;
+
+            if (m_queuePolicy == Block)
+            {
+                if (m_threadStopFlag)
+                {
+                    break;
+                }
 
-    const FrameRef retVal = m_encodedFrames.size() > 0
-        ? m_encodedFrames.front()
-        : kEmptyFrameRef;
+                ak_sleep_ms(kMinPollDelayMs);
+            }
+            else if (m_queuePolicy == DropNonKeyFirst && !frame.isKeyFrame())
+            {
+                ++m_droppedNonKeyFrames;
+                m_waitKeyFrame = true;
+                break;
+            }
+            else if (!dropOldestFrame())
+            {
+                // Consumer is taking the oldest frame right now.
+                ak_sleep_ms(kMinPollDelayMs);
+            }
+        }
+    }
 
-    if (m_encodedFrames.size() > 0)
+    if (isPushed)
     {
-        m_encodedFrames.pop_front();
+        ++m_pushedFrames;
+        m_signalFd.signal();
+    }
 
-        if (m_encodedFrames.size() == 0)
+    if (isOverflow)
+    {
+        if (m_queuePolicy == Block)
         {
-            m_signalFd.reset();
+            ++m_blockedFrames;
         }
+
+        logQueueStats(true);
     }
+}
+
+
+bool AnykaEncoderBase::dropOldestFrame()
+{
+    FrameRef frame;
 
-    m_encodedFramesLock.unlock();
+    const bool retVal = m_signalFd.reset() && m_encodedFrames.tryPop(&frame);
+
+    if (retVal)
+    {
+        ++m_droppedOldestFrames;
+    }
 
     return retVal;
 }
 
 
+void AnykaEncoderBase::logQueueStats(bool isOverflow)
+{
+    const long long curTimeMs = getMonotonicMs();
+
+    if (!isOverflow || curTimeMs - m_lastStatsLogTimeMs >= kQueueStatsLogIntervalMs)
+    {
+        m_lastStatsLogTimeMs = curTimeMs;
+
+        std::ostringstream stats;
+        stats<<"Encoded frames queue depth: "<<m_encodedFrames.getCapacity()
+            <<" policy: "<<m_queuePolicy
+            <<" pushed: "<<m_pushedFrames
+            <<" dropped oldest: "<<m_droppedOldestFrames
+            <<" dropped non key: "<<m_droppedNonKeyFrames
+            <<" blocked: "<<m_blockedFrames;
+
+        if (isOverflow)
+        {
+            LOG(WARN)<<stats.str();
+        }
+        else
+        {
+            LOG(NOTICE)<<stats.str();
+        }
+    }
+}
+
+
+long long AnykaEncoderBase::sdkTimestampToMonotonicUs(unsigned long long timestampMs)
+{
+    const long long timestampUs = (long long)timestampMs * 1000;
+    const long long offsetUs    = getMonotonicUs() - timestampUs;
+
+    long long curOffsetUs = sdkClockOffsetUs;
+    while (offsetUs < curOffsetUs && !sdkClockOffsetUs.compare_exchange_weak(curOffsetUs, offsetUs))
+    {
+    }
+
+    return timestampUs + std::min(offsetUs, curOffsetUs);
+}
+
+
+void AnykaEncoderBase::startThread()
+{
+    stopThread();
+
+    m_lastFrameTimeMs = getMonotonicMs();
+
+    if (ak_thread_create(&m_threadId, AnykaEncoderBase::thread, this, ANYKA_THREAD_MIN_STACK_SIZE, 90) != AK_SUCCESS)
+    {
+        LOG(ERROR)<<"Create encoder thread failed";
+        m_threadId = 0;
+    }
+}
+
+
+void AnykaEncoderBase::stopThread()
+{
+    if (m_threadId != 0)
+    {
+        m_threadStopFlag = true;
+        ak_thread_join(m_threadId);
+        m_threadId = 0;
+        m_threadStopFlag = false;
+    }
+}
+
+
+void AnykaEncoderBase::processThread()
+{
+    while (!m_threadStopFlag)
+    {
+        processKeyFrameRequest();
 
+        if (encode())
+        {
+            // Do not sleep after success: encoder may already hold next frame.
+            m_lastFrameTimeMs = getMonotonicMs();
+        }
+        else
+        {
+            ak_sleep_ms(getPollDelayMs());
+        }
+    }
+}
+
+
+int AnykaEncoderBase::getPollDelayMs() const
+{
+    // SDK does not expose any waitable descriptor for encoded stream, so sleep until
+    // next frame is expected and then poll with minimal delay until it is ready.
+    const long long elapsedMs = getMonotonicMs() - m_lastFrameTimeMs;
+    const long long untilNextFrameMs = m_frameIntervalMs - elapsedMs - kPollAdvanceMs;
+
+    if (untilNextFrameMs > kMinPollDelayMs)
+    {
+        return (int)untilNextFrameMs;
+    }
+
+    return elapsedMs > m_frameIntervalMs * 2
+        ? std::min(kIdlePollDelayMs, std::max(m_frameIntervalMs, kMinPollDelayMs))
+        : kMinPollDelayMs;
+}
+
+
+void* AnykaEncoderBase::thread(void *arg)
+{
+    AnykaEncoderBase *ptr = static_cast<AnykaEncoderBase*>(arg);
+
+    LOG(DEBUG)<<"AnykaEncoderBase thread started";
+
+    ptr->processThread();
+
+    LOG(DEBUG)<<"AnykaEncoderBase thread stopped";
+
+    ak_thread_exit();
+
+    return NULL;
+}
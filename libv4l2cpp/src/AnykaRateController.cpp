@@ -0,0 +1,128 @@
+/* ---------------------------------------------------------------------------
+** This software is in the public domain, furnished "as is", without technical
+** support, and with no warranty, express or implied, as to its usefulness for
+** any purpose.
+**
+** AnykaRateController.cpp
+**
+**
+** -------------------------------------------------------------------------*/
+
+
+#include "AnykaRateController.h"
+#include <algorithm>
+#include <time.h>
+#include "logger.h"
+
+
+// Bitrate is cut fast on congestion and restored slowly, so the link is not
+// overloaded again right after it recovers.
+const int kHighLossPercent       = 10;
+const int kLowLossPercent        = 2;
+const int kHighJitterMs          = 150;
+const int kLossDecreasePercent   = 70;
+const int kJitterDecreasePercent = 90;
+const int kIncreaseStepPercent   = 5;  // Of max bitrate.
+const int kMinDecreaseIntervalMs = 2000;
+const int kIncreaseHoldMs        = 10000; // After last decrease.
+const int kMinIncreaseIntervalMs = 2000;
+
+
+static long long getMonotonicMs()
+{
+    struct timespec curTime = {0};
+
+    return clock_gettime(CLOCK_MONOTONIC, &curTime) == 0
+        ? (long long)curTime.tv_sec * 1000 + curTime.tv_nsec / 1000000
+        : 0;
+}
+
+
+AnykaRateController::AnykaRateController()
+    : m_hasNewStats(false)
+    , m_lossPercent(0)
+    , m_jitterMs(0)
+    , m_kbps(0)
+    , m_lastDecreaseTimeMs(0)
+    , m_lastIncreaseTimeMs(0)
+{
+}
+
+
+void AnykaRateController::reportReceiverStats(int lossPercent, int jitterMs)
+{
+    m_lossPercent = lossPercent;
+    m_jitterMs    = jitterMs;
+    m_hasNewStats = true;
+}
+
+
+bool AnykaRateController::hasNewStats() const
+{
+    return m_hasNewStats;
+}
+
+
+bool AnykaRateController::process(int minKbps, int maxKbps)
+{
+    if (!m_hasNewStats.exchange(false))
+    {
+        return false;
+    }
+
+    const long long curTimeMs = getMonotonicMs();
+    const int lossPercent     = m_lossPercent;
+    const int jitterMs        = m_jitterMs;
+
+    if (m_kbps <= 0)
+    {
+        m_kbps = maxKbps;
+    }
+
+    const int prevKbps = m_kbps;
+
+    // Configured bitrate could be changed meanwhile.
+    m_kbps = std::max(minKbps, std::min(maxKbps, m_kbps));
+
+    const bool canDecrease = curTimeMs - m_lastDecreaseTimeMs >= kMinDecreaseIntervalMs;
+
+    if (lossPercent >= kHighLossPercent && canDecrease)
+    {
+        m_kbps = std::max(minKbps, m_kbps * kLossDecreasePercent / 100);
+        m_lastDecreaseTimeMs = curTimeMs;
+    }
+    else if (jitterMs >= kHighJitterMs && canDecrease)
+    {
+        m_kbps = std::max(minKbps, m_kbps * kJitterDecreasePercent / 100);
+        m_lastDecreaseTimeMs = curTimeMs;
+    }
+    else if (lossPercent <= kLowLossPercent && jitterMs < kHighJitterMs &&
+        curTimeMs - m_lastDecreaseTimeMs >= kIncreaseHoldMs &&
+        curTimeMs - m_lastIncreaseTimeMs >= kMinIncreaseIntervalMs)
+    {
+        m_kbps = std::min(maxKbps, m_kbps + std::max(1, maxKbps * kIncreaseStepPercent / 100));
+        m_lastIncreaseTimeMs = curTimeMs;
+    }
+
+    if (m_kbps != prevKbps)
+    {
+        LOG(NOTICE)<<"Adaptive bitrate: "<<m_kbps<<" kbps, loss: "<<lossPercent<<"% jitter: "<<jitterMs<<" ms";
+    }
+
+    return m_kbps != prevKbps;
+}
+
+
+int AnykaRateController::getKbps() const
+{
+    return m_kbps;
+}
+
+
+void AnykaRateController::reset()
+{
+    m_hasNewStats        = false;
+    m_kbps               = 0;
+    m_lastDecreaseTimeMs = 0;
+    m_lastIncreaseTimeMs = 0;
+}
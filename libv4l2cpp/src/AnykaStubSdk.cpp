@@ -0,0 +1,824 @@
+/* ---------------------------------------------------------------------------
+** This software is in the public domain, furnished "as is", without technical
+** support, and with no warranty, express or implied, as to its usefulness for
+** any purpose.
+**
+** AnykaStubSdk.cpp
+**
+** Minimal replacement of Anyka SDK for running on plain Linux box.
+** Encoders produce synthetic frames in real time (not decodable) and report
+** delay between frame ready time and the moment it was taken from encoder.
+** Build with -DANYKA_STUB_SDK=ON, "sensor" option may point to any existing file.
+**
+** -------------------------------------------------------------------------*/
+
+
+#ifdef ANYKA_STUB_SDK
+
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <utility>
+#include "logger.h"
+
+extern "C"
+{
+    #include "ak_common.h"
+    #include "ak_thread.h"
+    #include "ak_global.h"
+    #include "ak_vi.h"
+    #include "ak_ai.h"
+    #include "ak_ao.h"
+    #include "ak_venc.h"
+    #include "ak_aenc.h"
+    #include "ak_md.h"
+    #include "ak_osd.h"
+    #include "ak_vpss.h"
+}
+
+
+const unsigned char kStartCode[]       = {0, 0, 0, 1};
+const size_t kStubStatsFrames          = 250;
+const int kStubDefaultAudioIntervalMs  = 40;
+
+static int stubViHandle;
+static int stubAiHandle;
+static int stubAoHandle;
+
+
+static long long getStubTimeUs()
+{
+    struct timespec curTime = {0};
+    clock_gettime(CLOCK_MONOTONIC, &curTime);
+
+    return (long long)curTime.tv_sec * 1000000 + curTime.tv_nsec / 1000;
+}
+
+
+struct StubStream
+{
+    StubStream(const char *streamName, long long frameIntervalUs)
+        : name(streamName)
+        , intervalUs(frameIntervalUs > 0 ? frameIntervalUs : 40000)
+        , startUs(getStubTimeUs())
+        , seqNo(0)
+        , statFrames(0)
+        , statSumUs(0)
+        , statMaxUs(0)
+    {
+    }
+
+    // Return ready time of next frame or 0 if encoder has no frame yet.
+    long long nextReadyTime() const
+    {
+        const long long readyUs = startUs + (long long)seqNo * intervalUs;
+
+        return readyUs <= getStubTimeUs()
+            ? readyUs
+            : 0;
+    }
+
+    void onFrameTaken(long long readyUs)
+    {
+        const long long latencyUs = getStubTimeUs() - readyUs;
+
+        ++seqNo;
+        ++statFrames;
+        statSumUs += latencyUs;
+        statMaxUs = std::max(statMaxUs, latencyUs);
+
+        if (statFrames >= kStubStatsFrames)
+        {
+            LOG(NOTICE)<<"stub "<<name<<" frames: "<<statFrames
+                <<" pickup latency avg: "<<statSumUs / (long long)statFrames
+                <<" us max: "<<statMaxUs<<" us";
+
+            statFrames = 0;
+            statSumUs  = 0;
+            statMaxUs  = 0;
+        }
+    }
+
+    const char *name;
+    long long intervalUs;
+    long long startUs;
+    unsigned long seqNo;
+    size_t statFrames;
+    long long statSumUs;
+    long long statMaxUs;
+};
+
+
+struct StubVideoEncoder
+{
+    StubVideoEncoder()
+        : gopStartSeqNo(0)
+        , isIframeRequested(false)
+    {
+    }
+
+    // Decide frame type, forced I frame starts new GOP.
+    bool isIdrFrame(unsigned long seqNo)
+    {
+        const int fps    = param.fps > 0 ? param.fps : 25;
+        const int gopLen = param.goplen > 0 ? param.goplen : fps;
+
+        if (isIframeRequested.exchange(false))
+        {
+            gopStartSeqNo = seqNo;
+        }
+
+        return (seqNo - gopStartSeqNo) % gopLen == 0;
+    }
+
+    encode_param param;
+    unsigned long gopStartSeqNo;
+    std::atomic_bool isIframeRequested;
+};
+
+
+struct StubAudioEncoder
+{
+    audio_param param;
+    int intervalMs;
+};
+
+
+static size_t appendNal(unsigned char *out, const unsigned char *header, size_t headerSize, size_t payloadSize)
+{
+    memcpy(out, kStartCode, sizeof(kStartCode));
+    memcpy(out + sizeof(kStartCode), header, headerSize);
+    memset(out + sizeof(kStartCode) + headerSize, 0xAA, payloadSize);
+
+    return sizeof(kStartCode) + headerSize + payloadSize;
+}
+
+
+static size_t makeVideoFrame(const encode_param &param, bool isIdr, unsigned char *out)
+{
+    const int fps           = param.fps > 0 ? param.fps : 25;
+    const size_t frameBytes = std::max<size_t>(64, (size_t)param.bps * 1000 / 8 / fps);
+    const size_t sliceBytes = isIdr ? frameBytes * 4 : frameBytes;
+
+    size_t size = 0;
+
+    if (param.enc_out_type == MJPEG_ENC_TYPE)
+    {
+        const unsigned char soi[] = {0xFF, 0xD8, 0xFF, 0xE0};
+        const unsigned char eoi[] = {0xFF, 0xD9};
+
+        memcpy(out, soi, sizeof(soi));
+        memset(out + sizeof(soi), 0xAA, frameBytes);
+        memcpy(out + sizeof(soi) + frameBytes, eoi, sizeof(eoi));
+        size = sizeof(soi) + frameBytes + sizeof(eoi);
+    }
+    else if (param.enc_out_type == HEVC_ENC_TYPE)
+    {
+        const unsigned char vps[]   = {0x40, 0x01};
+        const unsigned char sps[]   = {0x42, 0x01};
+        const unsigned char pps[]   = {0x44, 0x01};
+        const unsigned char idr[]   = {0x26, 0x01};
+        const unsigned char trail[] = {0x02, 0x01};
+
+        if (isIdr)
+        {
+            size += appendNal(out + size, vps, sizeof(vps), 16);
+            size += appendNal(out + size, sps, sizeof(sps), 32);
+            size += appendNal(out + size, pps, sizeof(pps), 8);
+            size += appendNal(out + size, idr, sizeof(idr), sliceBytes);
+        }
+        else
+        {
+            size += appendNal(out + size, trail, sizeof(trail), sliceBytes);
+        }
+    }
+    else
+    {
+        const unsigned char sps[]   = {0x67, 0x4D, 0x00, 0x1F};
+        const unsigned char pps[]   = {0x68};
+        const unsigned char idr[]   = {0x65};
+        const unsigned char slice[] = {0x41};
+
+        if (isIdr)
+        {
+            size += appendNal(out + size, sps, sizeof(sps), 16);
+            size += appendNal(out + size, pps, sizeof(pps), 4);
+            size += appendNal(out + size, idr, sizeof(idr), sliceBytes);
+        }
+        else
+        {
+            size += appendNal(out + size, slice, sizeof(slice), sliceBytes);
+        }
+    }
+
+    return size;
+}
+
+
+static size_t getVideoFrameMaxSize(const encode_param &param)
+{
+    const int fps = param.fps > 0 ? param.fps : 25;
+
+    return std::max<size_t>(64, (size_t)param.bps * 1000 / 8 / fps) * 4 + 256;
+}
+
+
+static size_t getAudioFrameSize(const audio_param &param, int intervalMs)
+{
+    const size_t pcmSize = param.sample_rate * param.channel_num * 2 * intervalMs / 1000;
+
+    switch (param.type)
+    {
+        case AK_AUDIO_TYPE_PCM:      return pcmSize;
+        case AK_AUDIO_TYPE_PCM_ALAW:
+        case AK_AUDIO_TYPE_PCM_ULAW: return pcmSize / 2;
+        default:                     return std::max<size_t>(16, pcmSize / 16);
+    }
+}
+
+
+extern "C"
+{
+
+// Common.
+int ak_print_set_level(int level)
+{
+    return AK_SUCCESS;
+}
+
+
+void ak_sleep_ms(const int ms)
+{
+    usleep(ms * 1000);
+}
+
+
+// Threads.
+int ak_thread_create(ak_pthread_t *id, thread_func func, void *arg, int stack_size, int priority)
+{
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, stack_size);
+
+    const int retVal = pthread_create(id, &attr, func, arg) == 0
+        ? AK_SUCCESS
+        : AK_FAILED;
+
+    pthread_attr_destroy(&attr);
+
+    return retVal;
+}
+
+
+int ak_thread_join(ak_pthread_t id)
+{
+    return pthread_join(id, NULL);
+}
+
+
+void ak_thread_exit(void)
+{
+    // Thread functions return right after this call.
+}
+
+
+// Video input.
+int ak_vi_match_sensor(const char *config_file)
+{
+    return AK_SUCCESS;
+}
+
+
+void* ak_vi_open(enum video_dev_type dev)
+{
+    return &stubViHandle;
+}
+
+
+int ak_vi_close(void *handle)
+{
+    return AK_SUCCESS;
+}
+
+
+int ak_vi_set_channel_attr(void *handle, const struct video_channel_attr *attr)
+{
+    return AK_SUCCESS;
+}
+
+
+int ak_vi_set_fps(void *handle, int fps)
+{
+    return AK_SUCCESS;
+}
+
+
+int ak_vi_capture_on(void *handle)
+{
+    return AK_SUCCESS;
+}
+
+
+int ak_vi_capture_off(void *handle)
+{
+    return AK_SUCCESS;
+}
+
+
+int ak_vi_set_flip_mirror(void *handle, int flip_enable, int mirror_enable)
+{
+    return AK_SUCCESS;
+}
+
+
+int ak_vi_switch_mode(void *handle, enum video_daynight_mode mode)
+{
+    return AK_SUCCESS;
+}
+
+
+// Audio input/output.
+void* ak_ai_open(const struct pcm_param *param)
+{
+    return &stubAiHandle;
+}
+
+
+int ak_ai_close(void *handle)
+{
+    return AK_SUCCESS;
+}
+
+
+int ak_ai_set_source(void *handle, enum ai_source src)
+{
+    return AK_SUCCESS;
+}
+
+
+int ak_ai_set_aec(void *handle, int enable)
+{
+    return AK_SUCCESS;
+}
+
+
+int ak_ai_set_nr_agc(void *handle, int enable)
+{
+    return AK_SUCCESS;
+}
+
+
+int ak_ai_set_resample(void *handle, int enable)
+{
+    return AK_SUCCESS;
+}
+
+
+int ak_ai_set_adc_volume(void *handle, int volume)
+{
+    return AK_SUCCESS;
+}
+
+
+int ak_ai_set_aslc_volume(void *handle, int volume)
+{
+    return AK_SUCCESS;
+}
+
+
+int ak_ai_clear_frame_buffer(void *handle)
+{
+    return AK_SUCCESS;
+}
+
+
+int ak_ai_set_frame_interval(void *handle, int frame_interval)
+{
+    return AK_SUCCESS;
+}
+
+
+int ak_ai_start_capture(void *handle)
+{
+    return AK_SUCCESS;
+}
+
+
+int ak_ai_stop_capture(void *handle)
+{
+    return AK_SUCCESS;
+}
+
+
+void* ak_ao_open(const struct pcm_param *param)
+{
+    return &stubAoHandle;
+}
+
+
+int ak_ao_close(void *ao_handle)
+{
+    return AK_SUCCESS;
+}
+
+
+int ak_ao_enable_speaker(void *ao_handle, int enable)
+{
+    return AK_SUCCESS;
+}
+
+
+int ak_ao_set_resample(void *ao_handle, int enable)
+{
+    return AK_SUCCESS;
+}
+
+
+int ak_ao_set_dac_volume(void *ao_handle, int volume)
+{
+    return AK_SUCCESS;
+}
+
+
+int ak_ao_set_aslc_volume(void *ao_handle, int volume)
+{
+    return AK_SUCCESS;
+}
+
+
+int ak_ao_clear_frame_buffer(void *ao_handle)
+{
+    return AK_SUCCESS;
+}
+
+
+// Video encoder.
+void* ak_venc_open(const struct encode_param *param)
+{
+    StubVideoEncoder *encoder = new StubVideoEncoder();
+    encoder->param = *param;
+
+    return encoder;
+}
+
+
+int ak_venc_close(void *enc_handle)
+{
+    delete static_cast<StubVideoEncoder*>(enc_handle);
+
+    return AK_SUCCESS;
+}
+
+
+int ak_venc_set_kbps(void *enc_handle, int target_bps, int max_bps)
+{
+    return AK_SUCCESS;
+}
+
+
+int ak_venc_set_rc(void *enc_handle, int bps)
+{
+    static_cast<StubVideoEncoder*>(enc_handle)->param.bps = bps;
+
+    return AK_SUCCESS;
+}
+
+
+int ak_venc_set_fps(void *enc_handle, int fps)
+{
+    static_cast<StubVideoEncoder*>(enc_handle)->param.fps = fps;
+
+    return AK_SUCCESS;
+}
+
+
+int ak_venc_set_gop_len(void *enc_handle, int gop_len)
+{
+    static_cast<StubVideoEncoder*>(enc_handle)->param.goplen = gop_len;
+
+    return AK_SUCCESS;
+}
+
+
+int ak_venc_set_iframe(void *enc_handle)
+{
+    static_cast<StubVideoEncoder*>(enc_handle)->isIframeRequested = true;
+
+    return AK_SUCCESS;
+}
+
+
+int ak_venc_set_smart_config(void *enc_handle, struct venc_smart_cfg *cfg)
+{
+    return AK_SUCCESS;
+}
+
+
+void* ak_venc_request_stream(void *vi_handle, void *enc_handle)
+{
+    StubVideoEncoder *encoder = static_cast<StubVideoEncoder*>(enc_handle);
+    const int fps = encoder->param.fps > 0 ? encoder->param.fps : 25;
+
+    return new std::pair<StubVideoEncoder*, StubStream>(encoder,
+        StubStream(encoder->param.enc_out_type == MJPEG_ENC_TYPE ? "jpeg" : "video", 1000000 / fps));
+}
+
+
+int ak_venc_cancel_stream(void *stream_handle)
+{
+    delete static_cast<std::pair<StubVideoEncoder*, StubStream>*>(stream_handle);
+
+    return AK_SUCCESS;
+}
+
+
+int ak_venc_get_stream_ex(void *stream_handle, char *buffer, size_t bufferSize, size_t *outSize)
+{
+    std::pair<StubVideoEncoder*, StubStream> *stream = static_cast<std::pair<StubVideoEncoder*, StubStream>*>(stream_handle);
+    const encode_param &param = stream->first->param;
+
+    *outSize = 0;
+
+    const long long readyUs = stream->second.nextReadyTime();
+    if (readyUs == 0)
+    {
+        return AK_FAILED;
+    }
+
+    const size_t maxSize = getVideoFrameMaxSize(param);
+    if (buffer == NULL || bufferSize < maxSize)
+    {
+        *outSize = maxSize;
+        return AK_FAILED;
+    }
+
+    *outSize = makeVideoFrame(param, stream->first->isIdrFrame(stream->second.seqNo), (unsigned char*)buffer);
+    stream->second.onFrameTaken(readyUs);
+
+    return AK_SUCCESS;
+}
+
+
+int ak_venc_get_stream(void *stream_handle, struct video_stream *stream)
+{
+    std::pair<StubVideoEncoder*, StubStream> *streamPair = static_cast<std::pair<StubVideoEncoder*, StubStream>*>(stream_handle);
+    const encode_param &param = streamPair->first->param;
+
+    const long long readyUs = streamPair->second.nextReadyTime();
+    if (readyUs == 0)
+    {
+        return AK_FAILED;
+    }
+
+    const bool isIdr = streamPair->first->isIdrFrame(streamPair->second.seqNo);
+
+    stream->data       = (unsigned char*)malloc(getVideoFrameMaxSize(param));
+    stream->len        = makeVideoFrame(param, isIdr, stream->data);
+    stream->ts         = readyUs / 1000;
+    stream->seq_no     = streamPair->second.seqNo;
+    stream->frame_type = isIdr ? FRAME_TYPE_I : FRAME_TYPE_P;
+
+    streamPair->second.onFrameTaken(readyUs);
+
+    return AK_SUCCESS;
+}
+
+
+int ak_venc_release_stream(void *stream_handle, struct video_stream *stream)
+{
+    free(stream->data);
+    stream->data = NULL;
+
+    return AK_SUCCESS;
+}
+
+
+// Audio encoder.
+void* ak_aenc_open(const struct audio_param *param)
+{
+    StubAudioEncoder *encoder = new StubAudioEncoder();
+    encoder->param      = *param;
+    encoder->intervalMs = kStubDefaultAudioIntervalMs;
+
+    return encoder;
+}
+
+
+int ak_aenc_close(void *enc_handle)
+{
+    delete static_cast<StubAudioEncoder*>(enc_handle);
+
+    return AK_SUCCESS;
+}
+
+
+int ak_aenc_set_frame_default_interval(void *enc_handle, int frame_interval)
+{
+    static_cast<StubAudioEncoder*>(enc_handle)->intervalMs = frame_interval;
+
+    return AK_SUCCESS;
+}
+
+
+void* ak_aenc_request_stream(void *ai_handle, void *enc_handle)
+{
+    StubAudioEncoder *encoder = static_cast<StubAudioEncoder*>(enc_handle);
+
+    return new std::pair<StubAudioEncoder*, StubStream>(encoder,
+        StubStream("audio", (long long)encoder->intervalMs * 1000));
+}
+
+
+int ak_aenc_cancel_stream(void *stream_handle)
+{
+    delete static_cast<std::pair<StubAudioEncoder*, StubStream>*>(stream_handle);
+
+    return AK_SUCCESS;
+}
+
+
+int ak_aenc_get_stream(void *stream_handle, struct list_head *stream_head)
+{
+    std::pair<StubAudioEncoder*, StubStream> *stream = static_cast<std::pair<StubAudioEncoder*, StubStream>*>(stream_handle);
+    const size_t frameSize = getAudioFrameSize(stream->first->param, stream->first->intervalMs);
+
+    int retVal = AK_FAILED;
+
+    long long readyUs = 0;
+    while ((readyUs = stream->second.nextReadyTime()) != 0)
+    {
+        struct aenc_entry *entry = (struct aenc_entry*)calloc(1, sizeof(struct aenc_entry) + frameSize);
+        entry->stream.data   = (unsigned char*)(entry + 1);
+        entry->stream.len    = frameSize;
+        entry->stream.ts     = readyUs / 1000;
+        entry->stream.seq_no = stream->second.seqNo;
+        list_add_tail(&entry->list, stream_head);
+
+        stream->second.onFrameTaken(readyUs);
+        retVal = AK_SUCCESS;
+    }
+
+    return retVal;
+}
+
+
+int ak_aenc_release_stream(struct aenc_entry *entry)
+{
+    list_del(&entry->list);
+    free(entry);
+
+    return AK_SUCCESS;
+}
+
+
+// Motion detection.
+int ak_md_init(void *vi_handle)
+{
+    return AK_SUCCESS;
+}
+
+
+void ak_md_destroy(void)
+{
+}
+
+
+int ak_md_enable(int enable)
+{
+    return AK_SUCCESS;
+}
+
+
+int ak_md_set_fps(int fps)
+{
+    return AK_SUCCESS;
+}
+
+
+int ak_md_get_dimension_max(int *horizon_num, int *vertical_num)
+{
+    *horizon_num  = 16;
+    *vertical_num = 16;
+
+    return AK_SUCCESS;
+}
+
+
+int ak_md_set_global_sensitivity(int sensitivity)
+{
+    return AK_SUCCESS;
+}
+
+
+int ak_md_set_area_sensitivity(int horizon_num, int vertical_num, int *area_sensitivity)
+{
+    return AK_SUCCESS;
+}
+
+
+int ak_md_get_result(int *md_sec, char *area_md, int msec)
+{
+    return 0;
+}
+
+
+// OSD.
+int ak_osd_init(void *handle)
+{
+    return AK_SUCCESS;
+}
+
+
+void ak_osd_destroy(void)
+{
+}
+
+
+int ak_osd_set_font_file(int font_size, const char *file)
+{
+    return AK_SUCCESS;
+}
+
+
+int ak_osd_set_font_size(int channel, int size)
+{
+    return AK_SUCCESS;
+}
+
+
+int ak_osd_get_max_rect(int channel, int *width, int *height)
+{
+    *width  = 0;
+    *height = 0;
+
+    return AK_SUCCESS;
+}
+
+
+int ak_osd_set_rect(void *vi_handle, int channel, int osd_rect, int xstart, int ystart, int width, int height)
+{
+    return AK_SUCCESS;
+}
+
+
+int ak_osd_set_color(int front_color, int bg_color)
+{
+    return AK_SUCCESS;
+}
+
+
+int ak_osd_set_edge_color(int edge_color)
+{
+    return AK_SUCCESS;
+}
+
+
+int ak_osd_set_alpha(int alpha)
+{
+    return AK_SUCCESS;
+}
+
+
+int ak_osd_draw_str(int channel, int osd_rect, int xoffset, int yoffset, const unsigned short *disp_str, int str_len)
+{
+    return AK_SUCCESS;
+}
+
+
+// ISP.
+void ak_vpss_isp_clean_auto_day_night_param(void)
+{
+}
+
+
+int ak_vpss_isp_set_auto_day_night_param(struct ak_auto_day_night_threshold *param)
+{
+    return AK_SUCCESS;
+}
+
+
+int ak_vpss_isp_get_auto_day_night_level(int pre_ir_level)
+{
+    return pre_ir_level;
+}
+
+
+int ak_vpss_isp_get_awb_stat_info(const void *vi_handle, struct vpss_isp_awb_stat_info *awb_stat_info)
+{
+    memset(awb_stat_info, 0, sizeof(*awb_stat_info));
+
+    return AK_SUCCESS;
+}
+
+
+int ak_vpss_isp_get_cur_lumi(void)
+{
+    return 0;
+}
+
+}
+
+#endif
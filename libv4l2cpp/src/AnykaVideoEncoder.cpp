@@ -11,6 +11,7 @@
 
 #include "AnykaVideoEncoder.h"
 #include <string.h>
+#include <algorithm>
 #include "logger.h"
 
 extern "C"
@@ -19,8 +20,34 @@ extern "C"
 }
 
 
+// Encoder has limited pool of stream buffers, when slow consumers hold too many of them
+// frames are copied to own buffers so encoder does not stall.
+const int kMaxHeldStreamFrames = 10;
+
+
+AnykaVideoEncoder::StreamHolder::StreamHolder(void *encoder, void *stream)
+    : m_encoder(encoder)
+    , m_stream(stream)
+    , m_heldFrames(0)
+{
+}
+
+
+AnykaVideoEncoder::StreamHolder::~StreamHolder()
+{
+    ak_venc_cancel_stream(m_stream);
+    ak_venc_close(m_encoder);
+
+    LOG(NOTICE)<<"Video encoder stream closed";
+}
+
+
 AnykaVideoEncoder::AnykaVideoEncoder()
-    : m_streamData({0})
+    : m_isJpegEncoder(false)
+    , m_brMode(BR_MODE_CBR)
+    , m_rateControl({0})
+    , m_newRateControl({0})
+    , m_isRateControlChanged(false)
 {
 }
 
@@ -41,12 +68,24 @@ void AnykaVideoEncoder::onStart(void *device, const VideoEncodeParam &videoParam
 {
     if (device != NULL)
     {
-        m_encoder = ak_venc_open(&videoParams.videoParams);
+        m_encoder       = ak_venc_open(&videoParams.videoParams);
+        m_isJpegEncoder = videoParams.videoParams.enc_out_type == MJPEG_ENC_TYPE;
+        m_brMode        = videoParams.videoParams.br_mode;
+
+        m_rateControl.kbps    = m_brMode == BR_MODE_VBR ? videoParams.targetKbps : videoParams.videoParams.bps;
+        m_rateControl.maxKbps = videoParams.maxKbps;
+        m_rateControl.fps     = videoParams.videoParams.fps;
+        m_rateControl.gopLen  = videoParams.videoParams.goplen;
 
         if (m_encoder != NULL)
         {
             LOG(NOTICE)<<"ak_venc_open success";
 
+            if (videoParams.videoParams.fps > 0)
+            {
+                m_frameIntervalMs = 1000 / videoParams.videoParams.fps;
+            }
+
             if (videoParams.videoParams.br_mode == BR_MODE_VBR)
             {
                 if (ak_venc_set_kbps(m_encoder, videoParams.targetKbps, videoParams.maxKbps) != AK_SUCCESS)
@@ -69,6 +108,8 @@ void AnykaVideoEncoder::onStart(void *device, const VideoEncodeParam &videoParam
             if (m_encoderStream != NULL)
             {
                 LOG(NOTICE)<<"ak_venc_request_stream success";
+
+                m_streamHolder = std::make_shared<StreamHolder>(m_encoder, m_encoderStream);
             }
             else
             {
@@ -84,8 +125,113 @@ void AnykaVideoEncoder::onStart(void *device, const VideoEncodeParam &videoParam
 }
 
 
+bool AnykaVideoEncoder::onKeyFrameRequest()
+{
+    bool retVal = false;
+
+    // Every JPEG frame is a key frame already.
+    if (!m_isJpegEncoder && m_encoder != NULL)
+    {
+        retVal = ak_venc_set_iframe(m_encoder) == AK_SUCCESS;
+
+        if (!retVal)
+        {
+            LOG(ERROR)<<"ak_venc_set_iframe failed";
+        }
+    }
+
+    return retVal;
+}
+
+
+void AnykaVideoEncoder::setRateControl(const VideoRateControl &rateControl)
+{
+    std::lock_guard<std::mutex> lock(m_rateControlLock);
+
+    m_newRateControl       = rateControl;
+    m_isRateControlChanged = true;
+}
+
+
+void AnykaVideoEncoder::applyRateControl()
+{
+    VideoRateControl newRateControl = {0};
+
+    {
+        std::lock_guard<std::mutex> lock(m_rateControlLock);
+
+        newRateControl         = m_newRateControl;
+        m_isRateControlChanged = false;
+    }
+
+    if (m_isJpegEncoder || m_encoder == NULL)
+    {
+        return;
+    }
+
+    const bool isFpsChanged = newRateControl.fps > 0 && newRateControl.fps != m_rateControl.fps;
+
+    if (isFpsChanged)
+    {
+        if (ak_venc_set_fps(m_encoder, newRateControl.fps) == AK_SUCCESS)
+        {
+            m_rateControl.fps = newRateControl.fps;
+            m_frameIntervalMs = 1000 / newRateControl.fps;
+        }
+        else
+        {
+            LOG(ERROR)<<"ak_venc_set_fps failed, fps: "<<newRateControl.fps;
+        }
+    }
+
+    // SDK recalculates GOP after fps change, so GOP length is set again.
+    if (newRateControl.gopLen > 0 && (isFpsChanged || newRateControl.gopLen != m_rateControl.gopLen))
+    {
+        if (ak_venc_set_gop_len(m_encoder, newRateControl.gopLen) == AK_SUCCESS)
+        {
+            m_rateControl.gopLen = newRateControl.gopLen;
+        }
+        else
+        {
+            LOG(ERROR)<<"ak_venc_set_gop_len failed, GOP length: "<<newRateControl.gopLen;
+        }
+    }
+
+    const int kbps    = newRateControl.kbps    > 0 ? newRateControl.kbps    : m_rateControl.kbps;
+    const int maxKbps = newRateControl.maxKbps > 0 ? newRateControl.maxKbps : m_rateControl.maxKbps;
+
+    if (kbps != m_rateControl.kbps || maxKbps != m_rateControl.maxKbps)
+    {
+        const int result = m_brMode == BR_MODE_VBR
+            ? ak_venc_set_kbps(m_encoder, kbps, std::max(kbps, maxKbps))
+            : ak_venc_set_rc(m_encoder, kbps);
+
+        if (result == AK_SUCCESS)
+        {
+            m_rateControl.kbps    = kbps;
+            m_rateControl.maxKbps = maxKbps;
+        }
+        else
+        {
+            LOG(ERROR)<<"Error set bitrate: "<<kbps<<" max: "<<maxKbps;
+        }
+    }
+
+    LOG(NOTICE)<<"Video encoder rate control kbps: "<<m_rateControl.kbps<<" max kbps: "<<m_rateControl.maxKbps
+        <<" fps: "<<m_rateControl.fps<<" GOP length: "<<m_rateControl.gopLen;
+}
+
+
 void AnykaVideoEncoder::onStop()
 {
+    if (m_streamHolder)
+    {
+        // Stream is closed by holder after last frame referencing it is released.
+        m_streamHolder.reset();
+        m_encoderStream = NULL;
+        m_encoder       = NULL;
+    }
+
     if (m_encoderStream != NULL)
 	{
 		ak_venc_cancel_stream(m_encoderStream);
@@ -104,20 +250,46 @@ bool AnykaVideoEncoder::readNewFrameData(FrameRef *outFrame)
 {
     bool retVal = false;
 
-    size_t dataSize = 0;
+    if (m_isRateControlChanged)
+    {
+        applyRateControl();
+    }
+
+    video_stream streamData = {0};
 
-    for (size_t i = 0; i < 2; ++i)
+    if (ak_venc_get_stream(m_encoderStream, &streamData) == AK_SUCCESS)
     {
-        if (ak_venc_get_stream_ex(m_encoderStream, outFrame->getData(), 
-                outFrame->getFullSize(), &dataSize) == AK_SUCCESS)
+        const bool isKeyFrame = m_isJpegEncoder || streamData.frame_type == FRAME_TYPE_I;
+
+        if (streamData.len > 0 && m_streamHolder->m_heldFrames < kMaxHeldStreamFrames)
         {
-            outFrame->setDataSize(dataSize);
+            // Pass encoder buffer as is, it is released when all consumers are done with it.
+            const std::shared_ptr<StreamHolder> holder = m_streamHolder;
+            ++holder->m_heldFrames;
+
+            *outFrame = FrameRef::createExternal((char*)streamData.data, streamData.len,
+                [holder, streamData]() mutable
+                {
+                    ak_venc_release_stream(holder->m_stream, &streamData);
+                    --holder->m_heldFrames;
+                });
+            outFrame->setKeyFrame(isKeyFrame);
+            outFrame->setTimestamp(sdkTimestampToMonotonicUs(streamData.ts));
+
             retVal = true;
-            break;
         }
-        else if (dataSize == 0 || !outFrame->reallocIfNeed(dataSize))
+        else
         {
-            break;
+            if (streamData.len > 0 && outFrame->reallocIfNeed(streamData.len))
+            {
+                memcpy(outFrame->getData(), streamData.data, streamData.len);
+                outFrame->setDataSize(streamData.len);
+                outFrame->setKeyFrame(isKeyFrame);
+                outFrame->setTimestamp(sdkTimestampToMonotonicUs(streamData.ts));
+                retVal = true;
+            }
+
+            ak_venc_release_stream(m_encoderStream, &streamData);
         }
     }
 
@@ -8,22 +8,33 @@
 **
 ** -------------------------------------------------------------------------*/
 #include "FrameBuffer.h"
+#include "FramePool.h"
 #include "logger.h"
 
 
+// Frames with attached buffers kept for reuse by one encoder, others go back to FramePool.
+const size_t kMaxCachedFrames = 16;
+
+
 FrameRef::FrameData::FrameData()
 	: m_buffer(nullptr)
 	, m_fullSize(0)
 	, m_dataSize(0)
+	, m_isKeyFrame(false)
+	, m_timestampUs(0)
 {
 }
 
 
 FrameRef::FrameData::~FrameData()
 {
-	if (m_buffer != nullptr)
+	if (m_releaseCallback)
+	{
+		m_releaseCallback();
+	}
+	else
 	{
-		free(m_buffer);
+		FramePool::instance().release(m_buffer, m_fullSize);
 	}
 }
 
@@ -34,6 +45,18 @@ FrameRef::FrameRef()
 }
 
 
+FrameRef FrameRef::createExternal(char *buffer, size_t dataSize, const std::function<void()> &releaseCallback)
+{
+	FrameRef retVal;
+	retVal.m_data->m_buffer          = buffer;
+	retVal.m_data->m_fullSize        = dataSize;
+	retVal.m_data->m_dataSize        = dataSize;
+	retVal.m_data->m_releaseCallback = releaseCallback;
+
+	return retVal;
+}
+
+
 char* FrameRef::getData() const
 {
 	return m_data->m_buffer;
@@ -60,18 +83,17 @@ void FrameRef::setDataSize(size_t size)
 
 bool FrameRef::reallocIfNeed(size_t size)
 {
-	if (size > m_data->m_fullSize)
+	// External buffer can't be reallocated.
+	if (size > m_data->m_fullSize && !m_data->m_releaseCallback)
 	{
-		m_data->m_buffer = (char*) realloc(m_data->m_buffer, size);
+		size_t newFullSize = 0;
+		char *newBuffer = FramePool::instance().reallocate(m_data->m_buffer, m_data->m_fullSize, m_data->m_dataSize, size, &newFullSize);
 
-		if (m_data->m_buffer != nullptr)
-		{
- 			m_data->m_fullSize = size;
-		}
-		else
+		// Old buffer is kept on failure.
+		if (newBuffer != nullptr)
 		{
- 			m_data->m_fullSize = 0;
-			m_data->m_dataSize = 0;
+			m_data->m_buffer   = newBuffer;
+			m_data->m_fullSize = newFullSize;
 		}
 	}
 
@@ -85,6 +107,30 @@ bool FrameRef::isSet() const
 }
 
 
+void FrameRef::setKeyFrame(bool isKeyFrame)
+{
+	m_data->m_isKeyFrame = isKeyFrame;
+}
+
+
+bool FrameRef::isKeyFrame() const
+{
+	return m_data->m_isKeyFrame;
+}
+
+
+void FrameRef::setTimestamp(long long timestampUs)
+{
+	m_data->m_timestampUs = timestampUs;
+}
+
+
+long long FrameRef::getTimestamp() const
+{
+	return m_data->m_timestampUs;
+}
+
+
 FrameRef FrameBuffer::getFreeFrame()
 {
 	FrameRef *retPtr = nullptr;
@@ -94,12 +140,14 @@ FrameRef FrameBuffer::getFreeFrame()
 		if (it.m_data.use_count() == 1)
 		{
 			it.setDataSize(0);
+			it.setKeyFrame(false);
+			it.setTimestamp(0);
 			retPtr = &it;
 			break;
 		}
 	}
 
-	if (retPtr == nullptr)
+	if (retPtr == nullptr && m_frames.size() < kMaxCachedFrames)
 	{
 		m_frames.push_back(FrameRef());
 		retPtr = &m_frames.back();
@@ -107,7 +155,9 @@ FrameRef FrameBuffer::getFreeFrame()
 		LOG(DEBUG)<<"Increase frame buffer size to "<<m_frames.size()<<"\n";
 	}
 
-	return *retPtr;
+	return retPtr != nullptr
+		? *retPtr
+		: FrameRef();
 }
 
 
@@ -0,0 +1,233 @@
+/* ---------------------------------------------------------------------------
+** This software is in the public domain, furnished "as is", without technical
+** support, and with no warranty, express or implied, as to its usefulness for
+** any purpose.
+**
+** FramePool.cpp
+** 
+**
+** -------------------------------------------------------------------------*/
+#include "FramePool.h"
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include "logger.h"
+
+
+const size_t kMinClassSize = 1024; // Size of class 0, every next class is twice bigger.
+
+
+FramePool::SizeClass::SizeClass()
+	: liveCount(0)
+	, peakLiveCount(0)
+{
+}
+
+
+FramePool& FramePool::instance()
+{
+	// Never destroyed: frames owned by other static objects may be released at exit.
+	static FramePool *_instance = new FramePool();
+	return *_instance;
+}
+
+
+FramePool::FramePool()
+	: m_maxBytes(0)
+	, m_stats({0})
+{
+}
+
+
+void FramePool::setMaxBytes(size_t maxBytes)
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+
+	m_maxBytes = maxBytes;
+}
+
+
+int FramePool::getClassIndex(size_t size)
+{
+	int index = 0;
+
+	for (size_t classSize = kMinClassSize; classSize < size && index < kClassesCount; classSize <<= 1)
+	{
+		++index;
+	}
+
+	return index < kClassesCount 
+		? index 
+		: -1;
+}
+
+
+size_t FramePool::getClassSize(int index)
+{
+	return kMinClassSize << index;
+}
+
+
+size_t FramePool::getHeldBytes() const
+{
+	return m_stats.liveBytes + m_stats.freeBytes;
+}
+
+
+char* FramePool::allocate(size_t size, size_t *outCapacity)
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+
+	const int index = getClassIndex(size);
+	// Buffers bigger than biggest class are allocated as is and not reused.
+	const size_t capacity = index >= 0 ? getClassSize(index) : size;
+
+	char *retVal = NULL;
+
+	if (index >= 0 && !m_classes[index].freeBuffers.empty())
+	{
+		retVal = m_classes[index].freeBuffers.back();
+		m_classes[index].freeBuffers.pop_back();
+
+		m_stats.freeBytes -= capacity;
+		--m_stats.freeBuffers;
+		++m_stats.reuses;
+	}
+	else
+	{
+		if (m_maxBytes > 0 && getHeldBytes() + capacity > m_maxBytes)
+		{
+			// Return idle buffers of other sizes to heap before giving up.
+			for (int i = 0; i < kClassesCount; ++i)
+			{
+				freeBuffers(&m_classes[i], 0, getClassSize(i));
+			}
+		}
+
+		if (m_maxBytes == 0 || getHeldBytes() + capacity <= m_maxBytes)
+		{
+			retVal = (char*) malloc(capacity);
+		}
+
+		if (retVal != NULL)
+		{
+			++m_stats.allocations;
+		}
+		else
+		{
+			++m_stats.failures;
+			LOG(WARN)<<"Frame pool can't allocate "<<capacity<<" bytes, held: "<<getHeldBytes()<<" max: "<<m_maxBytes;
+		}
+	}
+
+	if (retVal != NULL)
+	{
+		if (index >= 0)
+		{
+			SizeClass &sizeClass = m_classes[index];
+			++sizeClass.liveCount;
+			sizeClass.peakLiveCount = std::max(sizeClass.peakLiveCount, sizeClass.liveCount);
+		}
+
+		++m_stats.liveBuffers;
+		m_stats.liveBytes += capacity;
+		m_stats.peakBytes = std::max(m_stats.peakBytes, getHeldBytes());
+
+		*outCapacity = capacity;
+	}
+
+	return retVal;
+}
+
+
+char* FramePool::reallocate(char *buffer, size_t capacity, size_t dataSize, size_t newSize, size_t *outCapacity)
+{
+	char *retVal = allocate(newSize, outCapacity);
+
+	if (retVal != NULL && buffer != NULL)
+	{
+		memcpy(retVal, buffer, std::min(dataSize, capacity));
+		release(buffer, capacity);
+
+		std::lock_guard<std::mutex> lock(m_lock);
+		++m_stats.reallocations;
+	}
+
+	return retVal;
+}
+
+
+void FramePool::release(char *buffer, size_t capacity)
+{
+	if (buffer == NULL)
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(m_lock);
+
+	const int index = getClassIndex(capacity);
+
+	--m_stats.liveBuffers;
+	m_stats.liveBytes -= capacity;
+
+	if (index >= 0 && getClassSize(index) == capacity)
+	{
+		m_classes[index].freeBuffers.push_back(buffer);
+		--m_classes[index].liveCount;
+
+		++m_stats.freeBuffers;
+		m_stats.freeBytes += capacity;
+	}
+	else
+	{
+		free(buffer);
+	}
+}
+
+
+void FramePool::freeBuffers(SizeClass *sizeClass, size_t keepCount, size_t classSize)
+{
+	while (sizeClass->freeBuffers.size() > keepCount)
+	{
+		free(sizeClass->freeBuffers.back());
+		sizeClass->freeBuffers.pop_back();
+
+		--m_stats.freeBuffers;
+		m_stats.freeBytes -= classSize;
+	}
+}
+
+
+void FramePool::trim()
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+
+	const size_t freeBytes = m_stats.freeBytes;
+
+	for (int i = 0; i < kClassesCount; ++i)
+	{
+		SizeClass &sizeClass = m_classes[i];
+
+		// Keep only buffers needed to reach live count peak since previous trim.
+		freeBuffers(&sizeClass, sizeClass.peakLiveCount - sizeClass.liveCount, getClassSize(i));
+		sizeClass.peakLiveCount = sizeClass.liveCount;
+	}
+
+	LOG(DEBUG)<<"Frame pool trimmed: "<<freeBytes - m_stats.freeBytes<<" bytes"
+		<<" live buffers: "<<m_stats.liveBuffers<<" ("<<m_stats.liveBytes<<" bytes)"
+		<<" free buffers: "<<m_stats.freeBuffers<<" ("<<m_stats.freeBytes<<" bytes)"
+		<<" peak: "<<m_stats.peakBytes
+		<<" allocations: "<<m_stats.allocations
+		<<" reuses: "<<m_stats.reuses
+		<<" reallocations: "<<m_stats.reallocations
+		<<" failures: "<<m_stats.failures;
+}
+
+
+FramePool::Stats FramePool::getStats() const
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+
+	return m_stats;
+}
@@ -0,0 +1,111 @@
+/* ---------------------------------------------------------------------------
+** This software is in the public domain, furnished "as is", without technical
+** support, and with no warranty, express or implied, as to its usefulness for
+** any purpose.
+**
+** FrameRing.cpp
+** 
+**
+** -------------------------------------------------------------------------*/
+#include "FrameRing.h"
+#include <utility>
+
+
+FrameRing::FrameRing()
+	: m_capacity(0)
+	, m_pushPos(0)
+	, m_popPos(0)
+{
+}
+
+
+void FrameRing::init(size_t capacity)
+{
+	if (capacity == 0)
+	{
+		capacity = 1;
+	}
+
+	if (capacity != m_capacity)
+	{
+		m_cells.reset(new Cell[capacity]);
+		m_capacity = capacity;
+	}
+
+	for (size_t i = 0; i < m_capacity; ++i)
+	{
+		m_cells[i].m_sequence.store(i, std::memory_order_relaxed);
+	}
+
+	m_pushPos.store(0, std::memory_order_relaxed);
+	m_popPos.store(0, std::memory_order_release);
+}
+
+
+size_t FrameRing::getCapacity() const
+{
+	return m_capacity;
+}
+
+
+bool FrameRing::tryPush(const FrameRef &frame)
+{
+	bool retVal = false;
+
+	if (m_capacity > 0)
+	{
+		const size_t pos = m_pushPos.load(std::memory_order_relaxed);
+		Cell &cell = m_cells[pos % m_capacity];
+
+		// Cell is free when its sequence equals to push position, otherwise ring is full.
+		if (cell.m_sequence.load(std::memory_order_acquire) == pos)
+		{
+			cell.m_frame = frame;
+			cell.m_sequence.store(pos + 1, std::memory_order_release);
+			m_pushPos.store(pos + 1, std::memory_order_relaxed);
+
+			retVal = true;
+		}
+	}
+
+	return retVal;
+}
+
+
+bool FrameRing::tryPop(FrameRef *outFrame)
+{
+	if (m_capacity == 0)
+	{
+		return false;
+	}
+
+	size_t pos = m_popPos.load(std::memory_order_relaxed);
+
+	while (true)
+	{
+		Cell &cell = m_cells[pos % m_capacity];
+		const size_t sequence = cell.m_sequence.load(std::memory_order_acquire);
+		const long diff = (long)(sequence - (pos + 1));
+
+		if (diff == 0)
+		{
+			// Cell is filled, take it if other popping thread did not do it first.
+			if (m_popPos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+			{
+				*outFrame = std::move(cell.m_frame);
+				cell.m_sequence.store(pos + m_capacity, std::memory_order_release);
+
+				return true;
+			}
+		}
+		else if (diff < 0)
+		{
+			// Empty.
+			return false;
+		}
+		else
+		{
+			pos = m_popPos.load(std::memory_order_relaxed);
+		}
+	}
+}
@@ -79,6 +79,14 @@ void usage(char *command)
     fprintf(stderr, "\t'l' OSD on/off\n");
     fprintf(stderr, "\t'm' motion detect sensitivity\n");
     fprintf(stderr, "\t'p' motion detect on/off\n");
+    fprintf(stderr, "\t'K' video high kbps (CBR bitrate or VBR target), 0 -> from config file\n");
+    fprintf(stderr, "\t'M' video high VBR max kbps, 0 -> from config file\n");
+    fprintf(stderr, "\t'F' video high fps, 0 -> from config file\n");
+    fprintf(stderr, "\t'G' video high GOP length, 0 -> from config file\n");
+    fprintf(stderr, "\t'L' video low kbps (CBR bitrate or VBR target), 0 -> from config file\n");
+    fprintf(stderr, "\t'N' video low VBR max kbps, 0 -> from config file\n");
+    fprintf(stderr, "\t'R' video low fps, 0 -> from config file\n");
+    fprintf(stderr, "\t'H' video low GOP length, 0 -> from config file\n");
 }
 
 #ifdef BUILD_SETCONF
@@ -200,6 +208,31 @@ int main(int argc, char *argv[]) {
         case 'p':
             SETGETSHAREDMEMORYINT(conf->motionEnabled);
             break;
+        // Video rate control
+        case 'K':
+            SETGETSHAREDMEMORYINT(conf->videoKbpsHigh);
+            break;
+        case 'M':
+            SETGETSHAREDMEMORYINT(conf->videoMaxKbpsHigh);
+            break;
+        case 'F':
+            SETGETSHAREDMEMORYINT(conf->videoFpsHigh);
+            break;
+        case 'G':
+            SETGETSHAREDMEMORYINT(conf->videoGopLenHigh);
+            break;
+        case 'L':
+            SETGETSHAREDMEMORYINT(conf->videoKbpsLow);
+            break;
+        case 'N':
+            SETGETSHAREDMEMORYINT(conf->videoMaxKbpsLow);
+            break;
+        case 'R':
+            SETGETSHAREDMEMORYINT(conf->videoFpsLow);
+            break;
+        case 'H':
+            SETGETSHAREDMEMORYINT(conf->videoGopLenLow);
+            break;
 
     default:
         printf("Invalid Argument %c\n", key);
@@ -114,6 +114,14 @@ SharedMemory::SharedMemory()
     currentConfig.osdYLow           = 12;
     currentConfig.videoDay          = true;
     currentConfig.imageFlip         = 0;
+    currentConfig.videoKbpsHigh     = 0;
+    currentConfig.videoMaxKbpsHigh  = 0;
+    currentConfig.videoFpsHigh      = 0;
+    currentConfig.videoGopLenHigh   = 0;
+    currentConfig.videoKbpsLow      = 0;
+    currentConfig.videoMaxKbpsLow   = 0;
+    currentConfig.videoFpsLow       = 0;
+    currentConfig.videoGopLenLow    = 0;
 
     keyImageMem  = ftok("/usr/", '1');
     keyConfigMem = ftok("/usr/", '3');
@@ -248,8 +256,12 @@ void SharedMemory::readMemory(key_t key, void *memory, size_t memorylenght)
         return;
     }
 
+    // Segment written by older version is shorter, fields added at the end of
+    // SharedConfig keep their current values then.
+    const size_t memLen = this->getMemorySize(key);
+
     mem = shmat(shmId, NULL, 0);
-    memcpy(memory, mem, memorylenght);
+    memcpy(memory, mem, memLen < memorylenght ? memLen : memorylenght);
     shmdt(mem);
 }
 
@@ -62,6 +62,24 @@ FrameRef V4l2Device::readInternal()
 }
 
 
+void V4l2Device::requestKeyFrame()
+{
+	AnykaCameraManager::instance().requestKeyFrame(streamId);
+}
+
+
+void V4l2Device::setActive(bool isActive)
+{
+	AnykaCameraManager::instance().setStreamActive(streamId, isActive);
+}
+
+
+void V4l2Device::setReceiverStats(int lossPercent, int jitterMs)
+{
+	AnykaCameraManager::instance().reportReceiverStats(streamId, lossPercent, jitterMs);
+}
+
+
 int V4l2Device::setFormat(unsigned int format, unsigned int width, unsigned int height)
 {
 	LOG(DEBUG)<<"V4l2Device setFormat";
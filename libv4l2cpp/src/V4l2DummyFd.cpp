@@ -12,23 +12,42 @@
 #include "V4l2DummyFd.h"
 #include <unistd.h>
 #include <fcntl.h>
+#include <stdint.h>
+#include <sys/eventfd.h>
+#include "logger.h"
 
 
-V4l2DummyFd::V4l2DummyFd()
-    : m_fd{0, 0}
+V4l2DummyFd::V4l2DummyFd(bool isEventFdAllowed)
+    : m_fd{-1, -1}
+    , m_isEventFd(false)
 {
-    pipe2(m_fd, O_CLOEXEC | O_NONBLOCK);
+    // Semaphore mode: every read takes one signal, same as one byte of pipe.
+    const int eventFd = isEventFdAllowed ? eventfd(0, EFD_SEMAPHORE | EFD_NONBLOCK | EFD_CLOEXEC) : -1;
+
+    if (eventFd != -1)
+    {
+        m_fd[0]     = eventFd;
+        m_fd[1]     = eventFd;
+        m_isEventFd = true;
+    }
+    else if (pipe2(m_fd, O_CLOEXEC | O_NONBLOCK) != 0)
+    {
+        LOG(ERROR)<<"Can't create signal fd";
+
+        m_fd[0] = -1;
+        m_fd[1] = -1;
+    }
 }
 
 
 V4l2DummyFd::~V4l2DummyFd()
 {
-    if (m_fd[0] != 0)
+    if (m_fd[0] != -1)
     {
         close(m_fd[0]);
     }
 
-    if (m_fd[1] != 0)
+    if (m_fd[1] != -1 && !m_isEventFd)
     {
         close(m_fd[1]);
     }
@@ -37,23 +56,35 @@ V4l2DummyFd::~V4l2DummyFd()
 
 bool V4l2DummyFd::isSet() const
 {
-    return m_fd[0] != 0 && m_fd[1] != 0;
+    return m_fd[0] != -1 && m_fd[1] != -1;
 }
 
 
 bool V4l2DummyFd::signal()
 {
+    if (m_isEventFd)
+    {
+        const uint64_t value = 1;
+
+        return write(m_fd[1], &value, sizeof(value)) == sizeof(value);
+    }
+
     return isSet() && write(m_fd[1], "1", 1) > 0;
 }
 
 
-void V4l2DummyFd::reset() const
+bool V4l2DummyFd::reset() const
 {
-    if (isSet())
+    if (m_isEventFd)
     {
-        char buff;
-        read(m_fd[0], &buff, 1);
+        uint64_t value = 0;
+
+        return read(m_fd[0], &value, sizeof(value)) == sizeof(value);
     }
+
+    char buff;
+
+    return isSet() && read(m_fd[0], &buff, 1) > 0;
 }
 
 
@@ -61,4 +92,3 @@ int V4l2DummyFd::getFd() const
 {
     return m_fd[0];
 }
-
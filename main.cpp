@@ -116,6 +116,7 @@ int main(int argc, char** argv)
 	V4L2DeviceSource::CaptureMode captureMode = V4L2DeviceSource::CAPTURE_INTERNAL_THREAD;
 	std::string maddr;
 	bool repeatConfig = true;
+	int gopCacheSize = 1024;
 	int timeout = 65;
 	int defaultHlsSegment = 2;
 	unsigned int hlsSegment = 0;
@@ -136,7 +137,7 @@ int main(int argc, char** argv)
 
 	// decode parameters
 	int c = 0;     
-	while ((c = getopt (argc, argv, "v::Q:O:b:" "I:P:p:m::u:M::ct:S::x:" "R:U:" "rwBsf::F:W:H:G:" "A:C:a:" "Vh")) != -1)
+	while ((c = getopt (argc, argv, "v::Q:O:b:" "I:P:p:m::u:M::ct:g:S::x:" "R:U:" "rwBsef::F:W:H:G:" "A:C:a:" "Vh")) != -1)
 	{
 		switch (c)
 		{
@@ -154,6 +155,7 @@ int main(int argc, char** argv)
 			case 'M':	multicast = true; maddr = optarg ? optarg : maddr; break;
 			case 'c':	repeatConfig            = false; break;
 			case 't':	timeout                 = atoi(optarg); break;
+			case 'g':	gopCacheSize            = atoi(optarg); break;
 			case 'S':	hlsSegment              = optarg ? atoi(optarg) : defaultHlsSegment; break;
 			case 'x':	sslKeyCert              = optarg; break;
 
@@ -166,6 +168,7 @@ int main(int argc, char** argv)
 			case 'w':	ioTypeOut = IOTYPE_READWRITE; break;	
 			case 'B':	openflags = O_RDWR; break;	
 			case 's':	captureMode = V4L2DeviceSource::CAPTURE_LIVE555_THREAD; break;
+			case 'e':	captureMode = V4L2DeviceSource::CAPTURE_REACTOR_THREAD; break;
 			case 'f':	format    = V4l2Device::fourcc(optarg); if (format) {videoformatList.push_back(format);};  break;
 			case 'F':	fps       = atoi(optarg); break;
 			case 'W':	width     = atoi(optarg); break;
@@ -190,8 +193,8 @@ int main(int argc, char** argv)
 			default:
 			{
 				std::cout << argv[0] << " [-v[v]] [-Q queueSize] [-O file]"                                        << std::endl;
-				std::cout << "\t          [-I interface] [-P RTSP port] [-p RTSP/HTTP port] [-m multicast url] [-u unicast url] [-M multicast addr] [-c] [-t timeout] [-T] [-S[duration]]" << std::endl;
-				std::cout << "\t          [-r] [-w] [-s] [-f[format] [-W width] [-H height] [-F fps] [device] [device]"                        << std::endl;
+				std::cout << "\t          [-I interface] [-P RTSP port] [-p RTSP/HTTP port] [-m multicast url] [-u unicast url] [-M multicast addr] [-c] [-t timeout] [-g size] [-T] [-S[duration]]" << std::endl;
+				std::cout << "\t          [-r] [-w] [-s] [-e] [-f[format] [-W width] [-H height] [-F fps] [device] [device]"                        << std::endl;
 				std::cout << "\t -v               : verbose"                                                                                          << std::endl;
 				std::cout << "\t -vv              : very verbose"                                                                                     << std::endl;
 				std::cout << "\t -Q <length>      : Number of frame queue  (default "<< queueSize << ")"                                              << std::endl;
@@ -209,6 +212,7 @@ int main(int argc, char** argv)
 				std::cout << "\t -M <addr>        : multicast group:port (default is random_address:20000)"                                           << std::endl;
 				std::cout << "\t -c               : don't repeat config (default repeat config before IDR frame)"                                     << std::endl;
 				std::cout << "\t -t <timeout>     : RTCP expiration timeout in seconds (default " << timeout << ")"                                   << std::endl;
+				std::cout << "\t -g <size>        : GOP cache size in KB sent to new unicast clients, 0 to disable (default " << gopCacheSize << ")"  << std::endl;
 				std::cout << "\t -S[<duration>]   : enable HLS & MPEG-DASH with segment duration  in seconds (default " << defaultHlsSegment << ")" << std::endl;
 				std::cout << "\t -x <sslkeycert>  : enable RTSPS & SRTP"                                 << std::endl;
 				
@@ -217,6 +221,7 @@ int main(int argc, char** argv)
 				std::cout << "\t -w               : V4L2 capture using write interface (default use memory mapped buffers)"                           << std::endl;
 				std::cout << "\t -B               : V4L2 capture using blocking mode (default use non-blocking mode)"                                 << std::endl;
 				std::cout << "\t -s               : V4L2 capture using live555 mainloop (default use a reader thread)"                                << std::endl;
+				std::cout << "\t -e               : V4L2 capture using one epoll thread for all devices (default use a reader thread)"                << std::endl;
 				std::cout << "\t -f               : V4L2 capture using current capture format (-W,-H,-F are ignored)"                                 << std::endl;
 				std::cout << "\t -f<format>       : V4L2 capture using format (-W,-H,-F are used)"                                                    << std::endl;
 				std::cout << "\t -W <width>       : V4L2 capture width (default "<< width << ")"                                                      << std::endl;
@@ -309,7 +314,7 @@ int main(int argc, char** argv)
 			V4L2DeviceParameters inParam(videoDev.c_str(), videoformatList, width, height, fps, ioTypeIn, verbose, openflags);
 			StreamReplicator* videoReplicator = rtspServer.CreateVideoReplicator( 
 					inParam,
-					queueSize, captureMode, repeatConfig,
+					queueSize, captureMode, repeatConfig, gopCacheSize > 0 ? gopCacheSize * 1024 : 0,
 					output, ioTypeOut, out);
 			if (out != NULL) {
 				outList.push_back(out);
@@ -0,0 +1,191 @@
+/* ---------------------------------------------------------------------------
+** This software is in the public domain, furnished "as is", without technical
+** support, and with no warranty, express or implied, as to its usefulness for
+** any purpose.
+**
+** CaptureReactor.cpp
+**
+** -------------------------------------------------------------------------*/
+
+#include <sys/epoll.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+#include "logger.h"
+#include "CaptureReactor.h"
+#include "V4L2DeviceSource.h"
+
+const int kMaxEvents = 8;
+
+CaptureReactor& CaptureReactor::instance()
+{
+	static CaptureReactor reactor;
+	return reactor;
+}
+
+CaptureReactor::CaptureReactor()
+	: m_epollFd(epoll_create1(EPOLL_CLOEXEC)), m_isThreadStarted(false), m_stop(false)
+{
+	memset(&m_thid, 0, sizeof(m_thid));
+	pthread_mutex_init(&m_mutex, NULL);
+
+	if (m_epollFd == -1)
+	{
+		LOG(ERROR) << "epoll_create1 " << strerror(errno);
+	}
+	else
+	{
+		// wakes the thread up to stop it, data.ptr NULL is not a source
+		struct epoll_event event;
+		memset(&event, 0, sizeof(event));
+		event.events = EPOLLIN;
+		event.data.ptr = NULL;
+		epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_wakeFd.getFd(), &event);
+	}
+}
+
+CaptureReactor::~CaptureReactor()
+{
+	stopThread();
+	if (m_epollFd != -1)
+	{
+		close(m_epollFd);
+	}
+	pthread_mutex_destroy(&m_mutex);
+}
+
+bool CaptureReactor::addSource(V4L2DeviceSource* source, int fd)
+{
+	bool added = false;
+
+	pthread_mutex_lock(&m_mutex);
+	if ( (m_epollFd != -1) && !isRegistered(source) )
+	{
+		struct epoll_event event;
+		memset(&event, 0, sizeof(event));
+		event.events = EPOLLIN;
+		event.data.ptr = source;
+		if (epoll_ctl(m_epollFd, EPOLL_CTL_ADD, fd, &event) == 0)
+		{
+			Entry entry = { source, fd };
+			m_entries.push_back(entry);
+			added = true;
+		}
+		else
+		{
+			LOG(ERROR) << "epoll_ctl add fd:" << fd << " " << strerror(errno);
+		}
+	}
+
+	if (added && !m_isThreadStarted)
+	{
+		m_stop = false;
+		m_isThreadStarted = (pthread_create(&m_thid, NULL, threadStub, this) == 0);
+		if (!m_isThreadStarted)
+		{
+			// nothing would read the source
+			LOG(ERROR) << "cannot start capture reactor thread";
+			eraseSource(source);
+			added = false;
+		}
+	}
+	pthread_mutex_unlock(&m_mutex);
+
+	return added;
+}
+
+void CaptureReactor::removeSource(V4L2DeviceSource* source)
+{
+	pthread_mutex_lock(&m_mutex);
+	eraseSource(source);
+	const bool isEmpty = m_entries.empty();
+	pthread_mutex_unlock(&m_mutex);
+
+	if (isEmpty)
+	{
+		stopThread();
+	}
+}
+
+void CaptureReactor::stopThread()
+{
+	if (m_isThreadStarted)
+	{
+		m_stop = true;
+		m_wakeFd.signal();
+		pthread_join(m_thid, NULL);
+		m_wakeFd.reset();
+		m_isThreadStarted = false;
+	}
+}
+
+void CaptureReactor::eraseSource(V4L2DeviceSource* source)
+{
+	for (std::list<Entry>::iterator it = m_entries.begin(); it != m_entries.end(); ++it)
+	{
+		if (it->m_source == source)
+		{
+			epoll_ctl(m_epollFd, EPOLL_CTL_DEL, it->m_fd, NULL);
+			m_entries.erase(it);
+			break;
+		}
+	}
+}
+
+bool CaptureReactor::isRegistered(V4L2DeviceSource* source) const
+{
+	for (std::list<Entry>::const_iterator it = m_entries.begin(); it != m_entries.end(); ++it)
+	{
+		if (it->m_source == source)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+// thread mainloop
+void* CaptureReactor::thread()
+{
+	struct epoll_event events[kMaxEvents];
+
+	LOG(NOTICE) << "begin capture reactor";
+	while (!m_stop)
+	{
+		int count = epoll_wait(m_epollFd, events, kMaxEvents, -1);
+		if (count == -1)
+		{
+			if (errno != EINTR)
+			{
+				LOG(ERROR) << "epoll_wait " << strerror(errno);
+				break;
+			}
+			continue;
+		}
+
+		// level triggered: one frame per ready source and iteration, a source with
+		// a backlog is read again on the next iteration after the others
+		pthread_mutex_lock(&m_mutex);
+		for (int i = 0; (i < count) && !m_stop; ++i)
+		{
+			V4L2DeviceSource* source = (V4L2DeviceSource*)events[i].data.ptr;
+			// source could be removed after epoll_wait returned
+			if ( (source != NULL) && isRegistered(source) && (source->getNextFrame() <= 0) )
+			{
+				if (errno == EAGAIN)
+				{
+					LOG(NOTICE) << "Retrying getNextFrame";
+				}
+				else
+				{
+					LOG(ERROR) << "error:" << strerror(errno) << ", stop reading source";
+					eraseSource(source);
+				}
+			}
+		}
+		pthread_mutex_unlock(&m_mutex);
+	}
+	LOG(NOTICE) << "end capture reactor";
+	return NULL;
+}
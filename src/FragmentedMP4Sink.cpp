@@ -0,0 +1,623 @@
+/* ---------------------------------------------------------------------------
+** This software is in the public domain, furnished "as is", without technical
+** support, and with no warranty, express or implied, as to its usefulness for
+** any purpose.
+**
+** FragmentedMP4Sink.cpp
+**
+** -------------------------------------------------------------------------*/
+
+#include <sstream>
+#include <iomanip>
+
+#include "FragmentedMP4Sink.h"
+
+const unsigned int kTrackId             = 1;
+const unsigned int kSampleFlagsKey      = 0x02000000; // depends on no other sample
+const unsigned int kSampleFlagsNonKey   = 0x01010000; // depends on others, not a sync sample
+const unsigned int kTrunFlags           = 0x000701;   // data offset, sample duration, size and flags
+const unsigned int kTfhdFlags           = 0x020000;   // default base is moof
+
+// -----------------------------------------
+//    big endian box writers
+// -----------------------------------------
+static void put8(std::string & out, unsigned int value)
+{
+	out.push_back((char)(value & 0xFF));
+}
+
+static void put16(std::string & out, unsigned int value)
+{
+	put8(out, value >> 8);
+	put8(out, value);
+}
+
+static void put32(std::string & out, unsigned int value)
+{
+	put16(out, value >> 16);
+	put16(out, value);
+}
+
+static void put64(std::string & out, u_int64_t value)
+{
+	put32(out, (unsigned int)(value >> 32));
+	put32(out, (unsigned int)value);
+}
+
+static void putBox(std::string & out, const char* type, const std::string & payload)
+{
+	put32(out, 8 + payload.size());
+	out.append(type, 4);
+	out.append(payload);
+}
+
+static void putMatrix(std::string & out)
+{
+	const unsigned int matrix[] = { 0x00010000, 0, 0, 0, 0x00010000, 0, 0, 0, 0x40000000 };
+	for (unsigned int i = 0; i < sizeof(matrix)/sizeof(matrix[0]); ++i)
+	{
+		put32(out, matrix[i]);
+	}
+}
+
+// remove emulation prevention bytes
+static std::string toRbsp(const std::string & nal)
+{
+	std::string rbsp;
+	unsigned int zeros = 0;
+	for (unsigned int i = 0; i < nal.size(); ++i)
+	{
+		unsigned char byte = nal[i];
+		if ( (zeros >= 2) && (byte == 3) )
+		{
+			zeros = 0;
+			continue;
+		}
+		zeros = (byte == 0) ? zeros + 1 : 0;
+		rbsp.push_back(byte);
+	}
+	return rbsp;
+}
+
+// -----------------------------------------
+//    FragmentedMP4Sink
+// -----------------------------------------
+FragmentedMP4Sink::FragmentedMP4Sink(UsageEnvironment& env, const std::string & format, unsigned int width, unsigned int height, unsigned int bufferSize, unsigned int fragmentDuration, unsigned int nbFragments)
+	: MediaSink(env), m_bufferSize(bufferSize), m_isH265(format == "video/H265"), m_width(width), m_height(height)
+	, m_fragmentDuration(fragmentDuration), m_nbFragments(nbFragments), m_nextFragmentId(0)
+	, m_initSegment(std::make_shared<std::string>()), m_initVersion(0), m_isInitChanged(false), m_discontinuitySequence(0)
+	, m_sampleTime(0), m_isSampleKey(false), m_hasSample(false), m_lastDuration(0)
+	, m_decodeTime(0), m_startTime(0), m_fragmentTime(0), m_fragmentInitVersion(0)
+{
+	m_buffer = new unsigned char[m_bufferSize];
+}
+
+FragmentedMP4Sink::~FragmentedMP4Sink()
+{
+	delete[] m_buffer;
+}
+
+Boolean FragmentedMP4Sink::continuePlaying()
+{
+	Boolean ret = False;
+	if (fSource != NULL)
+	{
+		fSource->getNextFrame(m_buffer, m_bufferSize,
+				afterGettingFrame, this,
+				onSourceClosure, this);
+		ret = True;
+	}
+	return ret;
+}
+
+void FragmentedMP4Sink::afterGettingFrame(unsigned frameSize, unsigned numTruncatedBytes, struct timeval presentationTime)
+{
+	if (numTruncatedBytes > 0)
+	{
+		envir() << "FragmentedMP4Sink::afterGettingFrame(): The input frame data was too large for our buffer size \n";
+		// realloc a bigger buffer
+		m_bufferSize += numTruncatedBytes;
+		delete[] m_buffer;
+		m_buffer = new unsigned char[m_bufferSize];
+	}
+	else
+	{
+		// NALs of an access unit share the same presentation time
+		u_int64_t time = ((u_int64_t)presentationTime.tv_sec*1000000 + presentationTime.tv_usec) * kTimescale / 1000000;
+		this->processNal(m_buffer, frameSize, time);
+	}
+
+	continuePlaying();
+}
+
+void FragmentedMP4Sink::processNal(const unsigned char* nal, unsigned int size, u_int64_t time)
+{
+	if (size == 0)
+	{
+		return;
+	}
+	if (m_hasSample && (time != m_sampleTime))
+	{
+		this->endSample(time);
+	}
+
+	std::string* parameterSet = NULL;
+	bool isKey = false;
+	bool isAud = false;
+	if (m_isH265)
+	{
+		int type = (nal[0] >> 1) & 0x3F;
+		if (type == 32)      parameterSet = &m_vps;
+		else if (type == 33) parameterSet = &m_sps;
+		else if (type == 34) parameterSet = &m_pps;
+		isKey = (type >= 16) && (type <= 21);
+		isAud = (type == 35);
+	}
+	else
+	{
+		int type = nal[0] & 0x1F;
+		if (type == 7)      parameterSet = &m_sps;
+		else if (type == 8) parameterSet = &m_pps;
+		isKey = (type == 5);
+		isAud = (type == 9);
+	}
+
+	// parameter sets only go to the init segment
+	if (parameterSet != NULL)
+	{
+		if (parameterSet->compare(0, std::string::npos, (const char*)nal, size) != 0)
+		{
+			parameterSet->assign((const char*)nal, size);
+			m_isInitChanged = true;
+		}
+		return;
+	}
+	if (isAud)
+	{
+		return;
+	}
+	if (m_isInitChanged)
+	{
+		m_isInitChanged = false;
+		this->updateInitSegment();
+	}
+
+	if (!m_hasSample)
+	{
+		m_hasSample = true;
+		m_sampleTime = time;
+		m_isSampleKey = false;
+		m_sampleData.clear();
+	}
+	m_isSampleKey |= isKey;
+	put32(m_sampleData, size);
+	m_sampleData.append((const char*)nal, size);
+}
+
+void FragmentedMP4Sink::endSample(u_int64_t nextTime)
+{
+	// the last duration is reused when the capture clock jumps
+	unsigned int duration = m_lastDuration;
+	if ( (nextTime > m_sampleTime) && (nextTime - m_sampleTime < kTimescale) )
+	{
+		duration = nextTime - m_sampleTime;
+	}
+	m_lastDuration = duration;
+
+	// a fragment is decoded with a single init segment, it ends when the parameter sets change
+	if ( !m_samples.empty() && ( (m_fragmentInitVersion != m_initVersion) || (m_isSampleKey && (m_decodeTime - m_fragmentTime >= (u_int64_t)m_fragmentDuration * kTimescale)) ) )
+	{
+		this->endFragment();
+	}
+
+	// fragments start with a key frame that can be decoded with the init segment
+	if ( !m_samples.empty() || (m_isSampleKey && !m_initSegment->empty()) )
+	{
+		if (m_decodeTime == 0)
+		{
+			m_startTime = m_sampleTime / kTimescale;
+		}
+		if (m_samples.empty())
+		{
+			m_fragmentInitVersion = m_initVersion;
+		}
+		Sample sample = { (unsigned int)m_sampleData.size(), duration, m_isSampleKey };
+		m_samples.push_back(sample);
+		m_mdat.append(m_sampleData);
+		m_decodeTime += duration;
+	}
+	m_hasSample = false;
+}
+
+void FragmentedMP4Sink::writeMoof(std::string & out, unsigned int dataOffset)
+{
+	std::string mfhd;
+	put32(mfhd, 0);
+	put32(mfhd, m_nextFragmentId + 1);
+
+	std::string tfhd;
+	put32(tfhd, kTfhdFlags);
+	put32(tfhd, kTrackId);
+
+	std::string tfdt;
+	put32(tfdt, 0x01000000);
+	put64(tfdt, m_fragmentTime);
+
+	std::string trun;
+	put32(trun, kTrunFlags);
+	put32(trun, m_samples.size());
+	put32(trun, dataOffset);
+	for (std::vector<Sample>::iterator it = m_samples.begin(); it != m_samples.end(); ++it)
+	{
+		put32(trun, it->m_duration);
+		put32(trun, it->m_size);
+		put32(trun, it->m_isKey ? kSampleFlagsKey : kSampleFlagsNonKey);
+	}
+
+	std::string traf;
+	putBox(traf, "tfhd", tfhd);
+	putBox(traf, "tfdt", tfdt);
+	putBox(traf, "trun", trun);
+
+	std::string moof;
+	putBox(moof, "mfhd", mfhd);
+	putBox(moof, "traf", traf);
+	putBox(out, "moof", moof);
+}
+
+void FragmentedMP4Sink::endFragment()
+{
+	// sample data follows the moof and the mdat header
+	std::string moof;
+	this->writeMoof(moof, 0);
+	const unsigned int dataOffset = moof.size() + 8;
+	moof.clear();
+	this->writeMoof(moof, dataOffset);
+
+	std::shared_ptr<std::string> buffer = std::make_shared<std::string>();
+	buffer->reserve(moof.size() + 8 + m_mdat.size());
+	buffer->assign(moof);
+	putBox(*buffer, "mdat", m_mdat);
+
+	const bool isDiscontinuity = !m_fragments.empty() && (m_fragments.rbegin()->second.m_initVersion != m_fragmentInitVersion);
+	Fragment& fragment = m_fragments[m_nextFragmentId++];
+	fragment.m_buffer = buffer;
+	fragment.m_duration = (double)(m_decodeTime - m_fragmentTime) / kTimescale;
+	fragment.m_decodeTime = m_fragmentTime;
+	fragment.m_initVersion = m_fragmentInitVersion;
+	fragment.m_isDiscontinuity = isDiscontinuity;
+
+	m_samples.clear();
+	m_mdat.clear();
+	m_fragmentTime = m_decodeTime;
+
+	// remove old fragments, the discontinuity of the new oldest one is no more listed
+	while (m_fragments.size() > m_nbFragments)
+	{
+		m_fragments.erase(m_fragments.begin());
+		if (m_fragments.begin()->second.m_isDiscontinuity)
+		{
+			m_fragments.begin()->second.m_isDiscontinuity = false;
+			m_discontinuitySequence++;
+		}
+	}
+
+	// remove init segments no more used
+	const unsigned int oldestVersion = m_fragments.begin()->second.m_initVersion;
+	while ( !m_initSegments.empty() && (m_initSegments.begin()->first < oldestVersion) )
+	{
+		m_initSegments.erase(m_initSegments.begin());
+	}
+}
+
+void FragmentedMP4Sink::updateInitSegment()
+{
+	if (m_sps.empty() || m_pps.empty() || (m_isH265 && m_vps.empty()))
+	{
+		return;
+	}
+
+	std::string config;
+	std::ostringstream codec;
+	codec << std::uppercase << std::hex << std::setfill('0');
+	if (m_isH265)
+	{
+		// profile_tier_level follows the NAL header and the sub layers byte
+		std::string sps = toRbsp(m_sps);
+		if (sps.size() < 15)
+		{
+			return;
+		}
+		const unsigned char* ptl = (const unsigned char*)sps.data() + 3;
+		const unsigned int maxSubLayers = ((sps[2] >> 1) & 0x7) + 1;
+		const unsigned int isTemporalIdNested = sps[2] & 0x1;
+
+		put8(config, 1);
+		config.append((const char*)ptl, 12);
+		put16(config, 0xF000); // min_spatial_segmentation_idc
+		put8(config, 0xFC);    // parallelismType
+		put8(config, 0xFD);    // chroma_format_idc 4:2:0
+		put8(config, 0xF8);    // bit_depth_luma 8
+		put8(config, 0xF8);    // bit_depth_chroma 8
+		put16(config, 0);      // avgFrameRate
+		put8(config, (maxSubLayers << 3) | (isTemporalIdNested << 2) | 3);
+		put8(config, 3);
+		const std::string* parameterSets[] = { &m_vps, &m_sps, &m_pps };
+		for (unsigned int i = 0; i < 3; ++i)
+		{
+			put8(config, 0x80 | (32 + i));
+			put16(config, 1);
+			put16(config, parameterSets[i]->size());
+			config.append(*parameterSets[i]);
+		}
+
+		// hvc1.<space><profile>.<compatibility reversed>.<tier><level>.<constraints>
+		unsigned int compatibility = (ptl[1] << 24) | (ptl[2] << 16) | (ptl[3] << 8) | ptl[4];
+		unsigned int reversed = 0;
+		for (unsigned int i = 0; i < 32; ++i)
+		{
+			reversed |= ((compatibility >> i) & 1) << (31 - i);
+		}
+		codec << "hvc1.";
+		if (ptl[0] >> 6)
+		{
+			codec << (char)('A' + (ptl[0] >> 6) - 1);
+		}
+		codec << std::dec << (ptl[0] & 0x1F) << "." << std::hex << reversed << "." << (((ptl[0] >> 5) & 1) ? "H" : "L") << std::dec << (unsigned int)ptl[11];
+		int lastConstraint = 5;
+		while ( (lastConstraint >= 0) && (ptl[5+lastConstraint] == 0) )
+		{
+			lastConstraint--;
+		}
+		codec << std::hex;
+		for (int i = 0; i <= lastConstraint; ++i)
+		{
+			codec << "." << (unsigned int)ptl[5+i];
+		}
+	}
+	else
+	{
+		if (m_sps.size() < 4)
+		{
+			return;
+		}
+		put8(config, 1);
+		config.append(m_sps, 1, 3); // profile, compatibility, level
+		put8(config, 0xFF);         // 4 bytes NAL length
+		put8(config, 0xE1);
+		put16(config, m_sps.size());
+		config.append(m_sps);
+		put8(config, 1);
+		put16(config, m_pps.size());
+		config.append(m_pps);
+
+		codec << "avc1." << std::setw(2) << (unsigned int)(unsigned char)m_sps[1] << std::setw(2) << (unsigned int)(unsigned char)m_sps[2] << std::setw(2) << (unsigned int)(unsigned char)m_sps[3];
+	}
+
+	std::string sampleEntry;
+	sampleEntry.append(6, '\0');
+	put16(sampleEntry, 1);                   // data_reference_index
+	sampleEntry.append(16, '\0');
+	put16(sampleEntry, m_width);
+	put16(sampleEntry, m_height);
+	put32(sampleEntry, 0x00480000);          // 72 dpi
+	put32(sampleEntry, 0x00480000);
+	put32(sampleEntry, 0);
+	put16(sampleEntry, 1);                   // frame_count
+	sampleEntry.append(32, '\0');            // compressorname
+	put16(sampleEntry, 0x0018);              // depth
+	put16(sampleEntry, 0xFFFF);
+	putBox(sampleEntry, m_isH265 ? "hvcC" : "avcC", config);
+
+	std::string stsd;
+	put32(stsd, 0);
+	put32(stsd, 1);
+	putBox(stsd, m_isH265 ? "hvc1" : "avc1", sampleEntry);
+
+	// samples are described in the fragments
+	std::string emptyTable;
+	put32(emptyTable, 0);
+	put32(emptyTable, 0);
+	std::string stsz(emptyTable);
+	put32(stsz, 0);
+
+	std::string stbl;
+	putBox(stbl, "stsd", stsd);
+	putBox(stbl, "stts", emptyTable);
+	putBox(stbl, "stsc", emptyTable);
+	putBox(stbl, "stsz", stsz);
+	putBox(stbl, "stco", emptyTable);
+
+	std::string url;
+	put32(url, 1); // media in the same file
+	std::string dref;
+	put32(dref, 0);
+	put32(dref, 1);
+	putBox(dref, "url ", url);
+	std::string dinf;
+	putBox(dinf, "dref", dref);
+
+	std::string vmhd;
+	put32(vmhd, 1);
+	put16(vmhd, 0);
+	put16(vmhd, 0);
+	put16(vmhd, 0);
+	put16(vmhd, 0);
+
+	std::string minf;
+	putBox(minf, "vmhd", vmhd);
+	putBox(minf, "dinf", dinf);
+	putBox(minf, "stbl", stbl);
+
+	std::string mdhd;
+	put32(mdhd, 0);
+	put32(mdhd, 0);
+	put32(mdhd, 0);
+	put32(mdhd, kTimescale);
+	put32(mdhd, 0);
+	put16(mdhd, 0x55C4); // und
+	put16(mdhd, 0);
+
+	std::string hdlr;
+	put32(hdlr, 0);
+	put32(hdlr, 0);
+	hdlr.append("vide");
+	hdlr.append(12, '\0');
+	hdlr.append("VideoHandler", sizeof("VideoHandler"));
+
+	std::string mdia;
+	putBox(mdia, "mdhd", mdhd);
+	putBox(mdia, "hdlr", hdlr);
+	putBox(mdia, "minf", minf);
+
+	std::string tkhd;
+	put32(tkhd, 0x00000003); // enabled, in movie
+	put32(tkhd, 0);
+	put32(tkhd, 0);
+	put32(tkhd, kTrackId);
+	put32(tkhd, 0);
+	put32(tkhd, 0);
+	tkhd.append(8, '\0');
+	put32(tkhd, 0);          // layer, alternate_group
+	put32(tkhd, 0);          // volume
+	putMatrix(tkhd);
+	put32(tkhd, m_width << 16);
+	put32(tkhd, m_height << 16);
+
+	std::string trak;
+	putBox(trak, "tkhd", tkhd);
+	putBox(trak, "mdia", mdia);
+
+	std::string mvhd;
+	put32(mvhd, 0);
+	put32(mvhd, 0);
+	put32(mvhd, 0);
+	put32(mvhd, 1000);
+	put32(mvhd, 0);
+	put32(mvhd, 0x00010000); // rate
+	put16(mvhd, 0x0100);     // volume
+	mvhd.append(10, '\0');
+	putMatrix(mvhd);
+	mvhd.append(24, '\0');
+	put32(mvhd, kTrackId + 1);
+
+	std::string trex;
+	put32(trex, 0);
+	put32(trex, kTrackId);
+	put32(trex, 1);
+	put32(trex, 0);
+	put32(trex, 0);
+	put32(trex, 0);
+	std::string mvex;
+	putBox(mvex, "trex", trex);
+
+	std::string moov;
+	putBox(moov, "mvhd", mvhd);
+	putBox(moov, "trak", trak);
+	putBox(moov, "mvex", mvex);
+
+	std::string ftyp;
+	ftyp.append("iso6");
+	put32(ftyp, 0);
+	ftyp.append("iso6cmfcmp41");
+
+	std::string initSegment;
+	putBox(initSegment, "ftyp", ftyp);
+	putBox(initSegment, "moov", moov);
+	if (initSegment != *m_initSegment)
+	{
+		m_initSegment = std::make_shared<std::string>(initSegment);
+		m_codec = codec.str();
+		m_initVersion++;
+		InitSegment& init = m_initSegments[m_initVersion];
+		init.m_buffer = m_initSegment;
+		init.m_codec = m_codec;
+		envir() << "FragmentedMP4Sink init segment:" << m_initVersion << " codec:" << m_codec.c_str() << "\n";
+	}
+}
+
+unsigned int FragmentedMP4Sink::getBufferSize(unsigned int fragment)
+{
+	unsigned int size = 0;
+	std::map<unsigned int,Fragment>::iterator it = m_fragments.find(fragment);
+	if (it != m_fragments.end())
+	{
+		size = it->second.m_buffer->size();
+	}
+	return size;
+}
+
+SharedBuffer FragmentedMP4Sink::getBuffer(unsigned int fragment)
+{
+	SharedBuffer content;
+	std::map<unsigned int,Fragment>::iterator it = m_fragments.find(fragment);
+	if (it != m_fragments.end())
+	{
+		content = SharedBuffer(it->second.m_buffer, 0, it->second.m_buffer->size());
+	}
+	return content;
+}
+
+unsigned int FragmentedMP4Sink::firstFragment()
+{
+	unsigned int firstFragment = m_nextFragmentId;
+	if (m_fragments.size() != 0)
+	{
+		firstFragment = m_fragments.begin()->first;
+	}
+	return firstFragment;
+}
+
+std::map<unsigned int,double> FragmentedMP4Sink::getFragmentDurations()
+{
+	std::map<unsigned int,double> durations;
+	for (std::map<unsigned int,Fragment>::iterator it = m_fragments.begin(); it != m_fragments.end(); ++it)
+	{
+		durations[it->first] = it->second.m_duration;
+	}
+	return durations;
+}
+
+u_int64_t FragmentedMP4Sink::getDecodeTime(unsigned int fragment)
+{
+	u_int64_t decodeTime = 0;
+	std::map<unsigned int,Fragment>::iterator it = m_fragments.find(fragment);
+	if (it != m_fragments.end())
+	{
+		decodeTime = it->second.m_decodeTime;
+	}
+	return decodeTime;
+}
+
+unsigned int FragmentedMP4Sink::getFragmentInitVersion(unsigned int fragment)
+{
+	unsigned int version = 0;
+	std::map<unsigned int,Fragment>::iterator it = m_fragments.find(fragment);
+	if (it != m_fragments.end())
+	{
+		version = it->second.m_initVersion;
+	}
+	return version;
+}
+
+SharedBuffer FragmentedMP4Sink::getInitSegment(unsigned int version)
+{
+	SharedBuffer content;
+	std::map<unsigned int,InitSegment>::iterator it = m_initSegments.find(version);
+	if (it != m_initSegments.end())
+	{
+		content = SharedBuffer(it->second.m_buffer, 0, it->second.m_buffer->size());
+	}
+	return content;
+}
+
+std::string FragmentedMP4Sink::getCodec(unsigned int version)
+{
+	std::string codec;
+	std::map<unsigned int,InitSegment>::iterator it = m_initSegments.find(version);
+	if (it != m_initSegments.end())
+	{
+		codec = it->second.m_codec;
+	}
+	return codec;
+}
@@ -0,0 +1,146 @@
+/* ---------------------------------------------------------------------------
+** This software is in the public domain, furnished "as is", without technical
+** support, and with no warranty, express or implied, as to its usefulness for
+** any purpose.
+**
+** GopCache.cpp
+**
+** -------------------------------------------------------------------------*/
+
+#include <string.h>
+
+#include "GopCache.h"
+#include "logger.h"
+
+GopCache::GopCache(const std::string & name, size_t maxSize)
+	: m_name(name), m_maxSize(maxSize), m_size(0), m_nextSeqNo(0), m_lastBuffer(NULL), m_isLastCopied(false), m_isOverflow(false)
+{
+}
+
+void GopCache::addFrame(const V4L2DeviceSource::Frame & frame)
+{
+	// all the NALs split from one encoded frame share its buffer
+	const char* buffer = frame.m_allocatedBuffer.getData();
+	const bool isNewKeyFrame = frame.m_allocatedBuffer.isKeyFrame() && (buffer != m_lastBuffer);
+	if (buffer != m_lastBuffer)
+	{
+		m_lastCopy = FrameRef();
+		m_isLastCopied = false;
+	}
+	m_lastBuffer = buffer;
+
+	if (isNewKeyFrame)
+	{
+		if (!m_frames.empty())
+		{
+			LOG(DEBUG) << "GOP cache " << m_name << " frames:" << m_frames.size() << " size:" << m_size << "/" << m_maxSize;
+		}
+		clear();
+	}
+
+	// frames before the first key frame are useless for a new client
+	if (!m_frames.empty() || isNewKeyFrame)
+	{
+		if (m_size + frame.m_size > m_maxSize)
+		{
+			if (!m_isOverflow)
+			{
+				LOG(WARN) << "GOP cache " << m_name << " overflow frames:" << m_frames.size() << " size:" << m_size << "/" << m_maxSize << ", disabled until next key frame";
+			}
+			clear();
+			m_isOverflow = true;
+		}
+		else if (!m_isOverflow)
+		{
+			V4L2DeviceSource::Frame cachedFrame;
+			if (copyFrame(frame, &cachedFrame))
+			{
+				m_frames.emplace_back(m_nextSeqNo++, cachedFrame);
+				m_size += frame.m_size;
+			}
+			else
+			{
+				LOG(WARN) << "GOP cache " << m_name << " can't allocate frame size:" << frame.m_size << ", disabled until next key frame";
+				clear();
+				m_isOverflow = true;
+			}
+		}
+	}
+}
+
+// the delivered frames can hold encoder buffers, the encoder falls back to
+// copies when too many are held, so the cache copies them once instead
+bool GopCache::copyFrame(const V4L2DeviceSource::Frame & frame, V4L2DeviceSource::Frame* outFrame)
+{
+	const FrameRef & allocatedBuffer = frame.m_allocatedBuffer;
+	const char* data = allocatedBuffer.getData();
+	const bool isInBuffer = (data != NULL) && (frame.m_buffer >= data) && (frame.m_buffer + frame.m_size <= data + allocatedBuffer.getDataSize());
+
+	FrameRef copy;
+	char* buffer = NULL;
+	if (isInBuffer)
+	{
+		// NALs of a captured frame share one copy of it
+		if (!m_isLastCopied)
+		{
+			if (!m_lastCopy.reallocIfNeed(allocatedBuffer.getDataSize()))
+			{
+				return false;
+			}
+			memcpy(m_lastCopy.getData(), data, allocatedBuffer.getDataSize());
+			m_lastCopy.setDataSize(allocatedBuffer.getDataSize());
+			m_lastCopy.setKeyFrame(allocatedBuffer.isKeyFrame());
+			m_lastCopy.setTimestamp(allocatedBuffer.getTimestamp());
+			m_isLastCopied = true;
+		}
+		copy = m_lastCopy;
+		buffer = copy.getData() + (frame.m_buffer - data);
+	}
+	else
+	{
+		// repeated parameter sets are not part of the captured frame
+		if (!copy.reallocIfNeed(frame.m_size))
+		{
+			return false;
+		}
+		memcpy(copy.getData(), frame.m_buffer, frame.m_size);
+		copy.setDataSize(frame.m_size);
+		buffer = copy.getData();
+	}
+
+	*outFrame = V4L2DeviceSource::Frame(buffer, frame.m_size, frame.m_timestamp, copy);
+	outFrame->m_duration = frame.m_duration;
+	outFrame->m_isAccessUnitEnd = frame.m_isAccessUnitEnd;
+	return true;
+}
+
+bool GopCache::getFrame(unsigned long seqNo, V4L2DeviceSource::Frame* outFrame, unsigned long* outSeqNo) const
+{
+	bool found = false;
+
+	if (!m_frames.empty())
+	{
+		// sequence numbers are contiguous in the cache, it is reset on each key frame
+		// so a reader behind it continues from the new key frame
+		const unsigned long firstSeqNo = m_frames.front().m_seqNo;
+		const size_t index = (seqNo > firstSeqNo) ? (seqNo - firstSeqNo) : 0;
+
+		if (index < m_frames.size())
+		{
+			*outFrame = m_frames[index].m_frame;
+			*outSeqNo = m_frames[index].m_seqNo;
+			found = true;
+		}
+	}
+
+	return found;
+}
+
+void GopCache::clear()
+{
+	m_frames.clear();
+	m_lastCopy = FrameRef();
+	m_isLastCopied = false;
+	m_size = 0;
+	m_isOverflow = false;
+}
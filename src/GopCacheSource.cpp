@@ -0,0 +1,105 @@
+/* ---------------------------------------------------------------------------
+** This software is in the public domain, furnished "as is", without technical
+** support, and with no warranty, express or implied, as to its usefulness for
+** any purpose.
+**
+** GopCacheSource.cpp
+**
+** -------------------------------------------------------------------------*/
+
+#include <string.h>
+
+#include "GopCacheSource.h"
+#include "logger.h"
+
+GopCacheSource::GopCacheSource(UsageEnvironment& env, FramedSource* replica, const GopCache* gopCache, const AccessUnitSource* liveSource)
+	: FramedFilter(env, replica), m_gopCache(gopCache), m_liveSource(liveSource), m_isBursting(true), m_isFirstLiveFrame(false), m_nextSeqNo(0), m_burstFrames(0),
+	m_lastCachedFrame(NULL, 0, timeval(), FrameRef())
+{
+}
+
+GopCacheSource::~GopCacheSource()
+{
+}
+
+bool GopCacheSource::isAccessUnitEnd() const
+{
+	return m_isBursting ? m_lastCachedFrame.m_isAccessUnitEnd : m_liveSource->isAccessUnitEnd();
+}
+
+void GopCacheSource::doGetNextFrame()
+{
+	// the replica is not read while bursting, so it does not hold back other replicas
+	if (m_isBursting && !deliverCachedFrame())
+	{
+		m_isBursting = false;
+		m_isFirstLiveFrame = (m_burstFrames > 0);
+		LOG(NOTICE) << "GOP cache burst frames:" << m_burstFrames << " cache frames:" << m_gopCache->getFrameCount() << " size:" << m_gopCache->getSize();
+	}
+
+	if (!m_isBursting && (fInputSource != NULL))
+	{
+		fInputSource->getNextFrame(fTo, fMaxSize,
+				afterGettingFrame, this,
+				handleClosure, this);
+	}
+}
+
+bool GopCacheSource::deliverCachedFrame()
+{
+	unsigned long seqNo = 0;
+	bool delivered = m_gopCache->getFrame(m_nextSeqNo, &m_lastCachedFrame, &seqNo);
+
+	if (delivered)
+	{
+		m_nextSeqNo = seqNo + 1;
+		++m_burstFrames;
+
+		if (m_lastCachedFrame.m_size > fMaxSize)
+		{
+			fFrameSize = fMaxSize;
+			fNumTruncatedBytes = m_lastCachedFrame.m_size - fMaxSize;
+		}
+		else
+		{
+			fFrameSize = m_lastCachedFrame.m_size;
+			fNumTruncatedBytes = 0;
+		}
+		memcpy(fTo, m_lastCachedFrame.m_buffer, fFrameSize);
+		fPresentationTime = m_lastCachedFrame.m_timestamp;
+		fDurationInMicroseconds = 0;
+
+		nextTask() = envir().taskScheduler().scheduleDelayedTask(0, (TaskFunc*)FramedSource::afterGetting, this);
+	}
+
+	return delivered;
+}
+
+void GopCacheSource::afterGettingFrame(unsigned frameSize, unsigned numTruncatedBytes, struct timeval presentationTime, unsigned durationInMicroseconds)
+{
+	// the replica starts with the last cached frame or the one after it
+	bool isDuplicate = false;
+	if (m_isFirstLiveFrame)
+	{
+		m_isFirstLiveFrame = false;
+		isDuplicate = (frameSize == m_lastCachedFrame.m_size)
+			&& (presentationTime.tv_sec == m_lastCachedFrame.m_timestamp.tv_sec)
+			&& (presentationTime.tv_usec == m_lastCachedFrame.m_timestamp.tv_usec)
+			&& (memcmp(fTo, m_lastCachedFrame.m_buffer, frameSize) == 0);
+		// release the cached buffer
+		m_lastCachedFrame = V4L2DeviceSource::Frame(NULL, 0, timeval(), FrameRef());
+	}
+
+	if (isDuplicate)
+	{
+		doGetNextFrame();
+	}
+	else
+	{
+		fFrameSize = frameSize;
+		fNumTruncatedBytes = numTruncatedBytes;
+		fPresentationTime = presentationTime;
+		fDurationInMicroseconds = durationInMicroseconds;
+		afterGetting(this);
+	}
+}
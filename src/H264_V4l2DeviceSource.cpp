@@ -24,57 +24,62 @@
 
 
 // split packet in frames					
-std::list< std::pair<unsigned char*,size_t> > H264_V4L2DeviceSource::splitFrames(unsigned char* frame, unsigned frameSize) 
+void H264_V4L2DeviceSource::splitFrames(unsigned char* frame, unsigned frameSize, FrameList & frameList) 
 {				
-	std::list< std::pair<unsigned char*,size_t> > frameList;
-	
 	size_t bufSize = frameSize;
 	size_t size = 0;
 	int frameType = 0;
+	bool hasSps = false;
+	bool hasPps = false;
+	bool isChanged = false;
 	unsigned char* buffer = this->extractFrame(frame, bufSize, size, frameType);
 	while (buffer != NULL)				
 	{	
 		switch (frameType&0x1F)					
 		{
-			case 7: LOG(INFO) << "SPS size:" << size << " bufSize:" << bufSize; if (m_sps.empty()) m_sps.assign((char*)buffer,size); break;
-			case 8: LOG(INFO) << "PPS size:" << size << " bufSize:" << bufSize; if (m_pps.empty()) m_pps.assign((char*)buffer,size); break;
+			case 7: LOG(INFO) << "SPS size:" << size << " bufSize:" << bufSize; hasSps = true; isChanged |= this->updateParameterSet(m_sps, m_repeatedSps, buffer, size, "SPS"); break;
+			case 8: LOG(INFO) << "PPS size:" << size << " bufSize:" << bufSize; hasPps = true; isChanged |= this->updateParameterSet(m_pps, m_repeatedPps, buffer, size, "PPS"); break;
 			case 5: LOG(INFO) << "IDR size:" << size << " bufSize:" << bufSize; 
-				if (m_repeatConfig && !m_sps.empty() && !m_pps.empty())
+				// an IDR carrying its own parameter sets does not need the cached ones
+				if (m_repeatConfig && !(hasSps && hasPps) && !m_sps.empty() && !m_pps.empty())
 				{
-					frameList.push_back(std::pair<unsigned char*,size_t>((unsigned char*)m_sps.c_str(), m_sps.size()));
-					frameList.push_back(std::pair<unsigned char*,size_t>((unsigned char*)m_pps.c_str(), m_pps.size()));
+					frameList.push_back(m_repeatedSps);
+					frameList.push_back(m_repeatedPps);
 				}
 			break;
 			default: 
 				break;
 		}
 		
-		if (m_auxLine.empty() && !m_sps.empty() && !m_pps.empty())
-		{
-			u_int32_t profile_level_id = 0;					
-			if (m_sps.size() >= 4) profile_level_id = (((unsigned char)m_sps[1])<<16)|(((unsigned char)m_sps[2])<<8)|((unsigned char)m_sps[3]); 
-		
-			char* sps_base64 = base64Encode(m_sps.c_str(), m_sps.size());
-			char* pps_base64 = base64Encode(m_pps.c_str(), m_pps.size());		
-
-			std::ostringstream os; 
-			os << "profile-level-id=" << std::hex << std::setw(6) << std::setfill('0') << profile_level_id;
-			os << ";sprop-parameter-sets=" << sps_base64 <<"," << pps_base64;
-			m_auxLine.assign(os.str());
-			
-			delete [] sps_base64;
-			delete [] pps_base64;
-		}
 		frameList.push_back(std::pair<unsigned char*,size_t>(buffer, size));
 		
 		buffer = this->extractFrame(&buffer[size], bufSize, size, frameType);
 	}
-	return frameList;
+
+	// parameter sets of the access unit are published together, once
+	if (isChanged && !m_sps.empty() && !m_pps.empty())
+	{
+		u_int32_t profile_level_id = 0;					
+		if (m_sps.size() >= 4) profile_level_id = (((unsigned char)m_sps[1])<<16)|(((unsigned char)m_sps[2])<<8)|((unsigned char)m_sps[3]); 
+	
+		char* sps_base64 = base64Encode(m_sps.c_str(), m_sps.size());
+		char* pps_base64 = base64Encode(m_pps.c_str(), m_pps.size());		
+
+		std::ostringstream os; 
+		os << "profile-level-id=" << std::hex << std::setw(6) << std::setfill('0') << profile_level_id;
+		os << ";sprop-parameter-sets=" << sps_base64 <<"," << pps_base64;
+		this->setAuxLine(os.str());
+		
+		delete [] sps_base64;
+		delete [] pps_base64;
+	}
 }
 
 std::list< std::string > H264_V4L2DeviceSource::getInitFrames() {
 	std::list< std::string > frameList;
+	pthread_mutex_lock (&m_mutex);
 	frameList.push_back(this->getFrameWithMarker(m_sps));
 	frameList.push_back(this->getFrameWithMarker(m_pps));
+	pthread_mutex_unlock (&m_mutex);
 	return frameList;
 }
@@ -19,60 +19,66 @@
 #include "H265_V4l2DeviceSource.h"
 
 // split packet in frames					
-std::list< std::pair<unsigned char*,size_t> > H265_V4L2DeviceSource::splitFrames(unsigned char* frame, unsigned frameSize) 
+void H265_V4L2DeviceSource::splitFrames(unsigned char* frame, unsigned frameSize, FrameList & frameList) 
 {				
-	std::list< std::pair<unsigned char*,size_t> > frameList;
-	
 	size_t bufSize = frameSize;
 	size_t size = 0;
 	int frameType = 0;
+	bool hasVps = false;
+	bool hasSps = false;
+	bool hasPps = false;
+	bool isChanged = false;
 	unsigned char* buffer = this->extractFrame(frame, bufSize, size, frameType);
 	while (buffer != NULL)				
 	{
 		switch ((frameType&0x7E)>>1)					
 		{
-			case 32: LOG(INFO) << "VPS size:" << size << " bufSize:" << bufSize; if (m_vps.empty()) m_vps.assign((char*)buffer,size); break;
-			case 33: LOG(INFO) << "SPS size:" << size << " bufSize:" << bufSize; if (m_sps.empty()) m_sps.assign((char*)buffer,size); break;
-			case 34: LOG(INFO) << "PPS size:" << size << " bufSize:" << bufSize; if (m_pps.empty()) m_pps.assign((char*)buffer,size); break;
+			case 32: LOG(INFO) << "VPS size:" << size << " bufSize:" << bufSize; hasVps = true; isChanged |= this->updateParameterSet(m_vps, m_repeatedVps, buffer, size, "VPS"); break;
+			case 33: LOG(INFO) << "SPS size:" << size << " bufSize:" << bufSize; hasSps = true; isChanged |= this->updateParameterSet(m_sps, m_repeatedSps, buffer, size, "SPS"); break;
+			case 34: LOG(INFO) << "PPS size:" << size << " bufSize:" << bufSize; hasPps = true; isChanged |= this->updateParameterSet(m_pps, m_repeatedPps, buffer, size, "PPS"); break;
 			case 19: 
 			case 20: LOG(INFO) << "IDR size:" << size << " bufSize:" << bufSize; 
-				if (m_repeatConfig && !m_vps.empty() && !m_sps.empty() && !m_pps.empty())
+				// an IDR carrying its own parameter sets does not need the cached ones
+				if (m_repeatConfig && !(hasVps && hasSps && hasPps) && !m_vps.empty() && !m_sps.empty() && !m_pps.empty())
 				{
-					frameList.push_back(std::pair<unsigned char*,size_t>((unsigned char*)m_vps.c_str(), m_vps.size()));
-					frameList.push_back(std::pair<unsigned char*,size_t>((unsigned char*)m_sps.c_str(), m_sps.size()));
-					frameList.push_back(std::pair<unsigned char*,size_t>((unsigned char*)m_pps.c_str(), m_pps.size()));
+					frameList.push_back(m_repeatedVps);
+					frameList.push_back(m_repeatedSps);
+					frameList.push_back(m_repeatedPps);
 				}
 			break;
 			default: break;
 		}
 		
-		if (m_auxLine.empty() && !m_vps.empty() && !m_sps.empty() && !m_pps.empty())
-		{		
-			char* vps_base64 = base64Encode(m_vps.c_str(), m_vps.size());
-			char* sps_base64 = base64Encode(m_sps.c_str(), m_sps.size());
-			char* pps_base64 = base64Encode(m_pps.c_str(), m_pps.size());		
-
-			std::ostringstream os; 
-			os << "sprop-vps=" << vps_base64;
-			os << ";sprop-sps=" << sps_base64;
-			os << ";sprop-pps=" << pps_base64;
-			m_auxLine.assign(os.str());
-			
-			delete [] vps_base64;
-			delete [] sps_base64;
-			delete [] pps_base64;
-		}
 		frameList.push_back(std::pair<unsigned char*,size_t>(buffer, size));
 		
 		buffer = this->extractFrame(&buffer[size], bufSize, size, frameType);
 	}
-	return frameList;
+
+	// parameter sets of the access unit are published together, once
+	if (isChanged && !m_vps.empty() && !m_sps.empty() && !m_pps.empty())
+	{		
+		char* vps_base64 = base64Encode(m_vps.c_str(), m_vps.size());
+		char* sps_base64 = base64Encode(m_sps.c_str(), m_sps.size());
+		char* pps_base64 = base64Encode(m_pps.c_str(), m_pps.size());		
+
+		std::ostringstream os; 
+		os << "sprop-vps=" << vps_base64;
+		os << ";sprop-sps=" << sps_base64;
+		os << ";sprop-pps=" << pps_base64;
+		this->setAuxLine(os.str());
+		
+		delete [] vps_base64;
+		delete [] sps_base64;
+		delete [] pps_base64;
+	}
 }
 
 std::list< std::string > H265_V4L2DeviceSource::getInitFrames() {
 	std::list< std::string > frameList;
+	pthread_mutex_lock (&m_mutex);
 	frameList.push_back(this->getFrameWithMarker(m_vps));
 	frameList.push_back(this->getFrameWithMarker(m_sps));
 	frameList.push_back(this->getFrameWithMarker(m_pps));
+	pthread_mutex_unlock (&m_mutex);
 	return frameList;
 }
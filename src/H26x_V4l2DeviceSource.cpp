@@ -10,6 +10,7 @@
 ** -------------------------------------------------------------------------*/
 
 #include <sstream>
+#include <string.h>
 
 // live555
 #include <Base64.hh>
@@ -17,59 +18,38 @@
 // project
 #include "logger.h"
 #include "H26x_V4l2DeviceSource.h"
-
-const size_t kMaxSearchLen = 128;
+#include "NalParser.h"
 
 // extract a frame
 unsigned char*  H26X_V4L2DeviceSource::extractFrame(unsigned char* frame, size_t& size, size_t& outsize, int& frameType)
 {						
-	unsigned char * outFrame = NULL;
-	outsize = 0;
-	unsigned int markerlength = 0;
-	frameType = 0;
-
-	const size_t maxLen = std::min(size, kMaxSearchLen);
-	
-	unsigned char *startFrame = (unsigned char*)memmem(frame,maxLen,H264marker,sizeof(H264marker));
-	if (startFrame != NULL) {
-		markerlength = sizeof(H264marker);
-	} 
-
-	if (startFrame != NULL) {
-		frameType = startFrame[markerlength];
-		
-		size_t remainingSize = size-(startFrame-frame+markerlength);
-		const size_t maxRemLen = std::min(remainingSize, kMaxSearchLen);
-
-		unsigned char *endFrame = (unsigned char*)memmem(&startFrame[markerlength], maxRemLen, H264marker, sizeof(H264marker));
-		
-		if (m_keepMarker)
-		{
-			size -=  startFrame-frame;
-			outFrame = startFrame;
-		}
-		else
-		{
-			size -=  startFrame-frame+markerlength;
-			outFrame = &startFrame[markerlength];
-		}
-		
-		if (endFrame != NULL)
-		{
-			outsize = endFrame - outFrame;
-		}
-		else
-		{
-			outsize = size;
-		}
-		size -= outsize;		
-	} else if (size>= sizeof(H264shortmarker)) {
+	const size_t bufSize = size;
+	unsigned char* outFrame = NalParser::extractNal(frame, size, outsize, frameType, m_keepMarker);
+	if ( (outFrame == NULL) && (bufSize >= sizeof(H264shortmarker)) ) {
 		 LOG(INFO) << "No marker found";
 	}
-
 	return outFrame;
 }
 
+// update a cached parameter set, true when it changed
+bool H26X_V4L2DeviceSource::updateParameterSet(std::string & parameterSet, std::shared_ptr<const std::string> & repeated, unsigned char* buffer, size_t size, const char* name)
+{
+	bool isChanged = false;
+	if ( (parameterSet.size() != size) || (memcmp(parameterSet.data(), buffer, size) != 0) )
+	{
+		if (!parameterSet.empty()) {
+			LOG(NOTICE) << name << " changed size:" << size;
+		}
+		pthread_mutex_lock (&m_mutex);
+		parameterSet.assign((char*)buffer, size);
+		pthread_mutex_unlock (&m_mutex);
+		// a new copy, the previous one is released with the last frame queued from it
+		repeated = std::make_shared<const std::string>((char*)buffer, size);
+		isChanged = true;
+	}
+	return isChanged;
+}
+
 std::string H26X_V4L2DeviceSource::getFrameWithMarker(const std::string & frame) {
 	std::string frameWithMarker;
 	frameWithMarker.append(H264marker, sizeof(H264marker));
@@ -7,7 +7,7 @@
 ** 
 ** V4L2 RTSP streamer                                                                 
 **                                                                                    
-** HTTP server that serves HLS & MPEG-DASH playlist and segments
+** HTTP server that serves HLS & MPEG-DASH playlist and segments, JPEG snapshots and MJPEG
 **                                                                                    
 ** -------------------------------------------------------------------------*/
 
@@ -15,6 +15,10 @@
 #include <sstream>
 #include <fstream>
 #include <algorithm>
+#include <math.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
 
 #include "RTSPServer.hh"
 #include "RTSPCommon.hh"
@@ -22,10 +26,40 @@
 #include "ByteStreamMemoryBufferSource.hh"
 
 #include "HTTPServer.h"
+#include "TSServerMediaSubsession.h"
+#include "AnykaCameraManager.h"
 
-u_int32_t HTTPServer::HTTPClientConnection::m_ClientSessionId = 0;
+// complete slices that still list their parts in LL-HLS playlists
+const unsigned int kPartListedSlices = 2;
+// blocking requests further than this in the future are refused
+const unsigned int kMaxBlockingSlices = 2;
+// snapshot long-poll without new JPEG answers with the current one
+const unsigned int kSnapshotWaitTimeout = 10;
+const char* kMjpegBoundary = "mjpegframe";
 
-void HTTPServer::HTTPClientConnection::sendHeader(const char* contentType, unsigned int contentLength)
+// value of a request header, empty when missing
+static std::string getHeaderValue(char const* fullRequestStr, char const* name)
+{
+	std::string value;
+	size_t nameSize = strlen(name);
+	char const* line = strstr(fullRequestStr, "\r\n");
+	while ( (line != NULL) && (line[2] != '\r') && (line[2] != '\0') )
+	{
+		line += 2;
+		if ( (strncasecmp(line, name, nameSize) == 0) && (line[nameSize] == ':') )
+		{
+			char const* start = line + nameSize + 1;
+			while (*start == ' ') start++;
+			char const* end = strstr(start, "\r\n");
+			value.assign(start, (end != NULL) ? end - start : strlen(start));
+			break;
+		}
+		line = strstr(line, "\r\n");
+	}
+	return value;
+}
+
+void HTTPServer::HTTPClientConnection::formatHeader(const char* contentType, unsigned int contentLength, const char* extraHeaders)
 {
 	// Construct our response:
 	snprintf((char*)fResponseBuffer, sizeof fResponseBuffer,
@@ -35,11 +69,18 @@ void HTTPServer::HTTPClientConnection::sendHeader(const char* contentType, unsig
            "Access-Control-Allow-Origin: *\r\n" 
 	   "Content-Type: %s\r\n"
 	   "Content-Length: %d\r\n"
+	   "%s"
 	   "\r\n",
 	   dateHeader(),
 	   LIVEMEDIA_LIBRARY_VERSION_STRING,
 	   contentType,
-	   contentLength);
+	   contentLength,
+	   extraHeaders);
+}
+
+void HTTPServer::HTTPClientConnection::sendHeader(const char* contentType, unsigned int contentLength)
+{
+	  this->formatHeader(contentType, contentLength);
 
 	  // Send the response header 
 	  send(fClientOutputSocket, (char const*)fResponseBuffer, strlen((char*)fResponseBuffer), 0);
@@ -72,6 +113,68 @@ void HTTPServer::HTTPClientConnection::streamSource(FramedSource* source)
       }
 }
 
+// header and body are sent together from the shared segment, without copy
+void HTTPServer::HTTPClientConnection::streamBuffer(const char* contentType, const SharedBuffer & body, const char* extraHeaders)
+{
+	this->formatHeader(contentType, body.size(), extraHeaders);
+	m_sendHeader.assign((const char*)fResponseBuffer);
+	fResponseBuffer[0] = '\0'; // sent below, not by the calling code
+	m_sendBody = body;
+	m_sentBytes = 0;
+	this->sendBufferedData();
+}
+
+void HTTPServer::HTTPClientConnection::sendBufferedData()
+{
+	struct iovec iov[2];
+	int count = 0;
+	size_t bodyOffset = 0;
+	if (m_sentBytes < m_sendHeader.size())
+	{
+		iov[count].iov_base = (void*)(m_sendHeader.data() + m_sentBytes);
+		iov[count].iov_len = m_sendHeader.size() - m_sentBytes;
+		count++;
+	}
+	else
+	{
+		bodyOffset = m_sentBytes - m_sendHeader.size();
+	}
+	if (bodyOffset < m_sendBody.size())
+	{
+		iov[count].iov_base = (void*)(m_sendBody.data() + bodyOffset);
+		iov[count].iov_len = m_sendBody.size() - bodyOffset;
+		count++;
+	}
+
+	struct msghdr msg;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = iov;
+	msg.msg_iovlen = count;
+	ssize_t written = (count > 0) ? sendmsg(fClientOutputSocket, &msg, MSG_NOSIGNAL) : 0;
+	if (written > 0)
+	{
+		m_sentBytes += written;
+	}
+
+	if ( (m_sentBytes < m_sendHeader.size() + m_sendBody.size()) && ((written >= 0) || (errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR)) )
+	{
+		// wait for the socket to be writable again
+		envir().taskScheduler().setBackgroundHandling(fClientOutputSocket, SOCKET_WRITABLE, socketWritableHandler, this);
+	}
+	else if ( m_isMjpegClient && (m_sentBytes >= m_sendHeader.size() + m_sendBody.size()) )
+	{
+		// part sent, continue with the latest JPEG if it was skipped meanwhile
+		m_sendBody = SharedBuffer();
+		this->sendMjpegFrame();
+	}
+	else
+	{
+		// done, or the client is gone
+		m_sendBody = SharedBuffer();
+		afterStreaming(this);
+	}
+}
+
 void lookupServerMediaSessionCompletionFuncCallback(void* clientData, ServerMediaSession* sessionLookedUp) {
 	ServerMediaSession** ptr = (ServerMediaSession**)clientData;
 	*ptr = sessionLookedUp;
@@ -96,31 +199,60 @@ ServerMediaSubsession* HTTPServer::HTTPClientConnection::getSubsesion(const char
 		
 bool HTTPServer::HTTPClientConnection::sendM3u8PlayList(char const* urlSuffix)
 {
-	ServerMediaSubsession* subsession = this->getSubsesion(urlSuffix);
+	TSServerMediaSubsession* subsession = dynamic_cast<TSServerMediaSubsession*>(this->getSubsesion(urlSuffix));
 	if (subsession == NULL) 
 	{
 		return false;			  
 	}
 
-	float duration = subsession->duration();
-	if (duration <= 0.0) 
+	// slices start on key frames, each one has its own duration
+	MemoryBufferSink* hlsSink = subsession->getHlsSink();
+	std::map<unsigned int,double> slices = hlsSink->getSliceDurations();
+	if (slices.empty()) 
 	{
 		return false;			  
 	}
+	const double partDuration = hlsSink->getPartDuration();
 	
-	unsigned int startTime = subsession->getCurrentNPT(NULL);
 	HTTPServer* httpServer = (HTTPServer*)(&fOurServer);
-	unsigned sliceDuration = httpServer->m_hlsSegment;		  
+	unsigned int targetDuration = httpServer->m_hlsSegment;
+	for (std::map<unsigned int,double>::iterator it = slices.begin(); it != slices.end(); ++it)
+	{
+		targetDuration = std::max(targetDuration, (unsigned int)ceil(it->second));
+	}
+
 	std::ostringstream os;
 	os  	<< "#EXTM3U\r\n"
+		<< "#EXT-X-VERSION:" << ((partDuration > 0) ? 6 : 3) << "\r\n"
 		<< "#EXT-X-ALLOW-CACHE:NO\r\n"
-		<< "#EXT-X-MEDIA-SEQUENCE:" << startTime <<  "\r\n"
-		<< "#EXT-X-TARGETDURATION:" << sliceDuration << "\r\n";
+		<< "#EXT-X-MEDIA-SEQUENCE:" << slices.begin()->first <<  "\r\n"
+		<< "#EXT-X-TARGETDURATION:" << targetDuration << "\r\n";
+
+	os << std::fixed << std::setprecision(3);
+	if (partDuration > 0)
+	{
+		os	<< "#EXT-X-SERVER-CONTROL:CAN-BLOCK-RELOAD=YES,PART-HOLD-BACK=" << 3*partDuration << "\r\n"
+			<< "#EXT-X-PART-INF:PART-TARGET=" << partDuration << "\r\n";
+	}
+
+	unsigned int remainingSlices = slices.size();
+	for (std::map<unsigned int,double>::iterator it = slices.begin(); it != slices.end(); ++it, --remainingSlices)
+	{
+		if ( (partDuration > 0) && (remainingSlices <= kPartListedSlices) )
+		{
+			this->writeParts(os, urlSuffix, it->first, hlsSink->getParts(it->first));
+		}
+		os << "#EXTINF:" << it->second << ",\r\n";
+		os << urlSuffix << "?segment=" << it->first << "\r\n";
+	}
 
-	for (unsigned int slice=0; slice*sliceDuration<duration; slice++)
+	if (partDuration > 0)
 	{
-		os << "#EXTINF:" << sliceDuration << ",\r\n";
-		os << urlSuffix << "?segment=" << (startTime+slice*sliceDuration) << "\r\n";
+		// parts of the slice being filled and the one expected next
+		const unsigned int lastSlice = hlsSink->lastSlice();
+		const std::vector<MemoryBufferSink::Part> parts = hlsSink->getParts(lastSlice);
+		this->writeParts(os, urlSuffix, lastSlice, parts);
+		os << "#EXT-X-PRELOAD-HINT:TYPE=PART,URI=\"" << urlSuffix << "?segment=" << lastSlice << "&part=" << parts.size() << "\"\r\n";
 	}
 	
 	envir() << "send M3u8 playlist:" << urlSuffix <<"\n";
@@ -135,21 +267,532 @@ bool HTTPServer::HTTPClientConnection::sendM3u8PlayList(char const* urlSuffix)
 	return true;			  
 }
 		
+void HTTPServer::HTTPClientConnection::writeParts(std::ostringstream & os, char const* urlSuffix, unsigned int slice, const std::vector<MemoryBufferSink::Part> & parts)
+{
+	for (unsigned int i = 0; i < parts.size(); ++i)
+	{
+		os << "#EXT-X-PART:DURATION=" << parts[i].m_duration << ",URI=\"" << urlSuffix << "?segment=" << slice << "&part=" << i << "\"";
+		if (parts[i].m_isIndependent)
+		{
+			os << ",INDEPENDENT=YES";
+		}
+		os << "\r\n";
+	}
+}
+
+bool HTTPServer::HTTPClientConnection::sendPart(char const* urlSuffix, unsigned int slice, unsigned int part)
+{
+	TSServerMediaSubsession* subsession = dynamic_cast<TSServerMediaSubsession*>(this->getSubsesion(urlSuffix));
+	if (subsession == NULL) 
+	{
+		return false;			  
+	}
+
+	SharedBuffer content = subsession->getHlsSink()->getPart(slice, part);
+	if (content.empty())
+	{
+		return false;
+	}
+
+	this->streamBuffer("video/mp2t", content);
+
+	return true;
+}
+
+bool HTTPServer::HTTPClientConnection::sendSlice(char const* urlSuffix, unsigned int slice)
+{
+	TSServerMediaSubsession* subsession = dynamic_cast<TSServerMediaSubsession*>(this->getSubsesion(urlSuffix));
+	if (subsession == NULL) 
+	{
+		return false;			  
+	}
+
+	SharedBuffer content = subsession->getHlsSink()->getBuffer(slice);
+	if (content.empty())
+	{
+		return false;
+	}
+
+	this->streamBuffer("video/mp2t", content);
+
+	return true;
+}
+
+bool HTTPServer::HTTPClientConnection::waitHlsRequest(char const* urlSuffix, unsigned int slice, int part, bool isPartRequest)
+{
+	TSServerMediaSubsession* subsession = dynamic_cast<TSServerMediaSubsession*>(this->getSubsesion(urlSuffix));
+	if ( (subsession == NULL) || (subsession->getHlsSink()->getPartDuration() <= 0) )
+	{
+		return false;			  
+	}
+
+	MemoryBufferSink* hlsSink = subsession->getHlsSink();
+	if (slice > hlsSink->lastSlice() + kMaxBlockingSlices)
+	{
+		// a playlist too far ahead is a client error, a part there does not exist
+		this->sendHlsError(isPartRequest ? "404 Not Found" : "400 Bad Request");
+		return true;
+	}
+
+	this->stopWaitingHlsRequest();
+	m_hlsUrl = urlSuffix;
+	m_hlsSlice = slice;
+	m_hlsPart = part;
+	m_isHlsPartRequest = isPartRequest;
+	m_hlsSink = hlsSink;
+	if (this->isHlsRequestReady())
+	{
+		m_hlsSink = NULL;
+		return this->sendHlsRequest();
+	}
+
+	// answer later from the part listener, or the timeout
+	envir() << "wait HLS request:" << urlSuffix << " segment:" << slice << " part:" << part << "\n";
+	HTTPServer* httpServer = (HTTPServer*)(&fOurServer);
+	m_hlsSink->addPartListener(onHlsPartStub, this);
+	m_hlsTimeoutTask = envir().taskScheduler().scheduleDelayedTask(3*httpServer->m_hlsSegment*1000000, onHlsTimeoutStub, this);
+	fResponseBuffer[0] = '\0'; // nothing to send now
+	return true;
+}
+
+bool HTTPServer::HTTPClientConnection::isHlsRequestReady()
+{
+	return (m_hlsPart < 0) ? m_hlsSink->isSliceAvailable(m_hlsSlice) : m_hlsSink->isPartAvailable(m_hlsSlice, m_hlsPart);
+}
+
+bool HTTPServer::HTTPClientConnection::sendHlsRequest()
+{
+	bool ok;
+	if (m_isHlsPartRequest)
+	{
+		// the segment was cut before the hinted part, or it is already removed
+		if (!this->sendPart(m_hlsUrl.c_str(), m_hlsSlice, m_hlsPart))
+		{
+			this->sendHlsError("404 Not Found");
+		}
+		ok = true;
+	}
+	else
+	{
+		ok = this->sendM3u8PlayList(m_hlsUrl.c_str());
+	}
+	return ok;
+}
+
+void HTTPServer::HTTPClientConnection::sendHlsError(const char* status)
+{
+	snprintf((char*)fResponseBuffer, sizeof fResponseBuffer,
+		"HTTP/1.1 %s\r\n"
+		"%s"
+		"Content-Length: 0\r\n"
+		"\r\n",
+		status, dateHeader());
+	fIsActive = False;
+}
+
+void HTTPServer::HTTPClientConnection::stopWaitingHlsRequest()
+{
+	if (m_hlsSink != NULL)
+	{
+		m_hlsSink->removePartListener(onHlsPartStub, this);
+		m_hlsSink = NULL;
+	}
+	envir().taskScheduler().unscheduleDelayedTask(m_hlsTimeoutTask);
+}
+
+void HTTPServer::HTTPClientConnection::onHlsPart(bool isTimeout)
+{
+	if (isTimeout)
+	{
+		m_hlsTimeoutTask = NULL;
+	}
+	if ( (m_hlsSink == NULL) || (!isTimeout && !this->isHlsRequestReady()) )
+	{
+		return;
+	}
+	this->stopWaitingHlsRequest();
+
+	// the response could end the connection while it is sent
+	++fRecursionCount;
+	if (isTimeout)
+	{
+		this->sendHlsError("503 Service Unavailable");
+	}
+	else if (!this->sendHlsRequest())
+	{
+		handleHTTPCmd_notSupported();
+		fIsActive = False;
+	}
+	if (fResponseBuffer[0] != '\0')
+	{
+		send(fClientOutputSocket, (char const*)fResponseBuffer, strlen((char*)fResponseBuffer), 0);
+		fResponseBuffer[0] = '\0';
+	}
+	--fRecursionCount;
+
+	if (!fIsActive)
+	{
+		delete this;
+	}
+}
+
+void HTTPServer::HTTPClientConnection::handleSnapshot(char const* questionMarkPos, char const* fullRequestStr)
+{
+	HTTPServer* httpServer = (HTTPServer*)(&fOurServer);
+	bool isWait = (questionMarkPos != NULL) && (strstr(questionMarkPos, "wait=1") != NULL);
+	m_snapshotEtag = getHeaderValue(fullRequestStr, "If-None-Match");
+
+	// wait for the next JPEG, unless the client does not have the current one
+	unsigned int sequence = 0;
+	SharedBuffer jpeg = httpServer->getSnapshot(sequence);
+	if (isWait && (jpeg.empty() || m_snapshotEtag.empty() || (m_snapshotEtag.find(httpServer->getSnapshotEtag(sequence)) != std::string::npos)))
+	{
+		this->stopWaitingSnapshot();
+		m_isWaitingSnapshot = true;
+		m_snapshotSequence = sequence;
+		httpServer->m_snapshotWaiters.push_back(this);
+		m_snapshotTimeoutTask = envir().taskScheduler().scheduleDelayedTask(kSnapshotWaitTimeout*1000000, onSnapshotTimeoutStub, this);
+		fResponseBuffer[0] = '\0'; // nothing to send now
+	}
+	else if (!this->sendSnapshot())
+	{
+		snprintf((char*)fResponseBuffer, sizeof fResponseBuffer,
+			"HTTP/1.1 503 Service Unavailable\r\n"
+			"%s"
+			"Content-Length: 0\r\n"
+			"\r\n",
+			dateHeader());
+		fIsActive = False;
+	}
+}
+
+bool HTTPServer::HTTPClientConnection::sendSnapshot()
+{
+	HTTPServer* httpServer = (HTTPServer*)(&fOurServer);
+	unsigned int sequence = 0;
+	SharedBuffer jpeg = httpServer->getSnapshot(sequence);
+	if (jpeg.empty())
+	{
+		return false;
+	}
+
+	std::string etag(httpServer->getSnapshotEtag(sequence));
+	std::string headers("ETag: ");
+	headers.append(etag).append("\r\nCache-Control: no-cache\r\n");
+	if ( (m_snapshotEtag == "*") || (m_snapshotEtag.find(etag) != std::string::npos) )
+	{
+		snprintf((char*)fResponseBuffer, sizeof fResponseBuffer,
+			"HTTP/1.1 304 Not Modified\r\n"
+			"%s"
+			"Access-Control-Allow-Origin: *\r\n"
+			"%s"
+			"\r\n",
+			dateHeader(),
+			headers.c_str());
+		fIsActive = False;
+	}
+	else
+	{
+		this->streamBuffer("image/jpeg", jpeg, headers.c_str());
+	}
+	return true;
+}
+
+void HTTPServer::HTTPClientConnection::stopWaitingSnapshot()
+{
+	if (m_isWaitingSnapshot)
+	{
+		HTTPServer* httpServer = (HTTPServer*)(&fOurServer);
+		httpServer->m_snapshotWaiters.remove(this);
+		m_isWaitingSnapshot = false;
+	}
+	envir().taskScheduler().unscheduleDelayedTask(m_snapshotTimeoutTask);
+}
+
+void HTTPServer::HTTPClientConnection::onSnapshot(bool isTimeout)
+{
+	if (isTimeout)
+	{
+		m_snapshotTimeoutTask = NULL;
+	}
+	HTTPServer* httpServer = (HTTPServer*)(&fOurServer);
+	unsigned int sequence = 0;
+	if ( !m_isWaitingSnapshot || (!isTimeout && (httpServer->getSnapshot(sequence).empty() || (sequence == m_snapshotSequence))) )
+	{
+		return;
+	}
+	this->stopWaitingSnapshot();
+
+	// the response could end the connection while it is sent
+	++fRecursionCount;
+	if (!this->sendSnapshot())
+	{
+		snprintf((char*)fResponseBuffer, sizeof fResponseBuffer,
+			"HTTP/1.1 503 Service Unavailable\r\n"
+			"%s"
+			"Content-Length: 0\r\n"
+			"\r\n",
+			dateHeader());
+		fIsActive = False;
+	}
+	if (fResponseBuffer[0] != '\0')
+	{
+		send(fClientOutputSocket, (char const*)fResponseBuffer, strlen((char*)fResponseBuffer), 0);
+		fResponseBuffer[0] = '\0';
+	}
+	--fRecursionCount;
+
+	if (!fIsActive)
+	{
+		delete this;
+	}
+}
+
+void HTTPServer::HTTPClientConnection::startMjpeg()
+{
+	// the response has no length, it lasts until the client is gone
+	snprintf((char*)fResponseBuffer, sizeof fResponseBuffer,
+	   "HTTP/1.1 200 OK\r\n"
+	   "%s"
+	   "Server: LIVE555 Streaming Media v%s\r\n"
+	   "Access-Control-Allow-Origin: *\r\n"
+	   "Cache-Control: no-cache\r\n"
+	   "Content-Type: multipart/x-mixed-replace;boundary=%s\r\n"
+	   "\r\n",
+	   dateHeader(),
+	   LIVEMEDIA_LIBRARY_VERSION_STRING,
+	   kMjpegBoundary);
+	m_mjpegHeader.assign((const char*)fResponseBuffer);
+	fResponseBuffer[0] = '\0'; // sent with the first JPEG
+
+	this->stopMjpeg();
+	HTTPServer* httpServer = (HTTPServer*)(&fOurServer);
+	m_isMjpegClient = true;
+	httpServer->m_mjpegClients.push_back(this);
+	this->sendMjpegFrame();
+}
+
+void HTTPServer::HTTPClientConnection::sendMjpegFrame()
+{
+	HTTPServer* httpServer = (HTTPServer*)(&fOurServer);
+	unsigned int sequence = 0;
+	SharedBuffer jpeg = httpServer->getSnapshot(sequence);
+
+	// the response header is sent once, before the first part
+	std::ostringstream os;
+	os << m_mjpegHeader;
+	m_mjpegHeader.clear();
+	SharedBuffer body;
+	if ( (!jpeg.empty()) && (sequence != m_mjpegSequence) )
+	{
+		os << "\r\n--" << kMjpegBoundary << "\r\n"
+		   << "Content-Type: image/jpeg\r\n"
+		   << "Content-Length: " << jpeg.size() << "\r\n"
+		   << "\r\n";
+		body = jpeg;
+		m_mjpegSequence = sequence;
+	}
+
+	if (os.tellp() > 0)
+	{
+		m_sendHeader.assign(os.str());
+		m_sendBody = body;
+		m_sentBytes = 0;
+		this->sendBufferedData();
+	}
+}
+
+void HTTPServer::HTTPClientConnection::onMjpegFrame()
+{
+	// a slow client gets the latest JPEG once the previous one is sent
+	if (!this->isSending())
+	{
+		this->sendMjpegFrame();
+	}
+}
+
+void HTTPServer::HTTPClientConnection::stopMjpeg()
+{
+	if (m_isMjpegClient)
+	{
+		HTTPServer* httpServer = (HTTPServer*)(&fOurServer);
+		httpServer->m_mjpegClients.remove(this);
+		m_isMjpegClient = false;
+	}
+}
+
+bool HTTPServer::HTTPClientConnection::sendFmp4M3u8PlayList(char const* urlSuffix)
+{
+	TSServerMediaSubsession* subsession = dynamic_cast<TSServerMediaSubsession*>(this->getSubsesion(urlSuffix));
+	if ( (subsession == NULL) || (subsession->getFmp4Sink() == NULL) )
+	{
+		return false;			  
+	}
+
+	FragmentedMP4Sink* fmp4Sink = subsession->getFmp4Sink();
+	std::map<unsigned int,double> fragments = fmp4Sink->getFragmentDurations();
+	if (fragments.empty()) 
+	{
+		return false;			  
+	}
+
+	HTTPServer* httpServer = (HTTPServer*)(&fOurServer);
+	unsigned int targetDuration = httpServer->m_hlsSegment;
+	for (std::map<unsigned int,double>::iterator it = fragments.begin(); it != fragments.end(); ++it)
+	{
+		targetDuration = std::max(targetDuration, (unsigned int)ceil(it->second));
+	}
+
+	std::ostringstream os;
+	os  	<< "#EXTM3U\r\n"
+		<< "#EXT-X-VERSION:7\r\n"
+		<< "#EXT-X-INDEPENDENT-SEGMENTS\r\n"
+		<< "#EXT-X-MEDIA-SEQUENCE:" << fragments.begin()->first <<  "\r\n"
+		<< "#EXT-X-DISCONTINUITY-SEQUENCE:" << fmp4Sink->getDiscontinuitySequence() <<  "\r\n"
+		<< "#EXT-X-TARGETDURATION:" << targetDuration << "\r\n";
+
+	// the init segment url changes with the parameter sets, fragments keep the one they were built with
+	unsigned int initVersion = 0;
+	os << std::fixed << std::setprecision(3);
+	for (std::map<unsigned int,double>::iterator it = fragments.begin(); it != fragments.end(); ++it)
+	{
+		unsigned int fragmentInitVersion = fmp4Sink->getFragmentInitVersion(it->first);
+		if (fragmentInitVersion != initVersion)
+		{
+			if (initVersion != 0)
+			{
+				os << "#EXT-X-DISCONTINUITY\r\n";
+			}
+			os << "#EXT-X-MAP:URI=\"" << urlSuffix << "?init=" << fragmentInitVersion << "\"\r\n";
+			initVersion = fragmentInitVersion;
+		}
+		os << "#EXTINF:" << it->second << ",\r\n";
+		os << urlSuffix << "?fragment=" << it->first << "\r\n";
+	}
+	
+	envir() << "send fMP4 M3u8 playlist:" << urlSuffix <<"\n";
+	const std::string& playList(os.str());
+
+	// send response header
+	this->sendHeader("application/vnd.apple.mpegurl", playList.size());
+	
+	// stream body
+	this->streamSource(playList);
+
+	return true;			  
+}
+
+bool HTTPServer::HTTPClientConnection::sendFmp4Segment(char const* urlSuffix, bool isInit, unsigned int index)
+{
+	TSServerMediaSubsession* subsession = dynamic_cast<TSServerMediaSubsession*>(this->getSubsesion(urlSuffix));
+	if ( (subsession == NULL) || (subsession->getFmp4Sink() == NULL) )
+	{
+		return false;			  
+	}
+
+	// index is the fragment id or the init segment version, 0 for the current one
+	FragmentedMP4Sink* fmp4Sink = subsession->getFmp4Sink();
+	SharedBuffer content;
+	if (!isInit)
+	{
+		content = fmp4Sink->getBuffer(index);
+	}
+	else
+	{
+		content = (index == 0) ? fmp4Sink->getInitSegment() : fmp4Sink->getInitSegment(index);
+	}
+	if (content.empty())
+	{
+		return false;
+	}
+
+	this->streamBuffer("video/mp4", content);
+
+	return true;
+}
+
+bool HTTPServer::HTTPClientConnection::sendFmp4MpdPlayList(char const* urlSuffix, FragmentedMP4Sink* fmp4Sink)
+{
+	std::map<unsigned int,double> fragments = fmp4Sink->getFragmentDurations();
+	if (fragments.empty()) 
+	{
+		return false;			  
+	}
+
+	double duration = 0;
+	u_int64_t size = 0;
+	for (std::map<unsigned int,double>::iterator it = fragments.begin(); it != fragments.end(); ++it)
+	{
+		duration += it->second;
+		size += fmp4Sink->getBufferSize(it->first);
+	}
+
+	char availabilityStartTime[32];
+	time_t startTime = fmp4Sink->getStartTime();
+	strftime(availabilityStartTime, sizeof(availabilityStartTime), "%Y-%m-%dT%H:%M:%SZ", gmtime(&startTime));
+
+	HTTPServer* httpServer = (HTTPServer*)(&fOurServer);
+	unsigned sliceDuration = httpServer->m_hlsSegment;		  
+	std::ostringstream os;
+	os  << "<?xml version='1.0' encoding='UTF-8'?>\r\n"
+		<< "<MPD type='dynamic' xmlns='urn:mpeg:dash:schema:mpd:2011' profiles='urn:mpeg:dash:profile:isoff-live:2011' availabilityStartTime='" << availabilityStartTime << "' minimumUpdatePeriod='PT"<< sliceDuration <<"S' minBufferTime='PT" << sliceDuration << "S'>\r\n";
+
+	// a period by init segment version, it starts at its first fragment
+	std::map<unsigned int,double>::iterator it = fragments.begin();
+	while (it != fragments.end())
+	{
+		unsigned int initVersion = fmp4Sink->getFragmentInitVersion(it->first);
+		u_int64_t periodTime = fmp4Sink->getDecodeTime(it->first);
+		os << std::fixed << std::setprecision(3);
+		os << "<Period id='" << initVersion << "' start='PT" << (double)periodTime / FragmentedMP4Sink::kTimescale << "S'><AdaptationSet mimeType='video/mp4' segmentAlignment='true' startWithSAP='1'>\r\n"
+			<< "<Representation id='video' codecs='" << fmp4Sink->getCodec(initVersion) << "' width='" << fmp4Sink->getWidth() << "' height='" << fmp4Sink->getHeight() << "' bandwidth='" << (u_int64_t)(size*8/duration) << "'>\r\n";
+
+		// fragments start on key frames, their durations are listed
+		os << "<SegmentTemplate timescale='" << FragmentedMP4Sink::kTimescale << "' presentationTimeOffset='" << periodTime << "' initialization='" << urlSuffix << "?init=" << initVersion << "' media='" << urlSuffix << "?fragment=$Number$' startNumber='" << it->first << "'>\r\n";
+		os << "<SegmentTimeline>\r\n";
+		for (; (it != fragments.end()) && (fmp4Sink->getFragmentInitVersion(it->first) == initVersion); ++it)
+		{
+			os << "<S t='" << fmp4Sink->getDecodeTime(it->first) << "' d='" << (u_int64_t)(it->second*FragmentedMP4Sink::kTimescale + 0.5) << "'/>\r\n";
+		}
+		os << "</SegmentTimeline></SegmentTemplate>\r\n";
+		os << "</Representation></AdaptationSet></Period>\r\n";
+	}
+	os << "</MPD>\r\n";
+
+	envir() << "send fMP4 MPEG-DASH playlist:" << urlSuffix <<"\n";
+	const std::string& playList(os.str());
+
+	// send response header
+	this->sendHeader("application/dash+xml", playList.size());
+	
+	// stream body
+	this->streamSource(playList);
+
+	return true;
+}
+
 bool HTTPServer::HTTPClientConnection::sendMpdPlayList(char const* urlSuffix)
 {
-	ServerMediaSubsession* subsession = this->getSubsesion(urlSuffix);
+	TSServerMediaSubsession* subsession = dynamic_cast<TSServerMediaSubsession*>(this->getSubsesion(urlSuffix));
 	if (subsession == NULL) 
 	{
 		return false;			  
 	}
 
-	float duration = subsession->duration();
+	// DASH players expect fMP4, MPEG-TS is kept for other formats
+	if (subsession->getFmp4Sink() != NULL)
+	{
+		return this->sendFmp4MpdPlayList(urlSuffix, subsession->getFmp4Sink());
+	}
+
+	double duration = subsession->getHlsSink()->duration();
 	if (duration <= 0.0) 
 	{
 		return false;
 	}
 	
-	unsigned int startTime = subsession->getCurrentNPT(NULL);
+	// segment numbers are slice ids
+	unsigned int startTime = subsession->getHlsSink()->firstSlice();
 	HTTPServer* httpServer = (HTTPServer*)(&fOurServer);
 	unsigned sliceDuration = httpServer->m_hlsSegment;		  
 	std::ostringstream os;
@@ -243,6 +886,11 @@ void HTTPServer::HTTPClientConnection::handleHTTPCmd_StreamingGET(char const* ur
 	}
 	else if (strncmp(urlSuffix, "getSnapshot", strlen("getSnapshot")) == 0) 
 	{
+		this->handleSnapshot(questionMarkPos, fullRequestStr);
+	}
+	else if (strncmp(urlSuffix, "getMjpeg", strlen("getMjpeg")) == 0) 
+	{
+		this->startMjpeg();
 	}
 	else if (strncmp(urlSuffix, "getStreamList", strlen("getStreamList")) == 0) 
 	{
@@ -293,6 +941,12 @@ void HTTPServer::HTTPClientConnection::handleHTTPCmd_StreamingGET(char const* ur
 			// MPEG-DASH Playlist
 			ok = this->sendMpdPlayList(streamName.c_str());				
 		}
+		else if ( (streamName.size() > strlen(".fmp4")) && (streamName.compare(streamName.size() - strlen(".fmp4"), std::string::npos, ".fmp4") == 0) )
+		{
+			// HLS Playlist with fMP4 segments
+			streamName.erase(streamName.size() - strlen(".fmp4"));
+			ok = this->sendFmp4M3u8PlayList(streamName.c_str());
+		}
 		else
 		{
 			// HLS Playlist
@@ -311,66 +965,79 @@ void HTTPServer::HTTPClientConnection::handleHTTPCmd_StreamingGET(char const* ur
 			fIsActive = False;
 		}
 	}
-	else
+	else if (strncmp(questionMarkPos, "?_HLS_msn=", strlen("?_HLS_msn=")) == 0)
 	{
-		unsigned offsetInSeconds;
-		if (sscanf(questionMarkPos, "?segment=%u", &offsetInSeconds) != 1)
+		// LL-HLS blocking playlist reload
+		unsigned int slice = 0;
+		unsigned int part = 0;
+		int nbValues = sscanf(questionMarkPos, "?_HLS_msn=%u&_HLS_part=%u", &slice, &part);
+
+		std::string streamName(urlSuffix, questionMarkPos-urlSuffix);
+		size_t pos = streamName.find_last_of(".");
+		if (pos != std::string::npos)
+		{
+			streamName.erase(pos);
+		}
+		if ( (streamName.size() > strlen(".fmp4")) && (streamName.compare(streamName.size() - strlen(".fmp4"), std::string::npos, ".fmp4") == 0) )
+		{
+			// the fMP4 playlist is not low latency, it is answered without blocking
+			streamName.erase(streamName.size() - strlen(".fmp4"));
+			if (!this->sendFmp4M3u8PlayList(streamName.c_str()))
+			{
+				handleHTTPCmd_notSupported();
+				fIsActive = False;
+			}
+		}
+		else if (!this->waitHlsRequest(streamName.c_str(), slice, (nbValues == 2) ? (int)part : -1, false))
 		{
 			handleHTTPCmd_notSupported();
-			return;			  
+			fIsActive = False;
 		}
-		
+	}
+	else if ( (strncmp(questionMarkPos, "?init", strlen("?init")) == 0) || (strncmp(questionMarkPos, "?fragment=", strlen("?fragment=")) == 0) )
+	{
+		// fMP4 init segment by version or fragment
+		unsigned int index = 0;
+		bool isInit = (sscanf(questionMarkPos, "?fragment=%u", &index) != 1);
 		std::string streamName(urlSuffix, questionMarkPos-urlSuffix);
-		ServerMediaSubsession* subsession = this->getSubsesion(streamName.c_str());
-		if (subsession == NULL) 
+		if (isInit)
+		{
+			sscanf(questionMarkPos, "?init=%u", &index);
+		}
+		if (!this->sendFmp4Segment(streamName.c_str(), isInit, index))
 		{
 			handleHTTPCmd_notSupported();
 			fIsActive = False;
+		}
+	}
+	else
+	{
+		unsigned slice;
+		unsigned part;
+		int nbValues = sscanf(questionMarkPos, "?segment=%u&part=%u", &slice, &part);
+		if (nbValues < 1)
+		{
+			handleHTTPCmd_notSupported();
 			return;			  
 		}
+		
+		std::string streamName(urlSuffix, questionMarkPos-urlSuffix);
+		if (nbValues == 2)
+		{
+			// LL-HLS part, the preload hint one is not yet available
+			if (!this->waitHlsRequest(streamName.c_str(), slice, part, true))
+			{
+				handleHTTPCmd_notSupported();
+				fIsActive = False;
+			}
+			return;
+		}
 
-		// Call "getStreamParameters()" to create the stream's source.  (Because we're not actually streaming via RTP/RTCP, most
-		// of the parameters to the call are dummy.)
-		++m_ClientSessionId;
-		Port clientRTPPort(0), clientRTCPPort(0), serverRTPPort(0), serverRTCPPort(0);
-		u_int8_t destinationTTL = 0;
-		Boolean isMulticast = False;
-#if LIVEMEDIA_LIBRARY_VERSION_INT < 1606953600		
-		netAddressBits clientAddress = 0;
-		netAddressBits destinationAddress = 0;
-#else
-		sockaddr_storage clientAddress = { 0 };
-		sockaddr_storage destinationAddress = { 0 };
-#endif		
-#if LIVEMEDIA_LIBRARY_VERSION_INT < 1636848000		
-		subsession->getStreamParameters(m_ClientSessionId, clientAddress, clientRTPPort, clientRTCPPort, -1, 0, 0, destinationAddress, destinationTTL, isMulticast, serverRTPPort, serverRTCPPort, m_StreamToken);
-#else
-
-		subsession->getStreamParameters(m_ClientSessionId, clientAddress, clientRTPPort, clientRTCPPort, -1, 0, 0, NULL, destinationAddress, destinationTTL, isMulticast, serverRTPPort, serverRTCPPort, m_StreamToken);
-#endif		
-
-		// Seek the stream source to the desired place, with the desired duration, and (as a side effect) get the number of bytes:
-		double dOffsetInSeconds = (double)offsetInSeconds;
-		u_int64_t numBytes = 0;
-		subsession->seekStream(m_ClientSessionId, m_StreamToken, dOffsetInSeconds, 0.0, numBytes);
-
-		if (numBytes == 0) 
+		if (!this->sendSlice(streamName.c_str(), slice))
 		{
-			// For some reason, we do not know the size of the requested range.  We can't handle this request:
 			handleHTTPCmd_notSupported();
 			fIsActive = False;
 		}
-		else
-		{
-			// send response header
-			this->sendHeader("video/mp2t", numBytes);
-
-			// stream body
-			this->streamSource(subsession->getStreamSource(m_StreamToken));
-			
-			// pointer to subsession to close it
-			m_Subsession = subsession;
-		}
 	} 
 }
 
@@ -407,9 +1074,75 @@ void HTTPServer::HTTPClientConnection::afterStreaming(void* clientData)
 
 HTTPServer::HTTPClientConnection::~HTTPClientConnection() 
 {
+	this->stopWaitingHlsRequest();
+	this->stopWaitingSnapshot();
+	this->stopMjpeg();
 	this->streamSource(NULL);
-	
-	if (m_Subsession) {
-		m_Subsession->deleteStream(m_ClientSessionId,  m_StreamToken);
+}
+
+void HTTPServer::initSnapshot()
+{
+	// ETags stay unique when the server restarts
+	m_snapshotEpoch = time(NULL);
+
+	// JPEGs are encoded by the camera thread, waiters are answered from the event loop
+	m_jpegTrigger = envir().taskScheduler().createEventTrigger(onJpegStub);
+	TaskScheduler* scheduler = &envir().taskScheduler();
+	EventTriggerId trigger = m_jpegTrigger;
+	AnykaCameraManager::instance().setJpegListener([scheduler, trigger, this]() { scheduler->triggerEvent(trigger, this); });
+}
+
+HTTPServer::~HTTPServer()
+{
+	// returns once the camera thread is out of the listener, the trigger is no more used
+	AnykaCameraManager::instance().setJpegListener(nullptr);
+	envir().taskScheduler().deleteEventTrigger(m_jpegTrigger);
+	while (!m_snapshotWaiters.empty())
+	{
+		m_snapshotWaiters.front()->stopWaitingSnapshot();
+	}
+	while (!m_mjpegClients.empty())
+	{
+		m_mjpegClients.front()->stopMjpeg();
+	}
+}
+
+// copied once per JPEG, slow clients do not hold the encoder buffers
+SharedBuffer HTTPServer::getSnapshot(unsigned int & sequence)
+{
+	FrameRef frame = AnykaCameraManager::instance().getLastJpeg(&sequence);
+	if (!frame.isSet())
+	{
+		return SharedBuffer();
+	}
+	if ( (!m_snapshot) || (sequence != m_snapshotSequence) )
+	{
+		m_snapshot = std::make_shared<const std::string>(frame.getData(), frame.getDataSize());
+		m_snapshotSequence = sequence;
+	}
+	return SharedBuffer(m_snapshot, 0, m_snapshot->size());
+}
+
+std::string HTTPServer::getSnapshotEtag(unsigned int sequence)
+{
+	std::ostringstream os;
+	os << "\"" << m_snapshotEpoch << "-" << sequence << "\"";
+	return os.str();
+}
+
+void HTTPServer::onJpeg()
+{
+	// a waiter removes itself from the list when it is answered
+	std::list<HTTPClientConnection*> waiters(m_snapshotWaiters);
+	for (std::list<HTTPClientConnection*>::iterator it = waiters.begin(); it != waiters.end(); ++it)
+	{
+		(*it)->onSnapshot(false);
+	}
+
+	// the same buffer is sent to every MJPEG client, a client could be gone after its send
+	std::list<HTTPClientConnection*> mjpegClients(m_mjpegClients);
+	for (std::list<HTTPClientConnection*>::iterator it = mjpegClients.begin(); it != mjpegClients.end(); ++it)
+	{
+		(*it)->onMjpegFrame();
 	}
 }
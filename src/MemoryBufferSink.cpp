@@ -4,29 +4,43 @@
 ** any purpose.
 **
 ** MemoryBufferSink.cpp
-** 
+**
 ** -------------------------------------------------------------------------*/
 
+#include <algorithm>
+
 #include "MemoryBufferSink.h"
 
+const unsigned int kTsPacketSize      = 188;
+const unsigned char kTsSyncByte       = 0x47;
+const unsigned int kTsNullPid         = 0x1FFF;
+const unsigned int kStreamTypeH264    = 0x1B;
+const unsigned int kStreamTypeH265    = 0x24;
+const unsigned int kPtsClock          = 90000;
+const u_int64_t kPtsMask              = 0x1FFFFFFFFULL;
+
 // -----------------------------------------
 //    MemoryBufferSink
 // -----------------------------------------
-MemoryBufferSink::MemoryBufferSink(UsageEnvironment& env, unsigned bufferSize, unsigned int sliceDuration, unsigned int nbSlices) : MediaSink(env), m_bufferSize(bufferSize), m_refTime(0), m_sliceDuration(sliceDuration), m_nbSlices(nbSlices)
+MemoryBufferSink::MemoryBufferSink(UsageEnvironment& env, unsigned bufferSize, unsigned int sliceDuration, double partDuration, unsigned int nbSlices)
+	: MediaSink(env), m_bufferSize(bufferSize), m_nextSliceId(0), m_removedDuration(0), m_sliceDuration(sliceDuration), m_partDuration(partDuration), m_nbSlices(nbSlices)
+	, m_keyFrameRequestHandler(NULL), m_keyFrameRequestClientData(NULL)
+	, m_pmtPid(kTsNullPid), m_videoPid(kTsNullPid), m_videoStreamType(0), m_sliceStartPts(0), m_isKeyFrameRequested(false)
+	, m_partStartPts(0), m_lastPts(0), m_frameDelta(0), m_isPartCompleted(false)
 {
 	m_buffer = new unsigned char[m_bufferSize];
 }
 
-MemoryBufferSink::~MemoryBufferSink() 
+MemoryBufferSink::~MemoryBufferSink()
 {
 	delete[] m_buffer;
 }
 
 
-Boolean MemoryBufferSink::continuePlaying() 
+Boolean MemoryBufferSink::continuePlaying()
 {
 	Boolean ret = False;
-	if (fSource != NULL) 
+	if (fSource != NULL)
 	{
 		fSource->getNextFrame(m_buffer, m_bufferSize,
 				afterGettingFrame, this,
@@ -37,9 +51,9 @@ Boolean MemoryBufferSink::continuePlaying()
 }
 
 
-void MemoryBufferSink::afterGettingFrame(unsigned frameSize, unsigned numTruncatedBytes, struct timeval presentationTime) 
+void MemoryBufferSink::afterGettingFrame(unsigned frameSize, unsigned numTruncatedBytes, struct timeval presentationTime)
 {
-	if (numTruncatedBytes > 0) 
+	if (numTruncatedBytes > 0)
 	{
 		envir() << "FileSink::afterGettingFrame(): The input frame data was too large for our buffer size \n";
 		// realloc a bigger buffer
@@ -48,65 +62,354 @@ void MemoryBufferSink::afterGettingFrame(unsigned frameSize, unsigned numTruncat
 		m_buffer = new unsigned char[m_bufferSize];
 	}
 	else
-	{			
-		// append buffer to slice buffer
-		if (m_refTime == 0)
+	{
+		// the TS framer delivers whole packets
+		for (unsigned int offset = 0; offset + kTsPacketSize <= frameSize; offset += kTsPacketSize)
+		{
+			this->processPacket(&m_buffer[offset]);
+		}
+	}
+
+	continuePlaying();
+}
+
+// append a TS packet to the current slice, start a new one on a key frame once slice duration is reached
+void MemoryBufferSink::processPacket(const unsigned char* packet)
+{
+	if (packet[0] == kTsSyncByte)
+	{
+		const unsigned int pid = ((packet[1] & 0x1F) << 8) | packet[2];
+		const bool isPayloadStart = (packet[1] & 0x40) != 0;
+		const unsigned int adaptationField = (packet[3] >> 4) & 0x3;
+		unsigned int payloadOffset = 4;
+		if (adaptationField & 0x2)
 		{
-			m_refTime = presentationTime.tv_sec;
+			payloadOffset += 1 + packet[4];
 		}
-		unsigned int slice = (presentationTime.tv_sec-m_refTime)/m_sliceDuration;
-		std::string& outputBuffer = m_outputBuffers[slice];
-		outputBuffer.append((const char*)m_buffer, frameSize);
-		
-		// remove old buffers
-		while (m_outputBuffers.size()>m_nbSlices)
+		const bool hasPayload = (adaptationField & 0x1) && (payloadOffset < kTsPacketSize);
+		const unsigned char* payload = &packet[payloadOffset];
+		const unsigned int payloadSize = kTsPacketSize - payloadOffset;
+
+		if (isPayloadStart && hasPayload)
 		{
-			m_outputBuffers.erase(m_outputBuffers.begin());
+			if (pid == 0)
+			{
+				this->parsePat(payload, payloadSize);
+				m_pat.assign((const char*)packet, kTsPacketSize);
+			}
+			else if (pid == m_pmtPid)
+			{
+				this->parsePmt(payload, payloadSize);
+				m_pmt.assign((const char*)packet, kTsPacketSize);
+			}
+			else if ( (payloadSize >= 14) && (payload[0] == 0) && (payload[1] == 0) && (payload[2] == 1) && (payload[7] & 0x80) )
+			{
+				// PES header with PTS, slices are cut on video when there is one
+				const bool hasVideo = (m_videoPid != kTsNullPid);
+				if (!hasVideo || (pid == m_videoPid))
+				{
+					const u_int64_t pts = ((u_int64_t)(payload[9] & 0x0E) << 29) | ((u_int64_t)payload[10] << 22) | ((u_int64_t)(payload[11] & 0xFE) << 14) | ((u_int64_t)payload[12] << 7) | (payload[13] >> 1);
+					const bool isRandomAccess = !hasVideo || this->isRandomAccess(payload, payloadSize);
+					if (m_outputBuffers.empty())
+					{
+						// data before the first key frame could not be decoded
+						if (isRandomAccess)
+						{
+							this->startSlice(pts);
+						}
+					}
+					else
+					{
+						const u_int64_t elapsed = (pts - m_sliceStartPts) & kPtsMask;
+						// NALs of the same frame share their PTS and stay together
+						const u_int64_t partElapsed = (pts - m_partStartPts) & kPtsMask;
+						if ( (elapsed >= (u_int64_t)m_sliceDuration * kPtsClock) && isRandomAccess )
+						{
+							this->endPart(pts);
+							m_outputBuffers.rbegin()->second.m_duration = (double)elapsed / kPtsClock;
+							this->startSlice(pts);
+						}
+						else if ( (m_partDuration > 0) && (partElapsed > 0) && (partElapsed + m_frameDelta > m_partDuration * kPtsClock) )
+						{
+							// next frame would make the part longer than its duration
+							this->endPart(pts);
+							this->startPart(pts, isRandomAccess);
+						}
+
+						if ( (elapsed >= (u_int64_t)m_sliceDuration * kPtsClock) && !isRandomAccess && !m_isKeyFrameRequested )
+						{
+							// GOP longer than the slice duration
+							m_isKeyFrameRequested = true;
+							if (m_keyFrameRequestHandler != NULL)
+							{
+								m_keyFrameRequestHandler(m_keyFrameRequestClientData);
+							}
+						}
+					}
+
+					if (pts != m_lastPts)
+					{
+						m_frameDelta = (pts - m_lastPts) & kPtsMask;
+						m_lastPts = pts;
+					}
+				}
+			}
 		}
 	}
 
-	continuePlaying();
+	if (!m_outputBuffers.empty())
+	{
+		m_outputBuffers.rbegin()->second.m_buffer->append((const char*)packet, kTsPacketSize);
+	}
+
+	// listeners see the part once the slices are updated
+	if (m_isPartCompleted)
+	{
+		m_isPartCompleted = false;
+		std::list< std::pair<TaskFunc*,void*> > listeners(m_partListeners);
+		for (std::list< std::pair<TaskFunc*,void*> >::iterator it = listeners.begin(); it != listeners.end(); ++it)
+		{
+			it->first(it->second);
+		}
+	}
+}
+
+void MemoryBufferSink::startSlice(u_int64_t pts)
+{
+	// each slice can be decoded on its own
+	Slice& slice = m_outputBuffers[m_nextSliceId++];
+	this->startPart(pts, true);
+	slice.m_buffer->assign(m_pat);
+	slice.m_buffer->append(m_pmt);
+	m_sliceStartPts = pts;
+	m_isKeyFrameRequested = false;
+
+	// remove old buffers
+	while (m_outputBuffers.size()>m_nbSlices)
+	{
+		m_removedDuration += m_outputBuffers.begin()->second.m_duration;
+		m_outputBuffers.erase(m_outputBuffers.begin());
+	}
+}
+
+void MemoryBufferSink::startPart(u_int64_t pts, bool isIndependent)
+{
+	Slice& slice = m_outputBuffers.rbegin()->second;
+	Part part = { (unsigned int)slice.m_buffer->size(), 0, isIndependent };
+	slice.m_parts.push_back(part);
+	m_partStartPts = pts;
+}
+
+void MemoryBufferSink::endPart(u_int64_t pts)
+{
+	Slice& slice = m_outputBuffers.rbegin()->second;
+	if (!slice.m_parts.empty())
+	{
+		slice.m_parts.back().m_duration = (double)((pts - m_partStartPts) & kPtsMask) / kPtsClock;
+		m_isPartCompleted = true;
+	}
+}
+
+// get PMT PID of the first program
+void MemoryBufferSink::parsePat(const unsigned char* payload, unsigned int size)
+{
+	const unsigned int pointer = payload[0];
+	if (1 + pointer + 8 > size)
+	{
+		return;
+	}
+	const unsigned char* section = &payload[1 + pointer];
+	const unsigned int sectionEnd = std::min(3u + (((section[1] & 0x0F) << 8) | section[2]), size - 1 - pointer);
+	// programs end before the CRC
+	for (unsigned int i = 8; i + 4 + 4 <= sectionEnd; i += 4)
+	{
+		const unsigned int programNumber = (section[i] << 8) | section[i+1];
+		if (programNumber != 0)
+		{
+			m_pmtPid = ((section[i+2] & 0x1F) << 8) | section[i+3];
+			break;
+		}
+	}
+}
+
+// get video PID and stream type
+void MemoryBufferSink::parsePmt(const unsigned char* payload, unsigned int size)
+{
+	const unsigned int pointer = payload[0];
+	if (1 + pointer + 12 > size)
+	{
+		return;
+	}
+	const unsigned char* section = &payload[1 + pointer];
+	const unsigned int sectionEnd = std::min(3u + (((section[1] & 0x0F) << 8) | section[2]), size - 1 - pointer);
+	const unsigned int programInfoLength = ((section[10] & 0x0F) << 8) | section[11];
+	for (unsigned int i = 12 + programInfoLength; i + 5 + 4 <= sectionEnd; )
+	{
+		const unsigned int streamType = section[i];
+		const unsigned int pid = ((section[i+1] & 0x1F) << 8) | section[i+2];
+		if ( (streamType == kStreamTypeH264) || (streamType == kStreamTypeH265) )
+		{
+			m_videoPid = pid;
+			m_videoStreamType = streamType;
+			break;
+		}
+		i += 5 + (((section[i+3] & 0x0F) << 8) | section[i+4]);
+	}
+}
+
+// look for IDR or parameter sets in the beginning of a video PES
+bool MemoryBufferSink::isRandomAccess(const unsigned char* payload, unsigned int size)
+{
+	for (unsigned int i = 9 + payload[8]; i + 3 < size; ++i)
+	{
+		if ( (payload[i] == 0) && (payload[i+1] == 0) && (payload[i+2] == 1) )
+		{
+			const unsigned char header = payload[i+3];
+			if (m_videoStreamType == kStreamTypeH264)
+			{
+				const unsigned int nalType = header & 0x1F;
+				if ( (nalType == 5) || (nalType == 7) )
+				{
+					return true;
+				}
+			}
+			else
+			{
+				const unsigned int nalType = (header >> 1) & 0x3F;
+				if ( ((nalType >= 16) && (nalType <= 21)) || (nalType == 32) || (nalType == 33) )
+				{
+					return true;
+				}
+			}
+			i += 2;
+		}
+	}
+	return false;
 }
 
 unsigned int MemoryBufferSink::getBufferSize(unsigned int slice)
 {
 	unsigned int size = 0;
-	std::map<unsigned int,std::string>::iterator it = m_outputBuffers.find(slice);
-	if (it != m_outputBuffers.end())
+	std::map<unsigned int,Slice>::iterator it = m_outputBuffers.find(slice);
+	if ( (it != m_outputBuffers.end()) && (slice != m_outputBuffers.rbegin()->first) )
 	{
-		size = it->second.size();
+		size = it->second.m_buffer->size();
 	}
 	return size;
 }
 
-std::string MemoryBufferSink::getBuffer(unsigned int slice)
+SharedBuffer MemoryBufferSink::getBuffer(unsigned int slice)
 {
-	std::string content;
-	std::map<unsigned int,std::string>::iterator it = m_outputBuffers.find(slice);
-	if (it != m_outputBuffers.end())
+	SharedBuffer content;
+	std::map<unsigned int,Slice>::iterator it = m_outputBuffers.find(slice);
+	if ( (it != m_outputBuffers.end()) && (slice != m_outputBuffers.rbegin()->first) )
 	{
-		content = it->second;
-
+		content = SharedBuffer(it->second.m_buffer, 0, it->second.m_buffer->size());
 	}
 	return content;
 }
 
-unsigned int MemoryBufferSink::firstTime()
+unsigned int MemoryBufferSink::firstSlice()
+{
+	unsigned int firstSlice = m_nextSliceId;
+	if (m_outputBuffers.size() != 0)
+	{
+		firstSlice = m_outputBuffers.begin()->first;
+	}
+	return firstSlice;
+}
+
+std::map<unsigned int,double> MemoryBufferSink::getSliceDurations()
+{
+	std::map<unsigned int,double> durations;
+	if (m_outputBuffers.size() != 0)
+	{
+		std::map<unsigned int,Slice>::iterator last = --m_outputBuffers.end();
+		for (std::map<unsigned int,Slice>::iterator it = m_outputBuffers.begin(); it != last; ++it)
+		{
+			durations[it->first] = it->second.m_duration;
+		}
+	}
+	return durations;
+}
+
+double MemoryBufferSink::firstTime()
+{
+	return m_removedDuration;
+}
+
+double MemoryBufferSink::duration()
+{
+	double duration = 0;
+	std::map<unsigned int,double> durations = this->getSliceDurations();
+	for (std::map<unsigned int,double>::iterator it = durations.begin(); it != durations.end(); ++it)
+	{
+		duration += it->second;
+	}
+	return duration;
+}
+
+unsigned int MemoryBufferSink::lastSlice()
+{
+	unsigned int lastSlice = m_nextSliceId;
+	if (m_outputBuffers.size() != 0)
+	{
+		lastSlice = m_outputBuffers.rbegin()->first;
+	}
+	return lastSlice;
+}
+
+std::vector<MemoryBufferSink::Part> MemoryBufferSink::getParts(unsigned int slice)
 {
-	unsigned int firstTime = 0;
-	if (m_outputBuffers.size() != 0)				
+	std::vector<Part> parts;
+	std::map<unsigned int,Slice>::iterator it = m_outputBuffers.find(slice);
+	if (it != m_outputBuffers.end())
 	{
-		firstTime = m_outputBuffers.begin()->first;
+		parts = it->second.m_parts;
+		// last part of the slice being filled is not complete
+		if ( (slice == m_outputBuffers.rbegin()->first) && !parts.empty() )
+		{
+			parts.pop_back();
+		}
 	}
-	return firstTime*m_sliceDuration;
+	return parts;
 }
 
-unsigned int MemoryBufferSink::duration()
+SharedBuffer MemoryBufferSink::getPart(unsigned int slice, unsigned int part)
 {
-	unsigned int duration = 0;
-	if (m_outputBuffers.size() != 0)				
+	SharedBuffer content;
+	std::map<unsigned int,Slice>::iterator it = m_outputBuffers.find(slice);
+	if ( (it != m_outputBuffers.end()) && this->isPartAvailable(slice, part) && (part < it->second.m_parts.size()) )
 	{
-		duration = m_outputBuffers.rbegin()->first - m_outputBuffers.begin()->first;
+		const std::vector<Part>& parts = it->second.m_parts;
+		const unsigned int end = (part + 1 < parts.size()) ? parts[part+1].m_offset : it->second.m_buffer->size();
+		content = SharedBuffer(it->second.m_buffer, parts[part].m_offset, end - parts[part].m_offset);
 	}
-	return (duration)*m_sliceDuration;
+	return content;
+}
+
+// slice is complete or already removed
+bool MemoryBufferSink::isSliceAvailable(unsigned int slice)
+{
+	return !m_outputBuffers.empty() && (slice < m_outputBuffers.rbegin()->first);
+}
+
+bool MemoryBufferSink::isPartAvailable(unsigned int slice, unsigned int part)
+{
+	bool isAvailable = this->isSliceAvailable(slice);
+	if (!isAvailable && !m_outputBuffers.empty() && (slice == m_outputBuffers.rbegin()->first))
+	{
+		isAvailable = (part + 1 < m_outputBuffers.rbegin()->second.m_parts.size());
+	}
+	return isAvailable;
+}
+
+void MemoryBufferSink::addPartListener(TaskFunc* handler, void* clientData)
+{
+	m_partListeners.push_back(std::pair<TaskFunc*,void*>(handler, clientData));
+}
+
+void MemoryBufferSink::removePartListener(TaskFunc* handler, void* clientData)
+{
+	m_partListeners.remove(std::pair<TaskFunc*,void*>(handler, clientData));
 }
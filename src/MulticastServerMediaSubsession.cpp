@@ -8,6 +8,7 @@
 ** -------------------------------------------------------------------------*/
 
 #include "MulticastServerMediaSubsession.h"
+#include "ReceiverReportMonitor.h"
 
 // -----------------------------------------
 //    ServerMediaSubsession for Multicast
@@ -29,7 +30,7 @@ RTPSink* MulticastServerMediaSubsession::createRtpSink(UsageEnvironment& env
 						, StreamReplicator* replicator) {
 	// Create a source
 	FramedSource* source = replicator->createStreamReplica();			
-	FramedSource* videoSource = createSource(env, source, m_format);
+	FramedSource* videoSource = createSource(env, source, m_format, dynamic_cast<V4L2DeviceSource*>(replicator->inputSource()));
 
 	// Create RTP/RTCP groupsock
 #if LIVEMEDIA_LIBRARY_VERSION_INT	<	1607644800
@@ -52,6 +53,12 @@ RTPSink* MulticastServerMediaSubsession::createRtpSink(UsageEnvironment& env
 	Groupsock* rtcpGroupsock = new Groupsock(env, groupAddress, rtcpPortNum, ttl);
 	m_rtcpInstance = RTCPInstance::createNew(env, rtcpGroupsock,  500, CNAME, m_rtpSink, NULL);
 
+	// Receiver reports of all group members drive the device bitrate
+	V4L2DeviceSource* deviceSource = dynamic_cast<V4L2DeviceSource*>(replicator->inputSource());
+	if (deviceSource && deviceSource->getReceiverReportMonitor()) {
+		deviceSource->getReceiverReportMonitor()->addSink(m_rtpSink);
+	}
+
 	// Start Playing the Sink
 	m_rtpSink->startPlaying(*videoSource, NULL, NULL);							
 
@@ -60,7 +67,8 @@ RTPSink* MulticastServerMediaSubsession::createRtpSink(UsageEnvironment& env
 
 char const* MulticastServerMediaSubsession::sdpLines() 
 {
-	if (m_SDPLines.empty())
+	const bool isAuxLineChanged = this->isAuxLineChanged();
+	if (m_SDPLines.empty() || isAuxLineChanged)
 	{
 		// Ugly workaround to give SPS/PPS that are get from the RTPSink
 #if LIVEMEDIA_LIBRARY_VERSION_INT < 1610928000
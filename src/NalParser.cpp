@@ -0,0 +1,107 @@
+/* ---------------------------------------------------------------------------
+** This software is in the public domain, furnished "as is", without technical
+** support, and with no warranty, express or implied, as to its usefulness for
+** any purpose.
+**
+** NalParser.cpp
+** 
+** -------------------------------------------------------------------------*/
+
+#include <string.h>
+#include <stdint.h>
+
+#include "NalParser.h"
+
+const unsigned int kStartCodeLength = 4;
+const unsigned int kShortStartCodeLength = 3;
+
+// ---------------------------------
+// find next 00 00 01 in [p, end), return end when not found
+// ---------------------------------
+const unsigned char* NalParser::findStartCode(const unsigned char* p, const unsigned char* end)
+{
+	if (end - p < 3)
+	{
+		return end;
+	}
+	const unsigned char* const last = end - 3;
+
+	// byte by byte up to word alignment
+	const unsigned char* aligned = p + ((4 - ((uintptr_t)p & 3)) & 3);
+	for (; (p < aligned) && (p <= last); ++p)
+	{
+		if ((p[0] == 0) && (p[1] == 0) && (p[2] == 1))
+		{
+			return p;
+		}
+	}
+
+	// word at a time, only words holding a zero byte are looked at, a start code
+	// has a zero in its first or second byte so checking bytes 1 and 3 is enough
+	for (; p + 6 <= end; p += 4)
+	{
+		uint32_t word;
+		memcpy(&word, __builtin_assume_aligned(p, 4), sizeof(word));
+		if (((word - 0x01010101) & ~word & 0x80808080) == 0)
+		{
+			continue;
+		}
+		if (p[1] == 0)
+		{
+			if ((p[0] == 0) && (p[2] == 1)) return p;
+			if ((p[2] == 0) && (p[3] == 1)) return p+1;
+		}
+		if (p[3] == 0)
+		{
+			if ((p[2] == 0) && (p[4] == 1)) return p+2;
+			if ((p[4] == 0) && (p[5] == 1)) return p+3;
+		}
+	}
+
+	// tail
+	for (; p <= last; ++p)
+	{
+		if ((p[0] == 0) && (p[1] == 0) && (p[2] == 1))
+		{
+			return p;
+		}
+	}
+	return end;
+}
+
+// extract a NAL
+unsigned char* NalParser::extractNal(unsigned char* frame, size_t& size, size_t& outsize, int& frameType, bool keepMarker)
+{
+	unsigned char * outFrame = NULL;
+	outsize = 0;
+	frameType = 0;
+
+	unsigned char* const end = frame + size;
+	unsigned char* startFrame = (unsigned char*)findStartCode(frame, end);
+	if (startFrame != end) {
+		// 4 bytes start code or 3 bytes one
+		unsigned int markerlength = kShortStartCodeLength;
+		if ( (startFrame > frame) && (startFrame[-1] == 0) ) {
+			--startFrame;
+			markerlength = kStartCodeLength;
+		}
+		unsigned char* payload = &startFrame[markerlength];
+		if (payload < end) {
+			frameType = payload[0];
+		}
+
+		// zero bytes before next start code do not belong to this NAL
+		unsigned char* endFrame = (unsigned char*)findStartCode(payload, end);
+		if (endFrame != end) {
+			while ( (endFrame > payload) && (endFrame[-1] == 0) ) {
+				--endFrame;
+			}
+		}
+
+		outFrame = keepMarker ? startFrame : payload;
+		outsize = endFrame - outFrame;
+		size = end - endFrame;
+	}
+
+	return outFrame;
+}
@@ -0,0 +1,91 @@
+/* ---------------------------------------------------------------------------
+** This software is in the public domain, furnished "as is", without technical
+** support, and with no warranty, express or implied, as to its usefulness for
+** any purpose.
+**
+** ReceiverReportMonitor.cpp
+**
+** -------------------------------------------------------------------------*/
+
+#include <sys/time.h>
+#include <algorithm>
+
+#include "ReceiverReportMonitor.h"
+#include "logger.h"
+
+// clients send receiver reports every few seconds
+const unsigned kCheckIntervalUs = 1000000;
+
+ReceiverReportMonitor::ReceiverReportMonitor(UsageEnvironment& env, DeviceInterface* device)
+	: m_env(env), m_device(device), m_checkTask(NULL)
+{
+	gettimeofday(&m_lastCheckTime, NULL);
+}
+
+ReceiverReportMonitor::~ReceiverReportMonitor()
+{
+	m_env.taskScheduler().unscheduleDelayedTask(m_checkTask);
+}
+
+void ReceiverReportMonitor::addSink(RTPSink* sink)
+{
+	if ( (sink != NULL) && (std::find(m_sinks.begin(), m_sinks.end(), sink) == m_sinks.end()) )
+	{
+		m_sinks.push_back(sink);
+		if (m_checkTask == NULL)
+		{
+			gettimeofday(&m_lastCheckTime, NULL);
+			m_checkTask = m_env.taskScheduler().scheduleDelayedTask(kCheckIntervalUs, ReceiverReportMonitor::checkReportsStub, this);
+		}
+	}
+}
+
+void ReceiverReportMonitor::removeSink(RTPSink* sink)
+{
+	m_sinks.remove(sink);
+	if (m_sinks.empty())
+	{
+		m_env.taskScheduler().unscheduleDelayedTask(m_checkTask);
+	}
+}
+
+void ReceiverReportMonitor::checkReports()
+{
+	struct timeval now;
+	gettimeofday(&now, NULL);
+
+	// only reports received since last check, a client that stopped reporting is not taken into account
+	bool hasReports = false;
+	int lossPercent = 0;
+	int jitterMs = 0;
+	for (std::list<RTPSink*>::iterator sinkIt = m_sinks.begin(); sinkIt != m_sinks.end(); ++sinkIt)
+	{
+		RTPSink* sink = *sinkIt;
+		unsigned frequency = sink->rtpTimestampFrequency();
+		RTPTransmissionStatsDB::Iterator statsIt(sink->transmissionStatsDB());
+		RTPTransmissionStats* stats = NULL;
+		while ( (stats = statsIt.next()) != NULL )
+		{
+			const struct timeval& received = stats->lastTimeReceived();
+			if (timercmp(&received, &m_lastCheckTime, >))
+			{
+				hasReports = true;
+				// fraction lost is in 1/256 units, jitter in timestamp units
+				lossPercent = std::max(lossPercent, (int)(stats->packetLossRatio() * 100 / 256));
+				if (frequency > 0)
+				{
+					jitterMs = std::max(jitterMs, (int)((unsigned long long)stats->jitter() * 1000 / frequency));
+				}
+			}
+		}
+	}
+	m_lastCheckTime = now;
+
+	if (hasReports)
+	{
+		LOG(DEBUG) << "Receiver reports sinks:" << m_sinks.size() << " loss:" << lossPercent << "% jitter:" << jitterMs << "ms";
+		m_device->setReceiverStats(lossPercent, jitterMs);
+	}
+
+	m_checkTask = m_env.taskScheduler().scheduleDelayedTask(kCheckIntervalUs, ReceiverReportMonitor::checkReportsStub, this);
+}
@@ -39,7 +39,15 @@ const std::map<int, u_int8_t> kAacSamplingIndexes
 // ---------------------------------
 //   BaseServerMediaSubsession
 // ---------------------------------
-FramedSource* BaseServerMediaSubsession::createSource(UsageEnvironment& env, FramedSource* videoES, const std::string& format)
+u_int8_t BaseServerMediaSubsession::getAacSamplingIndex(int sampleRate)
+{
+	const auto it = kAacSamplingIndexes.find(sampleRate);
+	return it != kAacSamplingIndexes.end()
+		? it->second
+		: 11;
+}
+
+FramedSource* BaseServerMediaSubsession::createSource(UsageEnvironment& env, FramedSource* videoES, const std::string& format, const AccessUnitSource* accessUnitSource)
 {
 	FramedSource* source = NULL;
 	if (format == "video/MP2T")
@@ -48,12 +56,30 @@ FramedSource* BaseServerMediaSubsession::createSource(UsageEnvironment& env, Fra
 	}
 	else if (format == "video/H264")
 	{
-		source = H264VideoStreamDiscreteFramer::createNew(env, videoES);
+#if LIVEMEDIA_LIBRARY_VERSION_INT >= 1596931200
+		if (accessUnitSource)
+		{
+			source = AccessUnitFramer<H264VideoStreamDiscreteFramer>::createNew(env, videoES, accessUnitSource);
+		}
+		else
+#endif
+		{
+			source = H264VideoStreamDiscreteFramer::createNew(env, videoES);
+		}
 	}
 #if LIVEMEDIA_LIBRARY_VERSION_INT > 1414454400
 	else if (format == "video/H265")
 	{
-		source = H265VideoStreamDiscreteFramer::createNew(env, videoES);
+#if LIVEMEDIA_LIBRARY_VERSION_INT >= 1596931200
+		if (accessUnitSource)
+		{
+			source = AccessUnitFramer<H265VideoStreamDiscreteFramer>::createNew(env, videoES, accessUnitSource);
+		}
+		else
+#endif
+		{
+			source = H265VideoStreamDiscreteFramer::createNew(env, videoES);
+		}
 	}
 #endif
 	else if (format == "video/JPEG")
@@ -138,10 +164,7 @@ RTPSink*  BaseServerMediaSubsession::createSink(UsageEnvironment& env, Groupsock
 		else if (format.find("audio/AAC") == 0)
 		{
 			// Construct the 'AudioSpecificConfig', and from it, the corresponding ASCII string:
-			const auto it = kAacSamplingIndexes.find(sampleRate);
-			const u_int8_t samplingFrequencyIndex = it != kAacSamplingIndexes.end()
-				? it->second
-				: 11;
+			const u_int8_t samplingFrequencyIndex = BaseServerMediaSubsession::getAacSamplingIndex(sampleRate);
 
 			char configStr[5] = {0};
 			unsigned char audioSpecificConfig[2];
@@ -181,3 +204,48 @@ char const* BaseServerMediaSubsession::getAuxLine(V4L2DeviceSource* source, RTPS
 	return auxLine;
 }
 
+// -----------------------------------------
+//   parameter sets of the source changed since last call, SDP has to be rebuilt
+// -----------------------------------------
+bool BaseServerMediaSubsession::isAuxLineChanged()
+{
+	bool isChanged = false;
+	V4L2DeviceSource* source = dynamic_cast<V4L2DeviceSource*>(m_replicator->inputSource());
+	if (source) {
+		const unsigned int version = source->getAuxLineVersion();
+		isChanged = (version != m_auxLineVersion);
+		m_auxLineVersion = version;
+	}
+	return isChanged;
+}
+
+// -----------------------------------------
+//   ask device for key frame, so new client can start decoding without waiting for the next GOP
+// -----------------------------------------
+void BaseServerMediaSubsession::requestKeyFrame()
+{
+	V4L2DeviceSource* source = dynamic_cast<V4L2DeviceSource*>(m_replicator->inputSource());
+	if (source) {
+		source->getDevice()->requestKeyFrame();
+	}
+}
+
+GopCache* BaseServerMediaSubsession::getGopCache()
+{
+	GopCache* gopCache = NULL;
+	V4L2DeviceSource* source = dynamic_cast<V4L2DeviceSource*>(m_replicator->inputSource());
+	if (source) {
+		gopCache = source->getGopCache();
+	}
+	return gopCache;
+}
+
+ReceiverReportMonitor* BaseServerMediaSubsession::getReceiverReportMonitor()
+{
+	ReceiverReportMonitor* monitor = NULL;
+	V4L2DeviceSource* source = dynamic_cast<V4L2DeviceSource*>(m_replicator->inputSource());
+	if (source) {
+		monitor = source->getReceiverReportMonitor();
+	}
+	return monitor;
+}
@@ -7,11 +7,19 @@
 ** 
 ** -------------------------------------------------------------------------*/
 
+#include <algorithm>
+#include <iterator>
+
 #include "TSServerMediaSubsession.h"
 #include "AddH26xMarkerFilter.h"
+#include "AddADTSHeaderFilter.h"
+#include "SharedBufferSource.h"
+
+// low latency HLS part target in seconds
+const double kPartDuration = 0.5;
 
 TSServerMediaSubsession::TSServerMediaSubsession(UsageEnvironment& env, StreamReplicator* videoreplicator, StreamReplicator* audioreplicator, unsigned int sliceDuration) 
-		: UnicastServerMediaSubsession(env, videoreplicator), m_slice(0)
+		: UnicastServerMediaSubsession(env, videoreplicator), m_fmp4Sink(NULL)
 {
 	// Create a source
 	FramedSource* source = videoreplicator->createStreamReplica();
@@ -33,17 +41,51 @@ TSServerMediaSubsession::TSServerMediaSubsession(UsageEnvironment& env, StreamRe
 		// mux to TS		
 		muxer->addNewAudioSource(source, 1);
 	}
+
+	// audio shares the capture clock with video, presentation times are in sync
+	V4L2DeviceSource* audioSource = audioreplicator ? dynamic_cast<V4L2DeviceSource*>(audioreplicator->inputSource()) : NULL;
+	if (audioSource != NULL) {
+		DeviceInterface* audioDevice = audioSource->getDevice();
+		std::string audioFormat = BaseServerMediaSubsession::getAudioRtpFormat(audioDevice->getAudioFormat(), audioDevice->getSampleRate(), audioDevice->getChannels());
+		if (audioFormat.find("audio/AAC") == 0) {
+			// mux to TS with ADTS framing
+			FramedSource* filter = new AddADTSHeaderFilter(env, audioreplicator->createStreamReplica(), BaseServerMediaSubsession::getAacSamplingIndex(audioDevice->getSampleRate()), audioDevice->getChannels());
+			muxer->addNewAudioSource(filter, 4);
+		} else if (audioFormat.find("audio/MPEG") == 0) {
+			// mux to TS		
+			muxer->addNewAudioSource(audioreplicator->createStreamReplica(), 1);
+		} else {
+			LOG(WARN) << "HLS audio format not supported:" << audioFormat;
+		}
+	}
 	
 	FramedSource* tsSource = createSource(env, muxer, "video/MP2T");
 	
 	// Start Playing the HLS Sink
-	m_hlsSink = MemoryBufferSink::createNew(env, OutPacketBuffer::maxSize, sliceDuration);
+	m_hlsSink = MemoryBufferSink::createNew(env, OutPacketBuffer::maxSize, sliceDuration, kPartDuration);
+	m_hlsSink->setKeyFrameRequestHandler(onKeyFrameRequest, this);
 	m_hlsSink->startPlaying(*tsSource, NULL, NULL);			
+
+	// CMAF fragments for HLS and MPEG-DASH, muxed from the NALs
+	V4L2DeviceSource* deviceSource = dynamic_cast<V4L2DeviceSource*>(videoreplicator->inputSource());
+	if ( (deviceSource != NULL) && ((m_format == "video/H264") || (m_format == "video/H265")) ) {
+		DeviceInterface* device = deviceSource->getDevice();
+		m_fmp4Sink = FragmentedMP4Sink::createNew(env, m_format, std::max(device->getWidth(), 0), std::max(device->getHeight(), 0), OutPacketBuffer::maxSize, sliceDuration);
+		m_fmp4Sink->startPlaying(*videoreplicator->createStreamReplica(), NULL, NULL);
+	}
+}
+
+void TSServerMediaSubsession::onKeyFrameRequest(void* clientData)
+{
+	// slices start with a key frame, do not let them grow far over the slice duration
+	TSServerMediaSubsession* subsession = (TSServerMediaSubsession*)clientData;
+	subsession->requestKeyFrame();
 }
 
 TSServerMediaSubsession::~TSServerMediaSubsession()
 {
 	Medium::close(m_hlsSink);
+	Medium::close(m_fmp4Sink);
 }
 	
 float TSServerMediaSubsession::getCurrentNPT(void* streamToken)
@@ -56,24 +98,47 @@ float TSServerMediaSubsession::duration() const
 	return (m_hlsSink->duration()); 
 }
 
+// slices have different durations, the slice holding the NPT is found from their durations
+// each stream keeps its own slice, concurrent clients seek independently
 void TSServerMediaSubsession::seekStream(unsigned clientSessionId, void* streamToken, double& seekNPT, double streamDuration, u_int64_t& numBytes) 
 {
-	m_slice = seekNPT / m_hlsSink->getSliceDuration();
-	seekNPT = m_slice * m_hlsSink->getSliceDuration();
-	numBytes = m_hlsSink->getBufferSize(m_slice);
-	std::cout << "seek seekNPT:" << seekNPT << " slice:" << m_slice << " numBytes:" << numBytes << std::endl;	
+	unsigned int slice = m_hlsSink->firstSlice();
+	double sliceStart = m_hlsSink->firstTime();
+	std::map<unsigned int,double> durations = m_hlsSink->getSliceDurations();
+	for (std::map<unsigned int,double>::iterator it = durations.begin(); it != durations.end(); ++it)
+	{
+		slice = it->first;
+		if ( (seekNPT < sliceStart + it->second) || (std::next(it) == durations.end()) )
+		{
+			break;
+		}
+		sliceStart += it->second;
+	}
+	// the range sent back is the one served
+	seekNPT = sliceStart;
+	m_slices[streamToken] = slice;
+	numBytes = m_hlsSink->getBufferSize(slice);
+	LOG(DEBUG) << "seek seekNPT:" << seekNPT << " slice:" << slice << " numBytes:" << numBytes;
 }	
 
+void TSServerMediaSubsession::deleteStream(unsigned clientSessionId, void*& streamToken)
+{
+	m_slices.erase(streamToken);
+	UnicastServerMediaSubsession::deleteStream(clientSessionId, streamToken);
+}
+
 FramedSource* TSServerMediaSubsession::getStreamSource(void* streamToken) 
 {
 	FramedSource* source = NULL;
 	
-	std::string buffer = m_hlsSink->getBuffer(m_slice);
-	unsigned int size = buffer.size();
-	if ( size != 0 ) {
-		u_int8_t* content = new u_int8_t[size];
-		memcpy(content, buffer.c_str(), size);
-		source = ByteStreamMemoryBufferSource::createNew(envir(), content, size);			
+	std::map<void*,unsigned int>::iterator it = m_slices.find(streamToken);
+	if (it == m_slices.end()) {
+		return NULL;
+	}
+	// the slice stays referenced while it is streamed, even once removed from the sink
+	SharedBuffer buffer = m_hlsSink->getBuffer(it->second);
+	if ( !buffer.empty() ) {
+		source = SharedBufferSource::createNew(envir(), buffer);
 	}
 	return source;			
 }					
@@ -9,6 +9,8 @@
 
 
 #include "UnicastServerMediaSubsession.h"
+#include "GopCacheSource.h"
+#include "ReceiverReportMonitor.h"
 
 // -----------------------------------------
 //    ServerMediaSubsession for Unicast
@@ -22,7 +24,15 @@ FramedSource* UnicastServerMediaSubsession::createNewStreamSource(unsigned clien
 {
 	estBitrate = 500;
 	FramedSource* source = m_replicator->createStreamReplica();
-	return createSource(envir(), source, m_format);
+	V4L2DeviceSource* deviceSource = dynamic_cast<V4L2DeviceSource*>(m_replicator->inputSource());
+	const AccessUnitSource* accessUnitSource = deviceSource;
+	GopCache* gopCache = this->getGopCache();
+	if (gopCache) {
+		GopCacheSource* gopCacheSource = GopCacheSource::createNew(envir(), source, gopCache, deviceSource);
+		source = gopCacheSource;
+		accessUnitSource = gopCacheSource;
+	}
+	return createSource(envir(), source, m_format, accessUnitSource);
 }
 		
 RTPSink* UnicastServerMediaSubsession::createNewRTPSink(Groupsock* rtpGroupsock,  unsigned char rtpPayloadTypeIfDynamic, FramedSource* inputSource)
@@ -34,4 +44,45 @@ char const* UnicastServerMediaSubsession::getAuxSDPLine(RTPSink* rtpSink,FramedS
 {
 	return this->getAuxLine(dynamic_cast<V4L2DeviceSource*>(m_replicator->inputSource()), rtpSink);
 }
-		
+
+// SDP is built once by OnDemandServerMediaSubsession, drop it when parameter sets changed so next DESCRIBE is right
+#if LIVEMEDIA_LIBRARY_VERSION_INT < 1610928000
+char const* UnicastServerMediaSubsession::sdpLines()
+#else
+char const* UnicastServerMediaSubsession::sdpLines(int addressFamily)
+#endif
+{
+	if (this->isAuxLineChanged()) {
+		delete [] fSDPLines;
+		fSDPLines = NULL;
+	}
+#if LIVEMEDIA_LIBRARY_VERSION_INT < 1610928000
+	return OnDemandServerMediaSubsession::sdpLines();
+#else
+	return OnDemandServerMediaSubsession::sdpLines(addressFamily);
+#endif
+}
+
+void UnicastServerMediaSubsession::startStream(unsigned clientSessionId, void* streamToken, TaskFunc* rtcpRRHandler, void* rtcpRRHandlerClientData, unsigned short& rtpSeqNum, unsigned& rtpTimestamp, ServerRequestAlternativeByteHandler* serverRequestAlternativeByteHandler, void* serverRequestAlternativeByteHandlerClientData)
+{
+	OnDemandServerMediaSubsession::startStream(clientSessionId, streamToken, rtcpRRHandler, rtcpRRHandlerClientData, rtpSeqNum, rtpTimestamp, serverRequestAlternativeByteHandler, serverRequestAlternativeByteHandlerClientData);
+	// the GOP cache already gives a decodable start
+	GopCache* gopCache = this->getGopCache();
+	if ( (gopCache == NULL) || (gopCache->getFrameCount() == 0) ) {
+		this->requestKeyFrame();
+	}
+	// each client has its own sink, its receiver reports drive the device bitrate
+	ReceiverReportMonitor* monitor = this->getReceiverReportMonitor();
+	if (monitor && streamToken) {
+		monitor->addSink(((StreamState*)streamToken)->rtpSink());
+	}
+}
+
+void UnicastServerMediaSubsession::deleteStream(unsigned clientSessionId, void*& streamToken)
+{
+	ReceiverReportMonitor* monitor = this->getReceiverReportMonitor();
+	if (monitor && streamToken) {
+		monitor->removeSink(((StreamState*)streamToken)->rtpSink());
+	}
+	OnDemandServerMediaSubsession::deleteStream(clientSessionId, streamToken);
+}
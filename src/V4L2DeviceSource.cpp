@@ -10,12 +10,47 @@
 ** -------------------------------------------------------------------------*/
 
 #include <fcntl.h>
+#include <time.h>
 #include <iomanip>
 #include <sstream>
 
 // project
 #include "logger.h"
 #include "V4L2DeviceSource.h"
+#include "GopCache.h"
+#include "ReceiverReportMonitor.h"
+#include "CaptureReactor.h"
+
+const int kActivityCheckIntervalUs = 1000000;
+// a longer gap between access units is a capture restart, not a frame duration
+const long long kMaxAccessUnitDurationUs = 1000000;
+
+// ---------------------------------
+// Convert CLOCK_MONOTONIC capture time to presentation time
+// ---------------------------------
+static timeval monotonicToPresentationTime(long long monotonicUs)
+{
+	// Offset to wall clock is fixed at first use, so timestamps of all sources
+	// stay monotonic and in sync with each other if system time is adjusted.
+	static const long long offsetUs = []()
+	{
+		timeval wallClock;
+		gettimeofday(&wallClock, NULL);
+		timespec monotonic;
+		clock_gettime(CLOCK_MONOTONIC, &monotonic);
+
+		return ((long long)wallClock.tv_sec * 1000000 + wallClock.tv_usec) - 
+			((long long)monotonic.tv_sec * 1000000 + monotonic.tv_nsec / 1000);
+	}();
+
+	const long long presentationUs = monotonicUs + offsetUs;
+
+	timeval retVal;
+	retVal.tv_sec  = presentationUs / 1000000;
+	retVal.tv_usec = presentationUs % 1000000;
+
+	return retVal;
+}
 
 // ---------------------------------
 // V4L2 FramedSource Stats
@@ -34,6 +69,54 @@ int  V4L2DeviceSource::Stats::notify(int tv_sec, int framesize)
 	return m_fps;
 }
 
+// ---------------------------------
+// V4L2 FramedSource capture queue
+// ---------------------------------
+bool V4L2DeviceSource::FrameQueue::push(const Frame & frame)
+{
+	const bool isFull = (m_size == m_frames.size());
+	if (isFull)
+	{
+		pop_front();
+	}
+	m_frames[(m_head + m_size) % m_frames.size()] = frame;
+	++m_size;
+	return !isFull;
+}
+
+void V4L2DeviceSource::FrameQueue::pop_front()
+{
+	if (m_size > 0)
+	{
+		// release the capture buffer now, not when the slot is reused
+		m_frames[m_head] = m_emptyFrame;
+		m_head = (m_head + 1) % m_frames.size();
+		--m_size;
+	}
+}
+
+void V4L2DeviceSource::FrameQueue::reserve(size_t capacity)
+{
+	if (capacity > m_frames.size())
+	{
+		std::vector<Frame> frames(capacity, m_emptyFrame);
+		for (size_t i = 0; i < m_size; ++i)
+		{
+			frames[i] = std::move(m_frames[(m_head + i) % m_frames.size()]);
+		}
+		m_frames.swap(frames);
+		m_head = 0;
+	}
+}
+
+void V4L2DeviceSource::FrameQueue::clear()
+{
+	while (!empty())
+	{
+		pop_front();
+	}
+}
+
 // ---------------------------------
 // V4L2 FramedSource
 // ---------------------------------
@@ -50,24 +133,42 @@ V4L2DeviceSource* V4L2DeviceSource::createNew(UsageEnvironment& env, DeviceInter
 // Constructor
 V4L2DeviceSource::V4L2DeviceSource(UsageEnvironment& env, DeviceInterface * device, int outputFd, unsigned int queueSize, CaptureMode captureMode) 
 	: FramedSource(env), 
+	m_captureQueue(queueSize),
 	m_in("in"), 
 	m_out("out") , 
 	m_outfd(outputFd),
 	m_device(device),
 	m_queueSize(queueSize),
-	m_queuedFramesCount(0)
+	m_auxLineVersion(0),
+	m_queuedFramesCount(0),
+	m_gopCache(NULL),
+	m_receiverReportMonitor(NULL),
+	m_isActive(false),
+	m_isRequested(false),
+	m_activityCheckTask(NULL),
+	m_captureMode(captureMode),
+	m_isAccessUnitEnd(false)
 
 {
 	m_eventTriggerId = envir().taskScheduler().createEventTrigger(V4L2DeviceSource::deliverFrameStub);
 	memset(&m_thid, 0, sizeof(m_thid));
 	memset(&m_mutex, 0, sizeof(m_mutex));
+	timerclear(&m_lastAccessUnitTime);
 	pthread_mutex_init(&m_mutex, NULL);
 	if (m_device)
 	{
+		m_receiverReportMonitor = new ReceiverReportMonitor(env, m_device);
 		switch (captureMode) {
 			case CAPTURE_INTERNAL_THREAD:
 				pthread_create(&m_thid, NULL, threadStub, this);		
 			break;
+			case CAPTURE_REACTOR_THREAD:
+				if (!CaptureReactor::instance().addSource(this, m_device->getFd())) {
+					LOG(WARN) << "capture reactor unavailable, fallback to a capture thread";
+					m_captureMode = CAPTURE_INTERNAL_THREAD;
+					pthread_create(&m_thid, NULL, threadStub, this);
+				}
+			break;
 			case CAPTURE_LIVE555_THREAD:
 				envir().taskScheduler().turnOnBackgroundReadHandling( m_device->getFd(), V4L2DeviceSource::incomingPacketHandlerStub, this);
 			break;
@@ -81,12 +182,28 @@ V4L2DeviceSource::V4L2DeviceSource(UsageEnvironment& env, DeviceInterface * devi
 // Destructor
 V4L2DeviceSource::~V4L2DeviceSource()
 {	
+	// no read is in progress once removed, the trigger can be deleted
+	if (m_captureMode == CAPTURE_REACTOR_THREAD) {
+		CaptureReactor::instance().removeSource(this);
+	}
 	envir().taskScheduler().deleteEventTrigger(m_eventTriggerId);
-	pthread_join(m_thid, NULL);	
+	envir().taskScheduler().unscheduleDelayedTask(m_activityCheckTask);
+	if (m_captureMode == CAPTURE_INTERNAL_THREAD) {
+		pthread_join(m_thid, NULL);	
+	}
 	pthread_mutex_destroy(&m_mutex);
+	delete m_gopCache;
+	delete m_receiverReportMonitor;
 	delete m_device;
 }
 
+// keep frames since last key frame for late joiners, source takes ownership
+void V4L2DeviceSource::setGopCache(GopCache* gopCache)
+{
+	delete m_gopCache;
+	m_gopCache = gopCache;
+}
+
 // thread mainloop
 void* V4L2DeviceSource::thread()
 {
@@ -135,9 +252,71 @@ void* V4L2DeviceSource::thread()
 // getting FrameSource callback
 void V4L2DeviceSource::doGetNextFrame()
 {
+	m_isRequested = true;
+	if (!m_isActive)
+	{
+		// first consumer, let device start capture
+		m_isActive = true;
+		m_device->setActive(true);
+		m_activityCheckTask = envir().taskScheduler().scheduleDelayedTask(kActivityCheckIntervalUs, V4L2DeviceSource::checkActivityStub, this);
+	}
 	deliverFrame();
 }
 
+// detect that all consumers are gone
+void V4L2DeviceSource::checkActivity()
+{
+	m_activityCheckTask = NULL;
+	if (m_isRequested || isCurrentlyAwaitingData())
+	{
+		m_isRequested = false;
+		m_activityCheckTask = envir().taskScheduler().scheduleDelayedTask(kActivityCheckIntervalUs, V4L2DeviceSource::checkActivityStub, this);
+	}
+	else
+	{
+		setInactive();
+	}
+}
+
+void V4L2DeviceSource::setInactive()
+{
+	LOG(NOTICE) << "no more consumers";
+	m_isActive = false;
+	m_device->setActive(false);
+
+	// frames queued meanwhile would not continue the cached GOP
+	if (m_gopCache) {
+		m_gopCache->clear();
+	}
+	pthread_mutex_lock (&m_mutex);
+	m_captureQueue.clear();
+	m_queuedFramesCount = 0;
+	pthread_mutex_unlock (&m_mutex);
+}
+
+std::string V4L2DeviceSource::getAuxLine()
+{
+	pthread_mutex_lock (&m_mutex);
+	std::string auxLine(m_auxLine);
+	pthread_mutex_unlock (&m_mutex);
+	return auxLine;
+}
+
+// parameters of the stream changed, sessions rebuild their SDP from the new aux line
+void V4L2DeviceSource::setAuxLine(const std::string & auxLine)
+{
+	pthread_mutex_lock (&m_mutex);
+	const bool isChanged = (auxLine != m_auxLine);
+	m_auxLine = auxLine;
+	pthread_mutex_unlock (&m_mutex);
+
+	if (isChanged)
+	{
+		++m_auxLineVersion;
+		LOG(NOTICE) << "aux line:" << auxLine;
+	}
+}
+
 // deliver frame to the sink
 void V4L2DeviceSource::deliverFrame()
 {			
@@ -156,9 +335,8 @@ void V4L2DeviceSource::deliverFrame()
 		}
 		else
 		{
-			Frame frame = m_captureQueue.front();
+			Frame frame = std::move(m_captureQueue.front());
 			m_captureQueue.pop_front();
-			const size_t remainingQueueSize = m_captureQueue.size(); 
 
 			pthread_mutex_unlock (&m_mutex);
 
@@ -178,10 +356,12 @@ void V4L2DeviceSource::deliverFrame()
 			}
 
 			fPresentationTime = frame.m_timestamp;
+			fDurationInMicroseconds = frame.m_duration;
+			m_isAccessUnitEnd = frame.m_isAccessUnitEnd;
 			memcpy(fTo, frame.m_buffer, fFrameSize);
 
-			if (remainingQueueSize > 0) {
-				envir().taskScheduler().triggerEvent(m_eventTriggerId, this);
+			if (m_gopCache) {
+				m_gopCache->addFrame(frame);
 			}
 		}
 
@@ -212,6 +392,12 @@ int V4L2DeviceSource::getNextFrame()
 
 	if (frame.isSet())
 	{
+		// Use capture time when device knows it, so queueing delays do not get into timestamps.
+		if (frame.getTimestamp() != 0)
+		{
+			ref = monotonicToPresentationTime(frame.getTimestamp());
+		}
+
 		this->postFrame(frame ,ref);
 	}
 	else
@@ -250,49 +436,69 @@ void V4L2DeviceSource::processFrame(const FrameRef &frame, const timeval &ref)
 	timeval diff;
 	timersub(&tv,&ref,&diff);
 		
-	std::list< std::pair<unsigned char*,size_t> > frameList = this->splitFrames((unsigned char*)frame.getData(), frame.getDataSize());
-	while (!frameList.empty())
+	m_frameList.clear();
+	this->splitFrames((unsigned char*)frame.getData(), frame.getDataSize(), m_frameList);
+	if (!m_frameList.empty())
 	{
-		std::pair<unsigned char*,size_t>& item = frameList.front();
-		size_t size = item.second;
-		queueFrame((char*)item.first,size,ref,frame);
-		frameList.pop_front();
+		queueFrames(m_frameList, ref, getAccessUnitDuration(ref), frame);
 
-		LOG(DEBUG) << "queueFrame\ttimestamp:" << ref.tv_sec << "." << ref.tv_usec << "\tsize:" << size <<"\tdiff:" <<  (diff.tv_sec*1000+diff.tv_usec/1000) << "ms";		
-	}			
+		LOG(DEBUG) << "queueFrames\ttimestamp:" << ref.tv_sec << "." << ref.tv_usec << "\tnals:" << m_frameList.size() << "\tsize:" << frame.getDataSize() <<"\tdiff:" <<  (diff.tv_sec*1000+diff.tv_usec/1000) << "ms";		
+	}
 }
-		
 
-// post a frame to fifo
-void V4L2DeviceSource::queueFrame(char * frame, int frameSize, const timeval &tv, const FrameRef &allocatedBuffer)
+// time since the previous access unit, 0 when unknown
+unsigned int V4L2DeviceSource::getAccessUnitDuration(const timeval &tv)
 {
-	pthread_mutex_lock (&m_mutex);
-	while (m_captureQueue.size() >= m_queueSize)
+	long long duration = 0;
+	if (timerisset(&m_lastAccessUnitTime))
 	{
-		LOG(DEBUG) << "Queue full size drop frame size:"  << (int)m_captureQueue.size();		
-		m_captureQueue.pop_front();
+		timeval diff;
+		timersub(&tv, &m_lastAccessUnitTime, &diff);
+		duration = (long long)diff.tv_sec*1000000 + diff.tv_usec;
+		if ( (duration < 0) || (duration > kMaxAccessUnitDurationUs) )
+		{
+			duration = 0;
+		}
 	}
+	m_lastAccessUnitTime = tv;
+	return (unsigned int)duration;
+}
 
-	m_captureQueue.emplace_back(frame, frameSize, tv, allocatedBuffer);	
+// post the NALs of an access unit to fifo, the sink drains them in one scheduler turn
+void V4L2DeviceSource::queueFrames(const FrameList & frameList, const timeval &tv, unsigned int duration, const FrameRef &allocatedBuffer)
+{
+	pthread_mutex_lock (&m_mutex);
+	// older access units are dropped when the queue is full, never NALs of this one
+	m_captureQueue.reserve(frameList.size());
+	for (size_t i = 0; i < frameList.size(); ++i)
+	{
+		const FrameList::Nal & nal = frameList[i];
+		Frame frame((char*)nal.m_buffer, nal.m_size, tv, allocatedBuffer);
+		frame.m_bufferOwner = nal.m_owner;
+		if (!m_captureQueue.push(frame))
+		{
+			LOG(DEBUG) << "Queue full size drop frame size:"  << (int)m_captureQueue.size();		
+		}
+	}
+	m_captureQueue.back().m_duration = duration;
+	m_captureQueue.back().m_isAccessUnitEnd = true;
 
 	m_queuedFramesCount = m_captureQueue.size();
 
 	pthread_mutex_unlock (&m_mutex);
 
-	// post an event to ask to deliver the frame
+	// post one event per access unit, next NALs are delivered when the sink asks for them
 	envir().taskScheduler().triggerEvent(m_eventTriggerId, this);
 }
 
 
 // split packet in frames					
-std::list< std::pair<unsigned char*,size_t> > V4L2DeviceSource::splitFrames(unsigned char* frame, unsigned frameSize) 
+void V4L2DeviceSource::splitFrames(unsigned char* frame, unsigned frameSize, FrameList & frameList) 
 {				
-	std::list< std::pair<unsigned char*,size_t> > frameList;
 	if (frame != NULL)
 	{
 		frameList.push_back(std::pair<unsigned char*,size_t>(frame, frameSize));
 	}
-	return frameList;
 }
 
 
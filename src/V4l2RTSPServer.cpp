@@ -26,7 +26,7 @@
 
 StreamReplicator* V4l2RTSPServer::CreateVideoReplicator( 
 					const V4L2DeviceParameters& inParam,
-					int queueSize, V4L2DeviceSource::CaptureMode captureMode, int repeatConfig,
+					int queueSize, V4L2DeviceSource::CaptureMode captureMode, int repeatConfig, size_t gopCacheSize,
 					const std::string& outputFile, V4l2IoType ioTypeOut, V4l2Output*& out) {
 
 	StreamReplicator* videoReplicator = NULL;
@@ -60,7 +60,7 @@ StreamReplicator* V4l2RTSPServer::CreateVideoReplicator(
 				delete videoCapture;
 			} else {
 				LOG(NOTICE) << "Create Source ..." << videoDev;
-				videoReplicator = DeviceSourceFactory::createStreamReplicator(this->env(), videoCapture->getFormat(), new VideoCaptureAccess(videoCapture), queueSize, captureMode, outfd, repeatConfig);
+				videoReplicator = DeviceSourceFactory::createStreamReplicator(this->env(), videoCapture->getFormat(), new VideoCaptureAccess(videoCapture), queueSize, captureMode, outfd, repeatConfig, gopCacheSize);
 				if (videoReplicator == NULL) 
 				{
 					LOG(FATAL) << "Unable to create source for device " << videoDev;
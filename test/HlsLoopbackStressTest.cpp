@@ -0,0 +1,311 @@
+/* ---------------------------------------------------------------------------
+** This software is in the public domain, furnished "as is", without technical
+** support, and with no warranty, express or implied, as to its usefulness for
+** any purpose.
+**
+** HlsLoopbackStressTest.cpp
+**
+** Concurrent HTTP clients on loopback request HLS segments of the same
+** stream, each response must be byte exact, slow readers force partial
+** writes, the request rate is measured
+**
+** usage: HlsLoopbackStressTest [clients] [requests per client]
+**
+** -------------------------------------------------------------------------*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+#include <linux/videodev2.h>
+
+#include <liveMedia.hh>
+#include <BasicUsageEnvironment.hh>
+
+#include "H264_V4l2DeviceSource.h"
+#include "TSServerMediaSubsession.h"
+#include "HTTPServer.h"
+
+const int kDefaultClients = 32;
+const int kDefaultRequests = 50;
+const int kSlowClientRatio = 4;             // one client out of 4 reads slowly
+const int kSlowReceiveBuffer = 4096;
+const size_t kSlowReadSize = 2048;
+const unsigned kSlowReadDelayUs = 200;
+const int kFrames = 200;
+const int kGopLength = 25;
+const unsigned kFrameDurationUs = 40000;
+const unsigned int kSliceDuration = 1;
+const unsigned kFeedDelayUs = 1000;
+const unsigned kCheckPeriodUs = 10000;
+const char* kStreamName = "stream";
+
+class TestDevice : public DeviceInterface
+{
+	public:
+		virtual FrameRef read()                 { return FrameRef(); }
+		virtual int getFd()                     { return -1; }
+		virtual unsigned long getBufferSize()   { return 0; }
+		virtual int getWidth()                  { return 320; }
+		virtual int getHeight()                 { return 240; }
+		virtual int getVideoFormat()            { return V4L2_PIX_FMT_H264; }
+};
+
+struct ClientsState
+{
+	ClientsState() : m_done(0), m_failures(0), m_stop(0) {}
+
+	std::atomic<int> m_done;
+	std::atomic<int> m_failures;
+	EventLoopWatchVariable m_stop;
+	TaskScheduler* m_scheduler;
+	int m_clients;
+};
+
+static void onTimeout(void* clientData)
+{
+	*(EventLoopWatchVariable*)clientData = 1;
+}
+
+static void onCheckClients(void* clientData)
+{
+	// clients run in their own threads, the event loop only polls them
+	ClientsState* state = (ClientsState*)clientData;
+	if (state->m_done == state->m_clients)
+	{
+		state->m_stop = 1;
+	}
+	else
+	{
+		state->m_scheduler->scheduleDelayedTask(kCheckPeriodUs, onCheckClients, state);
+	}
+}
+
+static void appendNal(std::string & frame, unsigned char header, size_t size, unsigned char fill)
+{
+	frame.append(H264marker, sizeof(H264marker));
+	frame.push_back((char)header);
+	// payload without start code emulation, different for each frame
+	frame.append(size - 1, (char)(0x80 | fill));
+}
+
+static std::string createAccessUnit(int index)
+{
+	std::string frame;
+	const bool isKeyFrame = (index % kGopLength == 0);
+	if (isKeyFrame)
+	{
+		appendNal(frame, 0x67, 12, 0);
+		appendNal(frame, 0x68, 4, 0);
+	}
+	appendNal(frame, isKeyFrame ? 0x65 : 0x41, isKeyFrame ? 6000 : 1500 + (index % 7) * 100, index & 0x7F);
+	return frame;
+}
+
+static unsigned short getFreePort()
+{
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0)
+	{
+		return 0;
+	}
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	socklen_t len = sizeof(addr);
+	unsigned short port = 0;
+	if ( (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) == 0) && (getsockname(fd, (struct sockaddr*)&addr, &len) == 0) )
+	{
+		port = ntohs(addr.sin_port);
+	}
+	close(fd);
+	return port;
+}
+
+// one connection per request, the server closes it once the body is sent
+static bool requestSegment(unsigned short port, unsigned int slice, const std::string & expected, bool isSlow)
+{
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0)
+	{
+		return false;
+	}
+	if (isSlow)
+	{
+		// a small window makes the server wait for the socket to be writable
+		setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &kSlowReceiveBuffer, sizeof(kSlowReceiveBuffer));
+	}
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(port);
+	if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0)
+	{
+		close(fd);
+		return false;
+	}
+
+	std::string request = std::string("GET /") + kStreamName + "?segment=" + std::to_string(slice) + " HTTP/1.1\r\nHost: localhost\r\n\r\n";
+	if (send(fd, request.data(), request.size(), MSG_NOSIGNAL) != (ssize_t)request.size())
+	{
+		close(fd);
+		return false;
+	}
+
+	std::string response;
+	std::vector<char> chunk(isSlow ? kSlowReadSize : 65536);
+	ssize_t received = 0;
+	while ( (received = recv(fd, &chunk[0], chunk.size(), 0)) > 0 )
+	{
+		response.append(&chunk[0], received);
+		if (isSlow)
+		{
+			usleep(kSlowReadDelayUs);
+		}
+	}
+	close(fd);
+
+	size_t headerEnd = response.find("\r\n\r\n");
+	if ( (headerEnd == std::string::npos) || (response.compare(0, strlen("HTTP/1.1 200"), "HTTP/1.1 200") != 0) )
+	{
+		return false;
+	}
+	size_t lengthPos = response.find("Content-Length: ");
+	if ( (lengthPos == std::string::npos) || (lengthPos > headerEnd) || (strtoul(response.c_str() + lengthPos + strlen("Content-Length: "), NULL, 10) != expected.size()) )
+	{
+		return false;
+	}
+	return response.compare(headerEnd + 4, std::string::npos, expected) == 0;
+}
+
+static void runClient(int client, int requests, unsigned short port, const std::map<unsigned int,std::string> * slices, ClientsState* state)
+{
+	const bool isSlow = (client % kSlowClientRatio == 0);
+	std::map<unsigned int,std::string>::const_iterator it = slices->begin();
+	std::advance(it, client % slices->size());
+	for (int i = 0; i < requests; ++i)
+	{
+		// clients walk the slices from different starts, concurrent requests differ
+		if (!requestSegment(port, it->first, it->second, isSlow))
+		{
+			std::cerr << "client:" << client << " slice:" << it->first << " response differs" << std::endl;
+			++state->m_failures;
+		}
+		if (++it == slices->end())
+		{
+			it = slices->begin();
+		}
+	}
+	++state->m_done;
+}
+
+int main(int argc, char* argv[])
+{
+	const int clients = (argc > 1) ? atoi(argv[1]) : kDefaultClients;
+	const int requests = (argc > 2) ? atoi(argv[2]) : kDefaultRequests;
+	if ( (clients <= 0) || (requests <= 0) )
+	{
+		std::cerr << "usage: " << argv[0] << " [clients] [requests per client]" << std::endl;
+		return 1;
+	}
+
+	TaskScheduler* scheduler = BasicTaskScheduler::createNew();
+	UsageEnvironment* env = BasicUsageEnvironment::createNew(*scheduler);
+	const unsigned short port = getFreePort();
+	HTTPServer* server = (port != 0) ? HTTPServer::createNew(*env, Port(port), NULL, 0, kSliceDuration, "", NULL) : NULL;
+	if (server == NULL)
+	{
+		std::cerr << "cannot create HTTP server" << std::endl;
+		return 1;
+	}
+
+	H264_V4L2DeviceSource* source = H264_V4L2DeviceSource::createNew(*env, new TestDevice(), -1, kGopLength, V4L2DeviceSource::NOCAPTURE, true, false);
+	StreamReplicator* replicator = StreamReplicator::createNew(*env, source, false);
+	TSServerMediaSubsession* subsession = TSServerMediaSubsession::createNew(*env, replicator, NULL, kSliceDuration);
+	ServerMediaSession* session = ServerMediaSession::createNew(*env, kStreamName);
+	session->addSubsession(subsession);
+	server->addServerMediaSession(session);
+
+	// feed the TS muxer until slices are available
+	timeval timestamp;
+	gettimeofday(&timestamp, NULL);
+	for (int i = 0; i < kFrames; ++i)
+	{
+		// NALs stay queued until the muxer reads them, the frame is released with them
+		std::string* frame = new std::string(createAccessUnit(i));
+		source->postFrame(FrameRef::createExternal(&(*frame)[0], frame->size(), [frame](){ delete frame; }), timestamp);
+		EventLoopWatchVariable fed = 0;
+		scheduler->scheduleDelayedTask(kFeedDelayUs, onTimeout, (void*)&fed);
+		scheduler->doEventLoop(&fed);
+
+		timestamp.tv_usec += kFrameDurationUs;
+		if (timestamp.tv_usec >= 1000000)
+		{
+			timestamp.tv_usec -= 1000000;
+			++timestamp.tv_sec;
+		}
+	}
+
+	// slices do not change anymore, keep copies to compare with
+	std::map<unsigned int,std::string> slices;
+	MemoryBufferSink* hlsSink = subsession->getHlsSink();
+	std::map<unsigned int,double> durations = hlsSink->getSliceDurations();
+	for (std::map<unsigned int,double>::iterator it = durations.begin(); it != durations.end(); ++it)
+	{
+		SharedBuffer buffer = hlsSink->getBuffer(it->first);
+		slices[it->first].assign(buffer.data(), buffer.size());
+	}
+
+	int result = 1;
+	if (slices.size() < 2)
+	{
+		std::cerr << "not enough slices:" << slices.size() << std::endl;
+	}
+	else
+	{
+		ClientsState state;
+		state.m_scheduler = scheduler;
+		state.m_clients = clients;
+
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		std::vector<std::thread> threads;
+		for (int client = 0; client < clients; ++client)
+		{
+			threads.push_back(std::thread(runClient, client, requests, port, &slices, &state));
+		}
+		scheduler->scheduleDelayedTask(kCheckPeriodUs, onCheckClients, &state);
+		scheduler->doEventLoop(&state.m_stop);
+		for (std::vector<std::thread>::iterator it = threads.begin(); it != threads.end(); ++it)
+		{
+			it->join();
+		}
+		const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+		const int total = clients * requests;
+		std::cout << "clients:" << clients << " requests:" << total << " slices:" << slices.size()
+			<< " failures:" << state.m_failures
+			<< " requests per second:" << (int)(total / elapsed.count()) << std::endl;
+		if (state.m_failures == 0)
+		{
+			result = 0;
+		}
+	}
+
+	Medium::close(server);
+	env->reclaim();
+	delete scheduler;
+
+	return result;
+}
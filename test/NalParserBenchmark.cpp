@@ -0,0 +1,140 @@
+/* ---------------------------------------------------------------------------
+** This software is in the public domain, furnished "as is", without technical
+** support, and with no warranty, express or implied, as to its usefulness for
+** any purpose.
+**
+** NalParserBenchmark.cpp
+**
+** Throughput of NAL extraction compared to a byte by byte start code search,
+** on a recorded Annex-B stream (-O output of the server) or a synthetic one
+**
+** usage: NalParserBenchmark [file.264 [iterations]]
+**
+** -------------------------------------------------------------------------*/
+
+#include <stdlib.h>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "NalParser.h"
+
+const int kDefaultIterations = 20;
+const size_t kSyntheticSize = 16 * 1024 * 1024;
+const size_t kSyntheticSliceSize = 3000;
+
+static std::string createStream()
+{
+	// slices of random bytes, emulation prevention keeps them free of start codes
+	std::string data;
+	srand(1);
+	while (data.size() < kSyntheticSize)
+	{
+		data.append("\x00\x00\x00\x01", 4);
+		data.push_back((char)0x41);
+		int zeros = 0;
+		for (size_t i = 1; i < kSyntheticSliceSize; ++i)
+		{
+			const unsigned char byte = (unsigned char)rand();
+			if ((zeros >= 2) && (byte <= 3))
+			{
+				data.push_back(3);
+				zeros = 0;
+			}
+			data.push_back((char)byte);
+			zeros = (byte == 0) ? zeros + 1 : 0;
+		}
+	}
+	return data;
+}
+
+static const unsigned char* byteFindStartCode(const unsigned char* p, const unsigned char* end)
+{
+	for (; p + 3 <= end; ++p)
+	{
+		if ((p[0] == 0) && (p[1] == 0) && (p[2] == 1))
+		{
+			return p;
+		}
+	}
+	return end;
+}
+
+static size_t countNals(std::string & data)
+{
+	size_t count = 0;
+	size_t size = data.size();
+	size_t outsize = 0;
+	int frameType = 0;
+	unsigned char* nal = NalParser::extractNal((unsigned char*)&data[0], size, outsize, frameType, false);
+	while (nal != NULL)
+	{
+		++count;
+		nal = NalParser::extractNal(nal + outsize, size, outsize, frameType, false);
+	}
+	return count;
+}
+
+static size_t countStartCodes(const std::string & data)
+{
+	size_t count = 0;
+	const unsigned char* end = (const unsigned char*)data.data() + data.size();
+	for (const unsigned char* p = byteFindStartCode((const unsigned char*)data.data(), end); p != end; p = byteFindStartCode(p + 3, end))
+	{
+		++count;
+	}
+	return count;
+}
+
+static void printThroughput(const char* name, size_t bytes, const std::chrono::nanoseconds & elapsed, size_t nals)
+{
+	std::cout << name << ": " << (elapsed.count() > 0 ? bytes * 1000 / elapsed.count() : 0) << " MB/s NALs:" << nals << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+	std::string data;
+	if (argc > 1)
+	{
+		std::ifstream file(argv[1], std::ios::binary);
+		std::ostringstream os;
+		os << file.rdbuf();
+		data = os.str();
+		if (data.empty())
+		{
+			std::cerr << "cannot read " << argv[1] << std::endl;
+			return 1;
+		}
+	}
+	else
+	{
+		data = createStream();
+	}
+	const int iterations = (argc > 2) ? atoi(argv[2]) : kDefaultIterations;
+	if (iterations <= 0)
+	{
+		std::cerr << "usage: " << argv[0] << " [file.264 [iterations]]" << std::endl;
+		return 1;
+	}
+
+	size_t nals = 0;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; ++i)
+	{
+		nals = countNals(data);
+	}
+	printThroughput("extractNal", data.size() * iterations, std::chrono::steady_clock::now() - start, nals);
+
+	size_t startCodes = 0;
+	start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; ++i)
+	{
+		startCodes = countStartCodes(data);
+	}
+	printThroughput("byte loop", data.size() * iterations, std::chrono::steady_clock::now() - start, startCodes);
+
+	// both count the same NALs unless the stream has an empty one
+	return (nals == startCodes) ? 0 : 1;
+}
@@ -0,0 +1,266 @@
+/* ---------------------------------------------------------------------------
+** This software is in the public domain, furnished "as is", without technical
+** support, and with no warranty, express or implied, as to its usefulness for
+** any purpose.
+**
+** NalParserTest.cpp
+**
+** Check start code search and NAL extraction against hand made and random
+** Annex-B buffers at every alignment
+**
+** -------------------------------------------------------------------------*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "NalParser.h"
+
+const int kRandomStreams = 2000;
+const size_t kMaxAlignment = 8;
+
+static int failures = 0;
+
+#define CHECK(condition) \
+	if (!(condition)) \
+	{ \
+		std::cerr << __FILE__ << ":" << __LINE__ << " " << #condition << std::endl; \
+		++failures; \
+	}
+
+struct Nal
+{
+	Nal(size_t offset, size_t size, int type) : m_offset(offset), m_size(size), m_type(type) {}
+
+	size_t m_offset; // from the buffer start, the start code is not included
+	size_t m_size;
+	int m_type;
+};
+
+// buffer copied at a given misalignment, the scanner reads words
+class Buffer
+{
+	public:
+		Buffer(const std::string & data, size_t alignment) : m_storage(data.size() + 2 * kMaxAlignment), m_size(data.size())
+		{
+			unsigned char* base = &m_storage[0];
+			m_data = base + ((kMaxAlignment - ((size_t)base % kMaxAlignment)) % kMaxAlignment) + alignment;
+			std::copy(data.begin(), data.end(), m_data);
+		}
+
+		unsigned char* data() { return m_data;  }
+		size_t size() const   { return m_size;  }
+
+	private:
+		std::vector<unsigned char> m_storage;
+		size_t m_size;
+		unsigned char* m_data;
+};
+
+static const unsigned char* referenceFindStartCode(const unsigned char* p, const unsigned char* end)
+{
+	for (; p + 3 <= end; ++p)
+	{
+		if ((p[0] == 0) && (p[1] == 0) && (p[2] == 1))
+		{
+			return p;
+		}
+	}
+	return end;
+}
+
+static std::vector<Nal> extractAll(const std::string & data, size_t alignment, bool keepMarker)
+{
+	Buffer buffer(data, alignment);
+	std::vector<Nal> nals;
+	size_t size = buffer.size();
+	size_t outsize = 0;
+	int frameType = 0;
+	unsigned char* nal = NalParser::extractNal(buffer.data(), size, outsize, frameType, keepMarker);
+	while (nal != NULL)
+	{
+		nals.push_back(Nal(nal - buffer.data(), outsize, frameType));
+		nal = NalParser::extractNal(nal + outsize, size, outsize, frameType, keepMarker);
+	}
+	return nals;
+}
+
+static bool isSame(const std::vector<Nal> & nals, const std::vector<Nal> & expected)
+{
+	bool isSame = (nals.size() == expected.size());
+	for (size_t i = 0; isSame && (i < nals.size()); ++i)
+	{
+		isSame = (nals[i].m_offset == expected[i].m_offset) && (nals[i].m_size == expected[i].m_size) && (nals[i].m_type == expected[i].m_type);
+	}
+	return isSame;
+}
+
+static void checkExtract(const std::string & data, const std::vector<Nal> & expected)
+{
+	for (size_t alignment = 0; alignment < kMaxAlignment; ++alignment)
+	{
+		CHECK(isSame(extractAll(data, alignment, false), expected));
+	}
+}
+
+static std::string fromBytes(const unsigned char* bytes, size_t size)
+{
+	return std::string((const char*)bytes, size);
+}
+
+static void testStartCodes()
+{
+	// 4 bytes start codes
+	const unsigned char longCodes[] = { 0,0,0,1, 0x67,0xAA, 0,0,0,1, 0x68,0xBB };
+	checkExtract(fromBytes(longCodes, sizeof(longCodes)), { Nal(4, 2, 0x67), Nal(10, 2, 0x68) });
+
+	// the start code is kept in front of the NAL with keepMarker
+	std::vector<Nal> withMarker = extractAll(fromBytes(longCodes, sizeof(longCodes)), 0, true);
+	CHECK(isSame(withMarker, { Nal(0, 6, 0x67), Nal(6, 6, 0x68) }));
+
+	// 3 bytes start codes
+	const unsigned char shortCodes[] = { 0,0,1, 0x65,0x11,0x22, 0,0,1, 0x41,0x33 };
+	checkExtract(fromBytes(shortCodes, sizeof(shortCodes)), { Nal(3, 3, 0x65), Nal(9, 2, 0x41) });
+	withMarker = extractAll(fromBytes(shortCodes, sizeof(shortCodes)), 0, true);
+	CHECK(isSame(withMarker, { Nal(0, 6, 0x65), Nal(6, 5, 0x41) }));
+
+	// both kinds mixed
+	const unsigned char mixedCodes[] = { 0,0,0,1, 0x67,0x01, 0,0,1, 0x68,0x02, 0,0,0,1, 0x65,0x03 };
+	checkExtract(fromBytes(mixedCodes, sizeof(mixedCodes)), { Nal(4, 2, 0x67), Nal(9, 2, 0x68), Nal(15, 2, 0x65) });
+}
+
+static void testStartCodeAtEveryOffset()
+{
+	// start codes straddling word boundaries at every alignment
+	for (size_t position = 0; position + 3 <= 40; ++position)
+	{
+		std::string data(40, (char)0x55);
+		data[position] = 0;
+		data[position + 1] = 0;
+		data[position + 2] = 1;
+		for (size_t alignment = 0; alignment < kMaxAlignment; ++alignment)
+		{
+			Buffer buffer(data, alignment);
+			const unsigned char* end = buffer.data() + buffer.size();
+			CHECK(NalParser::findStartCode(buffer.data(), end) == buffer.data() + position);
+		}
+	}
+}
+
+static void testTrailingZeros()
+{
+	// zeros in front of the next start code do not belong to the NAL
+	const unsigned char zeros[] = { 0,0,1, 0x65,0xAA,0xBB, 0,0,0,0, 0,0,0,1, 0x41,0xCC };
+	checkExtract(fromBytes(zeros, sizeof(zeros)), { Nal(3, 3, 0x65), Nal(14, 2, 0x41) });
+
+	// without a next start code they are left to the NAL
+	const unsigned char zerosAtEnd[] = { 0,0,1, 0x65,0xAA,0,0 };
+	checkExtract(fromBytes(zerosAtEnd, sizeof(zerosAtEnd)), { Nal(3, 4, 0x65) });
+
+	// start code at the very end of the buffer gives an empty NAL
+	const unsigned char codeAtEnd[] = { 0,0,1, 0x65,0xAA, 0,0,1 };
+	checkExtract(fromBytes(codeAtEnd, sizeof(codeAtEnd)), { Nal(3, 2, 0x65), Nal(8, 0, 0) });
+}
+
+static void testLongNals()
+{
+	// the scan is not limited to the start of the buffer
+	const size_t sizes[] = { 127, 128, 129, 300, 4096, 100000 };
+	std::string data;
+	std::vector<Nal> expected;
+	for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i)
+	{
+		data.append("\x00\x00\x00\x01", 4);
+		expected.push_back(Nal(data.size(), sizes[i], 0x41));
+		data.push_back((char)0x41);
+		data.append(sizes[i] - 1, (char)0x80);
+	}
+	checkExtract(data, expected);
+}
+
+static void testNoStartCode()
+{
+	// empty buffer
+	unsigned char empty = 0;
+	size_t size = 0;
+	size_t outsize = 1;
+	int frameType = 1;
+	CHECK(NalParser::extractNal(&empty, size, outsize, frameType, false) == NULL);
+	CHECK((outsize == 0) && (frameType == 0));
+	CHECK(NalParser::findStartCode(&empty, &empty) == &empty);
+
+	// buffers shorter than a start code, without one, only zeros
+	checkExtract(std::string("\x00\x00", 2), {});
+	checkExtract(std::string("\xAA\xBB\xCC\xDD\xEE\xFF\x11\x22\x33", 9), {});
+	checkExtract(std::string(64, '\0'), {});
+	checkExtract(std::string("\x00\x00\x02\x00\x00\x00\x00\x03", 8), {});
+}
+
+static void testRandomStreams()
+{
+	// random NALs with emulation prevention, the scanner must match the byte loop
+	srand(1);
+	for (int stream = 0; stream < kRandomStreams; ++stream)
+	{
+		std::string data;
+		std::vector<Nal> expected;
+		const int nalCount = 1 + rand() % 8;
+		for (int i = 0; i < nalCount; ++i)
+		{
+			const bool isLongStartCode = data.empty() || (rand() % 2);
+			data.append(isLongStartCode ? "\x00\x00\x00\x01" : "\x00\x00\x01", isLongStartCode ? 4 : 3);
+			const size_t offset = data.size();
+			const int type = 1 + rand() % 0x7F;
+			data.push_back((char)type);
+			const size_t size = 1 + rand() % 600;
+			int zeros = 0;
+			for (size_t j = 1; j < size; ++j)
+			{
+				// the last byte of a NAL is never zero
+				unsigned char byte = (rand() % 4 == 0) ? 0 : (unsigned char)rand();
+				if ((j == size - 1) && (byte == 0))
+				{
+					byte = 0x80;
+				}
+				if ((zeros >= 2) && (byte <= 3))
+				{
+					data.push_back(3);
+					zeros = 0;
+				}
+				data.push_back((char)byte);
+				zeros = (byte == 0) ? zeros + 1 : 0;
+			}
+			expected.push_back(Nal(offset, data.size() - offset, type));
+		}
+		checkExtract(data, expected);
+
+		const size_t alignment = stream % kMaxAlignment;
+		Buffer buffer(data, alignment);
+		const unsigned char* end = buffer.data() + buffer.size();
+		for (const unsigned char* p = buffer.data(); p < end; p += 1 + rand() % 16)
+		{
+			CHECK(NalParser::findStartCode(p, end) == referenceFindStartCode(p, end));
+		}
+	}
+}
+
+int main()
+{
+	testStartCodes();
+	testStartCodeAtEveryOffset();
+	testTrailingZeros();
+	testLongNals();
+	testNoStartCode();
+	testRandomStreams();
+
+	if (failures > 0)
+	{
+		std::cerr << failures << " checks failed" << std::endl;
+		return 1;
+	}
+	std::cout << "ok" << std::endl;
+	return 0;
+}
@@ -0,0 +1,169 @@
+/* ---------------------------------------------------------------------------
+** This software is in the public domain, furnished "as is", without technical
+** support, and with no warranty, express or implied, as to its usefulness for
+** any purpose.
+**
+** ReceiverReportMonitorTest.cpp
+**
+** Send a RTCP receiver report over loopback to a RTCP instance and check the
+** loss and jitter reaching the device through ReceiverReportMonitor
+**
+** -------------------------------------------------------------------------*/
+
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <iostream>
+
+#include <liveMedia.hh>
+#include <BasicUsageEnvironment.hh>
+
+#include "ReceiverReportMonitor.h"
+
+const unsigned kTimeoutUs = 5000000;
+const unsigned kFrequency = 90000;
+const unsigned char kFractionLost = 64;     // 1/256 units, 25%
+const unsigned kJitter = 900;               // timestamp units, 10 ms
+
+class TestDevice : public DeviceInterface
+{
+	public:
+		TestDevice() : m_lossPercent(-1), m_jitterMs(-1), m_stop(0) {}
+
+		virtual FrameRef read()                 { return FrameRef(); }
+		virtual int getFd()                     { return -1; }
+		virtual unsigned long getBufferSize()   { return 0; }
+		virtual void setReceiverStats(int lossPercent, int jitterMs)
+		{
+			m_lossPercent = lossPercent;
+			m_jitterMs = jitterMs;
+			m_stop = 1;
+		}
+
+	public:
+		int m_lossPercent;
+		int m_jitterMs;
+		EventLoopWatchVariable m_stop;
+};
+
+static void onTimeout(void* clientData)
+{
+	*(EventLoopWatchVariable*)clientData = 1;
+}
+
+static void putUint32(unsigned char* buffer, u_int32_t value)
+{
+	value = htonl(value);
+	memcpy(buffer, &value, sizeof(value));
+}
+
+static bool sendReceiverReport(unsigned short port, u_int32_t ssrc)
+{
+	// RR with one report block, length in 32-bit words minus one
+	unsigned char packet[32];
+	putUint32(packet, 0x81000000 | (201 << 16) | 7);
+	putUint32(packet + 4, 0x12345678);
+	putUint32(packet + 8, ssrc);
+	putUint32(packet + 12, (kFractionLost << 24) | 10);
+	putUint32(packet + 16, 1000);
+	putUint32(packet + 20, kJitter);
+	putUint32(packet + 24, 0);
+	putUint32(packet + 28, 0);
+
+	int fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (fd < 0)
+	{
+		return false;
+	}
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(port);
+	const bool isSent = sendto(fd, packet, sizeof(packet), 0, (struct sockaddr*)&addr, sizeof(addr)) == (ssize_t)sizeof(packet);
+	close(fd);
+	return isSent;
+}
+
+static unsigned short getFreePort()
+{
+	// groupsock created with port 0 is not bound until it sends
+	int fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (fd < 0)
+	{
+		return 0;
+	}
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	socklen_t len = sizeof(addr);
+	unsigned short port = 0;
+	if ( (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) == 0) && (getsockname(fd, (struct sockaddr*)&addr, &len) == 0) )
+	{
+		port = ntohs(addr.sin_port);
+	}
+	close(fd);
+	return port;
+}
+
+int main()
+{
+	TaskScheduler* scheduler = BasicTaskScheduler::createNew();
+	UsageEnvironment* env = BasicUsageEnvironment::createNew(*scheduler);
+
+	struct in_addr loopback;
+	loopback.s_addr = htonl(INADDR_LOOPBACK);
+#if LIVEMEDIA_LIBRARY_VERSION_INT	<	1607644800
+	struct in_addr groupAddress = loopback;
+#else
+	struct sockaddr_storage groupAddress;
+	memset(&groupAddress, 0, sizeof(groupAddress));
+	groupAddress.ss_family = AF_INET;
+	((struct sockaddr_in&)groupAddress).sin_addr = loopback;
+#endif
+	const unsigned short port = getFreePort();
+	Groupsock* rtpGroupsock = new Groupsock(*env, groupAddress, Port(port + 2), 255);
+	Groupsock* rtcpGroupsock = new Groupsock(*env, groupAddress, Port(port), 255);
+	RTPSink* sink = SimpleRTPSink::createNew(*env, rtpGroupsock, 96, kFrequency, "video", "MP2T", 1, True, False);
+	RTCPInstance* rtcp = RTCPInstance::createNew(*env, rtcpGroupsock, 500, (const unsigned char*)"test", sink, NULL);
+
+	TestDevice device;
+	ReceiverReportMonitor* monitor = new ReceiverReportMonitor(*env, &device);
+	monitor->addSink(sink);
+
+	int result = 1;
+	if ( (port == 0) || !sendReceiverReport(port, sink->SSRC()) )
+	{
+		std::cerr << "cannot send receiver report" << std::endl;
+	}
+	else
+	{
+		TaskToken timeout = scheduler->scheduleDelayedTask(kTimeoutUs, onTimeout, (void*)&device.m_stop);
+		scheduler->doEventLoop(&device.m_stop);
+		scheduler->unscheduleDelayedTask(timeout);
+
+		const int expectedLoss = kFractionLost * 100 / 256;
+		const int expectedJitter = kJitter * 1000 / kFrequency;
+		std::cout << "loss:" << device.m_lossPercent << "% jitter:" << device.m_jitterMs << "ms" << std::endl;
+		if ( (device.m_lossPercent == expectedLoss) && (device.m_jitterMs == expectedJitter) )
+		{
+			result = 0;
+		}
+		else
+		{
+			std::cerr << "expected loss:" << expectedLoss << "% jitter:" << expectedJitter << "ms" << std::endl;
+		}
+	}
+
+	delete monitor;
+	Medium::close(rtcp);
+	Medium::close(sink);
+	delete rtcpGroupsock;
+	delete rtpGroupsock;
+	env->reclaim();
+	delete scheduler;
+
+	return result;
+}
@@ -0,0 +1,164 @@
+/* ---------------------------------------------------------------------------
+** This software is in the public domain, furnished "as is", without technical
+** support, and with no warranty, express or implied, as to its usefulness for
+** any purpose.
+**
+** SplitFramesBenchmark.cpp
+**
+** Count heap allocations and time of splitting, queueing and delivering
+** multi-slice H264 access units, fails if the steady state allocates
+**
+** usage: SplitFramesBenchmark [frames]
+**
+** -------------------------------------------------------------------------*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <new>
+#include <string>
+#include <linux/videodev2.h>
+
+#include <liveMedia.hh>
+#include <BasicUsageEnvironment.hh>
+
+#include "H264_V4l2DeviceSource.h"
+
+const int kDefaultFrames = 10000;
+const int kWarmupFrames = 100;
+const int kGopLength = 25;
+const int kSlices = 24;           // more than the initial NAL list and queue capacity
+const size_t kSliceSize = 2000;
+const unsigned kFrameDurationUs = 40000;
+
+static std::atomic<unsigned long> allocationCount(0);
+
+void* operator new(size_t size)
+{
+	++allocationCount;
+	void* ptr = malloc(size > 0 ? size : 1);
+	if (ptr == NULL)
+	{
+		throw std::bad_alloc();
+	}
+	return ptr;
+}
+
+void operator delete(void* ptr) noexcept
+{
+	free(ptr);
+}
+
+class TestDevice : public DeviceInterface
+{
+	public:
+		virtual FrameRef read()                 { return FrameRef(); }
+		virtual int getFd()                     { return -1; }
+		virtual unsigned long getBufferSize()   { return 0; }
+		virtual int getVideoFormat()            { return V4L2_PIX_FMT_H264; }
+};
+
+static void appendNal(std::string & frame, unsigned char header, size_t size)
+{
+	frame.append(H264marker, sizeof(H264marker));
+	frame.push_back((char)header);
+	// payload without start code emulation
+	frame.append(size - 1, (char)0xAA);
+}
+
+static std::string createAccessUnit(bool isKeyFrame, bool hasParameterSets)
+{
+	std::string frame;
+	if (hasParameterSets)
+	{
+		appendNal(frame, 0x67, 12);
+		appendNal(frame, 0x68, 4);
+	}
+	for (int i = 0; i < kSlices; ++i)
+	{
+		appendNal(frame, isKeyFrame ? 0x65 : 0x41, kSliceSize);
+	}
+	return frame;
+}
+
+static void afterGettingFrame(void* clientData, unsigned frameSize, unsigned numTruncatedBytes, struct timeval presentationTime, unsigned durationInMicroseconds)
+{
+	++*(unsigned long*)clientData;
+}
+
+int main(int argc, char* argv[])
+{
+	const int frames = (argc > 1) ? atoi(argv[1]) : kDefaultFrames;
+	if (frames <= 0)
+	{
+		std::cerr << "usage: " << argv[0] << " [frames]" << std::endl;
+		return 1;
+	}
+
+	TaskScheduler* scheduler = BasicTaskScheduler::createNew();
+	UsageEnvironment* env = BasicUsageEnvironment::createNew(*scheduler);
+	H264_V4L2DeviceSource* source = H264_V4L2DeviceSource::createNew(*env, new TestDevice(), -1, 5, V4L2DeviceSource::NOCAPTURE, true, false);
+	// V4L2DeviceSource::getNextFrame reading the device hides the live555 one
+	FramedSource* framedSource = source;
+
+	// first key frame brings the parameter sets, next ones get them repeated
+	std::string firstKeyFrame = createAccessUnit(true, true);
+	std::string keyFrame = createAccessUnit(true, false);
+	std::string frame = createAccessUnit(false, false);
+	const FrameRef firstKeyFrameRef = FrameRef::createExternal(&firstKeyFrame[0], firstKeyFrame.size(), [](){});
+	const FrameRef keyFrameRef = FrameRef::createExternal(&keyFrame[0], keyFrame.size(), [](){});
+	const FrameRef frameRef = FrameRef::createExternal(&frame[0], frame.size(), [](){});
+
+	std::string output(kSliceSize * 2, '\0');
+	unsigned long delivered = 0;
+	unsigned long nals = 0;
+	unsigned long allocations = 0;
+	timeval timestamp;
+	gettimeofday(&timestamp, NULL);
+	std::chrono::steady_clock::time_point start;
+
+	for (int i = 0; i < kWarmupFrames + frames; ++i)
+	{
+		if (i == kWarmupFrames)
+		{
+			allocations = allocationCount;
+			start = std::chrono::steady_clock::now();
+		}
+
+		const bool isKeyFrame = (i % kGopLength == 0);
+		const bool isFirst = (i == 0);
+		const FrameRef & captured = isFirst ? firstKeyFrameRef : (isKeyFrame ? keyFrameRef : frameRef);
+		source->postFrame(captured, timestamp);
+		// key frames have their own or the repeated parameter sets
+		nals += isKeyFrame ? kSlices + 2 : kSlices;
+
+		// drain as a RTP sink would, one NAL per request
+		while (delivered < nals)
+		{
+			framedSource->getNextFrame((unsigned char*)&output[0], output.size(), afterGettingFrame, &delivered, NULL, NULL);
+		}
+
+		timestamp.tv_usec += kFrameDurationUs;
+		if (timestamp.tv_usec >= 1000000)
+		{
+			timestamp.tv_usec -= 1000000;
+			++timestamp.tv_sec;
+		}
+	}
+
+	const std::chrono::nanoseconds elapsed = std::chrono::steady_clock::now() - start;
+	allocations = allocationCount - allocations;
+
+	std::cout << "frames:" << frames << " NALs per frame:" << kSlices
+		<< " allocations per frame:" << (double)allocations / frames
+		<< " time per frame:" << elapsed.count() / frames << " ns" << std::endl;
+
+	Medium::close(source);
+	env->reclaim();
+	delete scheduler;
+
+	return (allocations == 0) ? 0 : 1;
+}
@@ -0,0 +1,124 @@
+/* ---------------------------------------------------------------------------
+** This software is in the public domain, furnished "as is", without technical
+** support, and with no warranty, express or implied, as to its usefulness for
+** any purpose.
+**
+** V4l2DummyFdBenchmark.cpp
+**
+** Time of a signal/reset pair of the signal fd with eventfd and with pipe,
+** then spurious wakeups of a consumer thread polling the fd while a
+** producer thread queues frames
+**
+** usage: V4l2DummyFdBenchmark [pairs] [frames]
+**
+** -------------------------------------------------------------------------*/
+
+#include <stdlib.h>
+#include <poll.h>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+#include "V4l2DummyFd.h"
+
+const int kDefaultPairs = 1000000;
+const int kDefaultFrames = 200000;
+const int kPollTimeoutMs = 1000;
+const int kMaxQueued = 64;           // capture queue bound, a pipe could not hold more signals
+
+static bool run(bool isEventFdAllowed, int pairs)
+{
+	V4l2DummyFd fd(isEventFdAllowed);
+	if (!fd.isSet())
+	{
+		return false;
+	}
+
+	const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int i = 0; i < pairs; ++i)
+	{
+		if (!fd.signal() || !fd.reset())
+		{
+			return false;
+		}
+	}
+	const std::chrono::nanoseconds elapsed = std::chrono::steady_clock::now() - start;
+
+	std::cout << (isEventFdAllowed ? "eventfd" : "pipe") << ": " << elapsed.count() / pairs << " ns per signal/reset" << std::endl;
+	return true;
+}
+
+static void produce(V4l2DummyFd* fd, std::atomic<int>* queued, int frames)
+{
+	// the frame is queued before the fd is signaled, as the capture does
+	for (int i = 0; i < frames; ++i)
+	{
+		while (*queued >= kMaxQueued)
+		{
+			std::this_thread::yield();
+		}
+		++*queued;
+		fd->signal();
+	}
+}
+
+static bool runProducerConsumer(bool isEventFdAllowed, int frames)
+{
+	V4l2DummyFd fd(isEventFdAllowed);
+	if (!fd.isSet())
+	{
+		return false;
+	}
+
+	std::atomic<int> queued(0);
+	int consumed = 0;
+	int wakeups = 0;
+	int spurious = 0;
+	struct pollfd pfd;
+	pfd.fd = fd.getFd();
+	pfd.events = POLLIN;
+
+	const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::thread producer(produce, &fd, &queued, frames);
+	while (consumed < frames)
+	{
+		pfd.revents = 0;
+		const int ret = poll(&pfd, 1, kPollTimeoutMs);
+		if (ret <= 0)
+		{
+			// a frame is queued but the fd never became readable
+			break;
+		}
+		++wakeups;
+		// readable with nothing queued, or nothing to reset, is a wakeup for nothing
+		if ( (queued == 0) || !fd.reset() )
+		{
+			++spurious;
+			continue;
+		}
+		--queued;
+		++consumed;
+	}
+	producer.join();
+	const std::chrono::nanoseconds elapsed = std::chrono::steady_clock::now() - start;
+
+	std::cout << (isEventFdAllowed ? "eventfd" : "pipe") << ": frames:" << frames << " consumed:" << consumed
+		<< " wakeups:" << wakeups << " spurious:" << spurious
+		<< " " << elapsed.count() / frames << " ns per frame" << std::endl;
+	return (consumed == frames) && (spurious == 0);
+}
+
+int main(int argc, char* argv[])
+{
+	const int pairs = (argc > 1) ? atoi(argv[1]) : kDefaultPairs;
+	const int frames = (argc > 2) ? atoi(argv[2]) : kDefaultFrames;
+	if ( (pairs <= 0) || (frames <= 0) )
+	{
+		std::cerr << "usage: " << argv[0] << " [pairs] [frames]" << std::endl;
+		return 1;
+	}
+	const bool isEventFdOk = run(true, pairs) && runProducerConsumer(true, frames);
+	const bool isPipeOk = run(false, pairs) && runProducerConsumer(false, frames);
+	return (isEventFdOk && isPipeOk) ? 0 : 1;
+}
@@ -0,0 +1,71 @@
+/* ---------------------------------------------------------------------------
+** This software is in the public domain, furnished "as is", without technical
+** support, and with no warranty, express or implied, as to its usefulness for
+** any purpose.
+**
+** V4l2DummyFdTest.cpp
+**
+** Check that the signal fd is readable exactly while signals are left, for
+** eventfd and pipe
+**
+** -------------------------------------------------------------------------*/
+
+#include <poll.h>
+#include <iostream>
+
+#include "V4l2DummyFd.h"
+
+const int kSignalCount = 5;
+
+static bool isReadable(const V4l2DummyFd& fd)
+{
+	struct pollfd pollFd = { fd.getFd(), POLLIN, 0 };
+	return (poll(&pollFd, 1, 0) == 1) && (pollFd.revents & POLLIN);
+}
+
+static bool check(bool isEventFdAllowed)
+{
+	const char* name = isEventFdAllowed ? "eventfd" : "pipe";
+	V4l2DummyFd fd(isEventFdAllowed);
+	if (!fd.isSet())
+	{
+		std::cerr << name << ": not created" << std::endl;
+		return false;
+	}
+	if (isReadable(fd) || fd.reset())
+	{
+		std::cerr << name << ": readable without signal" << std::endl;
+		return false;
+	}
+	for (int i = 0; i < kSignalCount; ++i)
+	{
+		if (!fd.signal())
+		{
+			std::cerr << name << ": signal " << i << " failed" << std::endl;
+			return false;
+		}
+	}
+	// each reset takes one signal, the fd stays readable until the last one
+	for (int i = 0; i < kSignalCount; ++i)
+	{
+		if (!isReadable(fd) || !fd.reset())
+		{
+			std::cerr << name << ": reset " << i << " failed" << std::endl;
+			return false;
+		}
+	}
+	if (isReadable(fd) || fd.reset())
+	{
+		std::cerr << name << ": readable after all signals are reset" << std::endl;
+		return false;
+	}
+	std::cout << name << ": ok" << std::endl;
+	return true;
+}
+
+int main()
+{
+	const bool isEventFdOk = check(true);
+	const bool isPipeOk = check(false);
+	return (isEventFdOk && isPipeOk) ? 0 : 1;
+}